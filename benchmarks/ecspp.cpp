@@ -1,5 +1,8 @@
 #include <ECSpp/EntityManager.h>
+#include <algorithm>
 #include <benchmark/benchmark.h>
+#include <random>
+#include <tuple>
 
 
 template <std::size_t n>
@@ -59,6 +62,38 @@ static void BM_EntitiesSequentialCreationReserved(benchmark::State& state)
             mgr.spawn(arch);
 }
 
+// an observer of other components is registered - the spawner does not record events,
+// so the result should match BM_EntitiesSequentialCreation
+template <int cNum>
+static void BM_EntitiesSequentialCreationUnobserved(benchmark::State& state)
+{
+    static NewLine nl;
+
+    epp::EntityManager mgr;
+    epp::Archetype arch = makeArchetype<cNum>();
+    mgr.observe(epp::CMask(epp::IdOfL<comp<cNum + 1>>()), [](epp::EntityEvents_t const& events) { benchmark::DoNotOptimize(events.data()); });
+    for (auto _ : state) {
+        for (int i = 0; i < state.range(0); ++i)
+            mgr.spawn(arch);
+        mgr.notifyObservers();
+    }
+}
+
+template <int cNum>
+static void BM_EntitiesSequentialCreationObserved(benchmark::State& state)
+{
+    static NewLine nl;
+
+    epp::EntityManager mgr;
+    epp::Archetype arch = makeArchetype<cNum>();
+    mgr.observe(arch.getMask(), [](epp::EntityEvents_t const& events) { benchmark::DoNotOptimize(events.data()); });
+    for (auto _ : state) {
+        for (int i = 0; i < state.range(0); ++i)
+            mgr.spawn(arch);
+        mgr.notifyObservers();
+    }
+}
+
 template <int cNum>
 static void BM_EntitiesAtOnceCreation(benchmark::State& state)
 {
@@ -71,6 +106,26 @@ static void BM_EntitiesAtOnceCreation(benchmark::State& state)
         mgr.spawn(arch, state.range(0));
 }
 
+// spawning into and clearing a reserved spawner - the counter shows that nothing is allocated from the resource of the
+// EntityManager in a steady state. Partial: the vectors of entities use the default allocator and are not counted
+template <int cNum>
+static void BM_EntitiesRespawnAllocations(benchmark::State& state)
+{
+    static NewLine nl;
+
+    epp::CountingResource counter;
+    epp::EntityManager mgr(&counter);
+    epp::Archetype arch = makeArchetype<cNum>();
+    mgr.spawn(arch, state.range(0));
+    mgr.clear(arch);
+    counter.resetCounts();
+    for (auto _ : state) {
+        mgr.spawn(arch, state.range(0));
+        mgr.clear(arch);
+    }
+    state.counters["bufferAllocs"] = double(counter.allocations());
+}
+
 template <int cNum>
 static void BM_EntitiesSequentialDestroy(benchmark::State& state)
 {
@@ -86,6 +141,20 @@ static void BM_EntitiesSequentialDestroy(benchmark::State& state)
             mgr.destroy(*it);
 }
 
+template <int cNum>
+static void BM_EntitiesBulkDestroy(benchmark::State& state)
+{
+    static NewLine nl;
+
+    epp::EntityManager mgr;
+    epp::Archetype arch = makeArchetype<cNum>();
+
+    mgr.spawn(arch, state.range(0));
+    std::vector<epp::Entity> entities = mgr.entitiesOf(arch).data;
+    for (auto _ : state)
+        mgr.destroy(entities.begin(), entities.end());
+}
+
 template <int cNum>
 static void BM_EntitiesAtOnceDestroy(benchmark::State& state)
 {
@@ -114,6 +183,40 @@ static void BM_EntitiesIteration(benchmark::State& state)
     }
 }
 
+// the same as BM_EntitiesIteration, but with the iterators of the selection
+template <int cNum>
+static void BM_EntitiesIterationRange(benchmark::State& state)
+{
+    static NewLine nl;
+
+    epp::EntityManager mgr;
+    epp::Archetype arch = makeArchetype<cNum>();
+    auto sel = makeSelection<cNum>();
+    mgr.spawn(arch, state.range(0));
+    mgr.updateSelection(sel);
+    for (auto _ : state) {
+        for (auto entity : sel)
+            std::apply([](epp::Entity ent, auto&... comps) { ((comps.x = {}), ...); }, entity);
+    }
+}
+
+template <int cNum>
+static void BM_EntitiesIterationSegments(benchmark::State& state)
+{
+    static NewLine nl;
+
+    epp::EntityManager mgr;
+    epp::Archetype arch = makeArchetype<cNum>();
+    auto sel = makeSelection<cNum>();
+    mgr.spawn(arch, state.range(0));
+    mgr.updateSelection(sel);
+    for (auto _ : state) {
+        sel.forEachSegment([](auto first, auto last) {
+            std::for_each(first, last, [](auto entity) { std::apply([](epp::Entity ent, auto&... comps) { ((comps.x = {}), ...); }, entity); });
+        });
+    }
+}
+
 template <int cNum>
 static void BM_EntitiesIterationHalf(benchmark::State& state)
 {
@@ -220,6 +323,71 @@ static void BM_Remove2Components(benchmark::State& state)
         sel.forEach([&](epp::Entity ent, auto&... comps) { return mgr.changeArchetype(ent, archMissing); });
 }
 
+template <int cNum>
+static void BM_Add2ComponentsQueued(benchmark::State& state)
+{
+    static NewLine nl;
+
+    epp::EntityManager mgr;
+    epp::Archetype archMissing = makeArchetype<cNum>();
+    epp::Archetype archFull = makeArchetype<2 + cNum>();
+    auto sel = makeSelection<cNum>();
+
+    mgr.spawn(archMissing, state.range(0));
+    mgr.updateSelection(sel);
+    for (auto _ : state) {
+        sel.forEach([&](epp::Entity ent, auto&...) { mgr.queueArchetypeChange(ent, archFull); });
+        mgr.applyArchetypeChanges();
+    }
+}
+
+// the entities are accessed in a random order, like lists of targets
+template <int cNum>
+static void BM_EntitiesRandomAccess(benchmark::State& state)
+{
+    static NewLine nl;
+
+    epp::EntityManager mgr;
+    epp::Archetype arch = makeArchetype<cNum>();
+
+    mgr.spawn(arch, state.range(0));
+    std::vector<epp::Entity> entities = mgr.entitiesOf(arch).data;
+    std::shuffle(entities.begin(), entities.end(), std::mt19937(0));
+    for (auto _ : state)
+        for (auto ent : entities)
+            mgr.componentOf<comp<cNum>>(ent).x = {};
+}
+
+template <int cNum>
+static void BM_EntitiesRandomAccessGather(benchmark::State& state)
+{
+    static NewLine nl;
+
+    epp::EntityManager mgr;
+    epp::Archetype arch = makeArchetype<cNum>();
+
+    mgr.spawn(arch, state.range(0));
+    std::vector<epp::Entity> entities = mgr.entitiesOf(arch).data;
+    std::shuffle(entities.begin(), entities.end(), std::mt19937(0));
+    for (auto _ : state)
+        mgr.gather<comp<cNum>>(entities.data(), entities.size(), [](epp::Entity, comp<cNum>& c) { c.x = {}; });
+}
+
+template <int cNum>
+static void BM_EntitiesRandomAccessGatherSorted(benchmark::State& state)
+{
+    static NewLine nl;
+
+    epp::EntityManager mgr;
+    epp::Archetype arch = makeArchetype<cNum>();
+
+    mgr.spawn(arch, state.range(0));
+    std::vector<epp::Entity> entities = mgr.entitiesOf(arch).data;
+    std::shuffle(entities.begin(), entities.end(), std::mt19937(0));
+    for (auto _ : state)
+        mgr.gather<comp<cNum>>(entities.data(), entities.size(), [](epp::Entity, comp<cNum>& c) { c.x = {}; }, true);
+}
+
 #define MYBENCHMARK_TEMPLATE(name, iters, reps, shortReport, ...)     \
     BENCHMARK_TEMPLATE(name, __VA_ARGS__)                             \
         ->DenseRange(1024 * 1024 / 16, 1024 * 1024, 1024 * 1024 / 16) \
@@ -238,12 +406,22 @@ constexpr static std::size_t const REPS = 10;
 
 //MYBENCHMARK_TEMPLATE_N(BM_EntitiesSequentialCreation, 1, ITERS)
 //MYBENCHMARK_TEMPLATE_N(BM_EntitiesSequentialCreationReserved, 1, ITERS)
+//MYBENCHMARK_TEMPLATE_N(BM_EntitiesSequentialCreationUnobserved, 1, ITERS)
+//MYBENCHMARK_TEMPLATE_N(BM_EntitiesSequentialCreationObserved, 1, ITERS)
 //MYBENCHMARK_TEMPLATE_N(BM_EntitiesAtOnceCreation, 1, ITERS)
+//MYBENCHMARK_TEMPLATE_N(BM_EntitiesRespawnAllocations, 1, ITERS)
 //MYBENCHMARK_TEMPLATE_N(BM_EntitiesSequentialDestroy, 1, ITERS)
+//MYBENCHMARK_TEMPLATE_N(BM_EntitiesBulkDestroy, 1, ITERS)
 //MYBENCHMARK_TEMPLATE_N(BM_EntitiesAtOnceDestroy, 1, ITERS)
 //MYBENCHMARK_TEMPLATE_N(BM_Add2Components, 1, ITERS)
 //MYBENCHMARK_TEMPLATE_N(BM_Remove2Components, 1, ITERS)
+//MYBENCHMARK_TEMPLATE_N(BM_Add2ComponentsQueued, 1, ITERS)
+//MYBENCHMARK_TEMPLATE_N(BM_EntitiesRandomAccess, ITERS, REPS)
+//MYBENCHMARK_TEMPLATE_N(BM_EntitiesRandomAccessGather, ITERS, REPS)
+//MYBENCHMARK_TEMPLATE_N(BM_EntitiesRandomAccessGatherSorted, ITERS, REPS)
 MYBENCHMARK_TEMPLATE_N(BM_EntitiesIteration, ITERS, REPS)
+MYBENCHMARK_TEMPLATE_N(BM_EntitiesIterationRange, ITERS, REPS)
+MYBENCHMARK_TEMPLATE_N(BM_EntitiesIterationSegments, ITERS, REPS)
 MYBENCHMARK_TEMPLATE_N(BM_EntitiesIterationHalf, ITERS, REPS)
 MYBENCHMARK_TEMPLATE_N(BM_EntitiesIterationOneOfMany, ITERS, REPS)
 MYBENCHMARK_TEMPLATE_N(BM_EntitiesIterationReal, ITERS, REPS)
\ No newline at end of file
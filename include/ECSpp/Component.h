@@ -2,29 +2,58 @@
 #define EPP_COMPONENT_H
 
 #include <ECSpp/internal/utility/Assert.h>
+#include <ECSpp/internal/utility/Hash.h>
 #include <ECSpp/internal/utility/IndexType.h>
 #include <cstdint>
+#include <type_traits>
+#include <typeinfo>
 #include <vector>
 
 namespace epp {
 
 using ComponentId = IndexType<0, std::uint8_t>;
 
+/// Copy policy of a component type - specialize it as std::false_type for the types that cannot be copied
+/**
+ * The copy constructor of a copyable component is instantiated when the component is registered (see EntityManager::instantiate).
+ * std::is_copy_constructible is true also for the classes whose copy constructor fails to compile, like std::vector<std::unique_ptr<T>>.
+ * Containers (types with value_type) are checked by the type of their values, other such classes have to specialize this template
+ * @tparam CType Type of component
+ */
+template <typename CType, typename = void>
+struct CopyableComponent : std::is_copy_constructible<CType> {
+};
+
+template <typename CType>
+struct CopyableComponent<CType, std::void_t<typename CType::value_type>>
+    : std::bool_constant<std::is_copy_constructible_v<CType> && CopyableComponent<typename CType::value_type>::value> {
+};
+
+template <typename CType>
+inline constexpr bool IsCopyable_v = CopyableComponent<CType>::value;
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
 /// A class responsible for gathering components' metadata used in CPools to construct,
-/// move and destroy components without the type information
+/// move, copy and destroy components without the type information
 class CMetadata {
     using DefCstrFnPtr_t = void (*)(void*);
     using MoveCstrFnPtr_t = void (*)(void* dest, void* src);
+    using CopyCstrFnPtr_t = void (*)(void* dest, void const* src);
     using DestrFnPtr_t = void (*)(void*);
     using MetadataVec_t = std::vector<CMetadata>;
 
 public:
     DefCstrFnPtr_t defaultConstructor;
     MoveCstrFnPtr_t moveConstructor;
+    CopyCstrFnPtr_t copyConstructor; // nullptr if the type is not copyable (see CopyableComponent)
     DestrFnPtr_t destructor;
+    std::uint64_t nameHash; // hash of the type's name, used to validate serialized components
     std::uint32_t size;
     std::uint32_t alignment;
     ComponentId cId;
+    bool triviallyCopyable; // if true, components can be copied and serialized with memcpy
 
 public:
     /// Registers a component type on first call and returns a unique id for that type
@@ -61,9 +90,19 @@ public:
     */
     static CMetadata GetData(ComponentId id)
     {
+        EPP_ASSERT(IsRegistered(id));
         return MetadataVec[id.value];
     }
 
+    /// Returns whether a component type with a given id was registered
+    /**
+     * @param id Any id
+    */
+    static bool IsRegistered(ComponentId id)
+    {
+        return id.value < MetadataVec.size();
+    }
+
 private:
     template <typename CType>
     static ComponentId RegisterComponent()
@@ -78,10 +117,16 @@ private:
         CMetadata data;
         data.defaultConstructor = [](void* mem) { new (mem) CType(); };
         data.moveConstructor = [](void* dest, void* src) { new (dest) CType(std::move(*static_cast<CType*>(src))); };
+        if constexpr (IsCopyable_v<CType>)
+            data.copyConstructor = [](void* dest, void const* src) { new (dest) CType(*static_cast<CType const*>(src)); };
+        else
+            data.copyConstructor = nullptr;
         data.destructor = [](void* mem) { static_cast<CType*>(mem)->~CType(); };
+        data.nameHash = HashString(typeid(CType).name());
         data.size = sizeof(CType);
         data.alignment = alignof(CType);
         data.cId = ComponentId(MetadataVec.size());
+        data.triviallyCopyable = std::is_trivially_copyable_v<CType>;
         MetadataVec.push_back(data);
         return data.cId;
     }
@@ -1,16 +1,37 @@
 #ifndef EPP_ENTITYMANAGER_H
 #define EPP_ENTITYMANAGER_H
 
+#include <ECSpp/internal/ColdStorage.h>
+#include <ECSpp/internal/ComponentIndex.h>
 #include <ECSpp/internal/EntityList.h>
 #include <ECSpp/internal/EntitySpawner.h>
+#include <ECSpp/internal/Hierarchy.h>
+#include <ECSpp/internal/Observer.h>
+#include <ECSpp/internal/Resources.h>
 #include <ECSpp/internal/Selection.h>
+#include <ECSpp/internal/SharedStore.h>
+#include <ECSpp/internal/SoA.h>
+#include <ECSpp/internal/SparseSet.h>
+#include <ECSpp/internal/WorldFrame.h>
+#include <ECSpp/internal/utility/CountingResource.h>
+#include <ECSpp/internal/utility/MappedFile.h>
+#include <ECSpp/internal/utility/ThreadPool.h>
+#include <algorithm>
+#include <atomic>
 #include <deque>
+#include <numeric>
+#include <utility>
 
 namespace epp {
 
+template <typename... CTypes>
+class EntityRef;
+
 
 class EntityManager {
     using Spawners_t = std::deque<EntitySpawner>; // deque, to keep selections' references valid
+    using Observers_t = std::deque<Observer>; // deque, so observers can be registered during notifyObservers
+    using Indices_t = std::vector<std::unique_ptr<ComponentIndexBase>>;
     using EntityPool_t = EntitySpawner::EntityPool_t;
     using EPoolCIter_t = EntitySpawner::EntityPool_t::Container_t::const_iterator;
     static_assert(std::is_same_v<EntityPool_t::Container_t, std::vector<Entity>>, "changeEntity works only with vectors");
@@ -21,6 +42,18 @@ class EntityManager {
     using DefCreationFn_t = decltype(DefCreationFn);
 
 public:
+    /// Constructs an empty EntityManager
+    /**
+     * @param memoryResource The resource used to allocate the components, the list of entities, the tracked changes and cached hashes,
+     * the sparse components and the indices (e.g. an arena of a level). It has to outlive the EntityManager.
+     * The arena covers only a part of the memory of the EntityManager: the vectors of entities of the spawners (their type is
+     * a part of entitiesOf), selections, shared values, resources and the bookkeeping of the spawners use the default allocator
+     * and cold values live in ColdRegion, so they have to be released by the destructor
+     */
+    explicit EntityManager(std::pmr::memory_resource* memoryResource = std::pmr::get_default_resource())
+        : memoryResource(memoryResource), entList(memoryResource) {}
+
+
     /// Spawns a new entity with a given archetype
     /**
      * @tparam FnType Callable type that takes r-value reference to the EntityCreator
@@ -45,6 +78,20 @@ public:
     spawn(Archetype const& arch, std::size_t n, FnType fn = DefCreationFn);
 
 
+    /// Spawns n copies of a given entity (e.g. a prefab configured once)
+    /**
+     * Every component of the prototype is copied n times pool by pool, trivially copyable ones with memcpy.
+     * Sparse components are not copied
+     * @param prototype A valid entity
+     * @param n Number of copies
+     * @returns A (begin, end) iterators pair to the spawned entities
+     * @throws (Debug only) Throws the AssertionFailed exception if prototype is invalid
+     * @throws Throws the AssertionFailed exception if any of the components is not copyable (see CopyableComponent),
+     * nothing is spawned in that case
+     */
+    std::pair<EPoolCIter_t, EPoolCIter_t> instantiate(Entity prototype, std::size_t n);
+
+
     /// Changes the archetype of a given entity
     /**
      * @tparam FnType Callable type that takes r-value reference to the EntityCreator
@@ -71,6 +118,30 @@ public:
     IterTimeChange changeArchetype(Entity ent, IdList_t toRemove, IdList_t toAdd, FnType fn = DefCreationFn);
 
 
+    /// Queues a change of the archetype of a given entity, applied by applyArchetypeChanges
+    /**
+     * Entity stays where it is until the changes are applied, so the queue can be filled while iterating
+     * @param ent A valid entity
+     * @param newArchetype Any archetype. A new archetype of ent
+     * @throws (Debug only) Throws the AssertionFailed exception if ent is invalid
+     */
+    void queueArchetypeChange(Entity ent, Archetype const& newArchetype);
+
+
+    /// Applies the queued archetype changes, moving the entities in groups
+    /**
+     * Changes are grouped by their (origin, destination) spawner pairs. The memory of each destination is reserved once and
+     * the components of a whole group are moved pool by pool (see EntitySpawner::moveEntitiesHere), which is much faster
+     * than changing the archetypes one by one. Entities destroyed after queuing and entities that already have the new
+     * archetype are omitted. If an entity was queued more than once, only its last queued change is applied.
+     * Mustn't be called while iterating
+     * @tparam FnType Callable type that takes r-value reference to the EntityCreator
+     * @param fn A Callable type that can use a Creator instance to construct new components, called for each moved entity
+     */
+    template <typename FnType = DefCreationFn_t>
+    void applyArchetypeChanges(FnType fn = DefCreationFn);
+
+
     /// Destroys a valid entity and makes it invalid
     /**
      * @param ent A valid entity
@@ -79,6 +150,20 @@ public:
     void destroy(Entity ent);
 
 
+    /// Destroys many valid entities and makes them invalid
+    /**
+     * Entities are grouped by their spawners and every pool of a spawner is compacted in one pass (the holes are filled with
+     * the last entities), which is much faster than destroying the entities one by one. Duplicates are destroyed once.
+     * The range mustn't be a part of the entities of this EntityManager (e.g. entitiesOf(arch).data) - copy it first
+     * @tparam EntIt Input iterator type with Entity as a value type
+     * @param first Iterator to the first entity
+     * @param last Iterator past the last entity
+     * @throws (Debug only) Throws the AssertionFailed exception if any of the entities is invalid
+     */
+    template <typename EntIt>
+    void destroy(EntIt first, EntIt last);
+
+
     /// Destroys every entity, keeps resereved memory
     /** 
      * Faster than calling destroy on each entity individually
@@ -114,6 +199,139 @@ public:
     void shrinkToFit();
 
 
+    /// Reserves address space for maxN entities of a given archetype, so their components never move when the spawner grows
+    /**
+     * Growing commits the next pages of the reserved ranges instead of reallocating, so there are no reallocation spikes
+     * and pointers to the components stay valid until the entity is destroyed or changes archetype,
+     * or until the last entity of the spawner fills the hole of a destroyed one (see CPool::reserveVirtual).
+     * Only the components are placed in the reserved ranges - the vector of the spawner's entities (see entitiesOf) and the list
+     * of all entities keep growing by doubling, which moves only the handles and the cells, never the components
+     * @param arch Any archetype
+     * @param maxN The maximal number of entities with arch
+     * @throws Throws the AssertionFailed exception (in debug and release) if the address space could not be reserved
+     * or if more than maxN entities are spawned
+     */
+    void reserveVirtual(Archetype const& arch, std::size_t maxN);
+
+
+    /// Writes a binary snapshot of every entity and component
+    /** 
+     * The pool of entities and each CPool of every spawner are written as contiguous blocks, preceded by the schema 
+     * of the components (name hash, size and alignment). Cells of the EntityList are saved too, so the entities stay valid after load.
+     * The snapshot can be loaded only by the same build of the application, with the same order of registered components (see CMetadata::Register).
+     * Resources (see addResource) are written after the spawners
+     * @param os Binary output stream
+     * @throws Throws the AssertionFailed exception (in debug and release) if any of the components or resources is not trivially copyable or if writing failed
+     */
+    void save(std::ostream& os) const;
+
+
+    /// Destroys every entity and loads the ones from a snapshot written by the save function
+    /** 
+     * Components are read with one read call for each pool.
+     * Spawners are recreated in the same order, so the archetypes used by this EntityManager before loading
+     * must be a prefix of the archetypes saved in the snapshot (true for a new EntityManager or the one the snapshot was taken from).
+     * Saved resources are read over the existing ones, so they have to be added before loading
+     * @param is Binary input stream
+     * @throws Throws the AssertionFailed exception (in debug and release) if the snapshot is corrupted or does not match 
+     * the registered components. In that case, the EntityManager is left empty
+     */
+    void load(std::istream& is);
+
+
+    /// Destroys every entity and loads the ones from a snapshot file (written by the save function) mapped into memory
+    /** 
+     * CPools adopt the mapped pages directly, so the components are not copied (only the entities and their cells are).
+     * Pages are private - they are copied by the system only when modified, and until then they can be shared
+     * between every process that maps the same file. The file stays mapped until every pool that uses it has to grow
+     * (or until this EntityManager is destroyed)
+     * @param path Path to the snapshot file
+     * @throws Throws the AssertionFailed exception (in debug and release) if the file could not be mapped or 
+     * for the same reasons as the load function
+     */
+    void loadMapped(std::string const& path);
+
+
+    /// Enables or disables tracking of changes, the current state becomes a baseline for saveDelta
+    /** 
+     * While enabled, spawners, CPools and the EntityList mark the blocks of data that were modified. 
+     * Components are assumed to be modified when they are accessed through the non-const componentOf or through a Selection with non-const types
+     * (every visited entity, see Selection::forEach)
+     * @param enable True to enable the tracking
+     */
+    void trackChanges(bool enable);
+
+
+    /// Writes the changes since the baseline and makes the current state a new baseline
+    /** 
+     * The delta contains the modified blocks of the EntityList, of the pools of entities and of every CPool, 
+     * so spawned, destroyed and moved (archetype changes) entities are included. Its size scales with the number of modified blocks, not the number of entities
+     * @param os Binary output stream
+     * @throws Throws the AssertionFailed exception (in debug and release) if the tracking is disabled, if any of the components is not trivially copyable or if writing failed
+     */
+    void saveDelta(std::ostream& os);
+
+
+    /// Applies a delta written by the saveDelta function
+    /** 
+     * This EntityManager must be in the baseline state of the delta (e.g. loaded from the snapshot saved at the baseline 
+     * and updated with every previous delta). Events are not recorded for the applied changes
+     * @param is Binary input stream
+     * @throws Throws the AssertionFailed exception (in debug and release) if the delta is corrupted or does not match this EntityManager
+     */
+    void loadDelta(std::istream& is);
+
+
+    /// Copies every entity and component into a given frame, reuses the memory of the frame
+    /** 
+     * Pools are copied with a single memcpy each. When changes are tracked, the frame also receives the blocks modified
+     * since the previous snapshotInto/restoreFrom call, which becomes the new baseline (shared with saveDelta)
+     * @param frame Any frame (empty or one that was already used)
+     * @throws Throws the AssertionFailed exception (in debug and release) if any of the components is not trivially copyable
+     */
+    void snapshotInto(WorldFrame& frame);
+
+
+    /// Replaces every entity and component with the ones copied into a given frame
+    /** 
+     * When changes are tracked and the frame was the last one copied or restored, only the blocks modified since then are copied.
+     * Otherwise every pool is copied. No events are recorded for the restored entities.
+     * Spawners created after the frame was copied are emptied, not removed
+     * @param frame A frame that was copied from this EntityManager
+     * @throws Throws the AssertionFailed exception (in debug and release) if the frame is empty or does not match this EntityManager
+     */
+    void restoreFrom(WorldFrame const& frame);
+
+
+    /// Replaces every entity and component with the ones copied into a given frame, using the changes stored in the newer frames
+    /** 
+     * Used to roll back a few steps - e.g. with a ring buffer of frames, newerFirst and newerLast span every frame copied after the restored one.
+     * If the frames form an unbroken chain of copies (from frame to the last one copied or restored) and changes are tracked, 
+     * only the blocks modified in any of them (or since the last one) are copied, so the cost is proportional to the bytes that differ.
+     * Otherwise every pool is copied
+     * @tparam FrameIter An input iterator that dereferences to WorldFrame const& (e.g. WorldFrame const* or iterator of a container of std::reference_wrapper<WorldFrame const>)
+     * @param frame A frame that was copied from this EntityManager
+     * @param newerFirst An iterator to the first frame copied after frame
+     * @param newerLast An iterator past the last frame copied after frame
+     * @throws Throws the AssertionFailed exception (in debug and release) if the frame is empty or does not match this EntityManager
+     */
+    template <typename FrameIter>
+    void restoreFrom(WorldFrame const& frame, FrameIter newerFirst, FrameIter newerLast);
+
+
+    /// Returns a deterministic hash of every entity and component, e.g. to detect desynchronization of lockstep simulations
+    /** 
+     * Hashes the pool of entities and the contiguous bytes of each CPool of every non-empty spawner, in the order of creation 
+     * of spawners and ComponentIds. When changes are tracked, only the blocks modified since the last checksum call are rehashed
+     * (computing a checksum does not move the baseline of saveDelta/snapshotInto).
+     * Hashed components should have no padding bytes and must be trivially copyable
+     * @param excluded Mask of components that are not hashed (e.g. render-only data)
+     * @returns The hash of the state
+     * @throws Throws the AssertionFailed exception (in debug and release) if any of the hashed components is not trivially copyable
+     */
+    std::uint64_t checksum(CMask const& excluded = CMask());
+
+
     /// Updates selection so that forEach member function can reach entities of the archetypes that were not present in its last update
     /** 
      * Complexity: O(n), where n is a number of new (for that selection) archetypes used
@@ -125,6 +343,150 @@ public:
     void updateSelection(Selection<CTypes...>& selection);
 
 
+    /// Registers a callback that will receive the events of entities that own a certain set of components
+    /** 
+     * Events are recorded only by the spawners accepted by at least one observer, 
+     * so without any registered observers spawning, destroying and changing archetypes costs nothing extra
+     * @param wanted Mask of components the observed entities must have (e.g. the mask of an archetype)
+     * @param callback A callable object that accepts a batch of events (EntityEvents_t const&)
+     * @param unwanted Mask of components the observed entities mustn't have
+     * @returns An id that can be used to remove the observer
+     */
+    ObserverId observe(CMask wanted, Observer::Callback_t callback, CMask unwanted = CMask());
+
+
+    /// Removes an observer, events that were not yet delivered to it are discarded
+    /** 
+     * An observer can be removed by any callback, also its own. In that case the callback is destroyed after notifyObservers returns
+     * @param id An id returned from the observe function
+     * @throws (Debug only) Throws the AssertionFailed exception if id was not returned from the observe function or was already removed
+     */
+    void removeObserver(ObserverId id);
+
+
+    /// Delivers the recorded events to the observers and clears the spawners' queues
+    /** 
+     * Each observer receives one batch of events for each spawner it accepts.
+     * The order of events is kept within a spawner, but not between different spawners.
+     * Callbacks may call notifyObservers - the nested call delivers the events recorded since the outer call took them
+     */
+    void notifyObservers();
+
+
+    /// Creates a hash index of the entities that own a component of type CType, by a key computed from that component
+    /** 
+     * The index is kept up to date when entities are spawned, destroyed, change their archetypes or are loaded/restored,
+     * so the entities can be found by their keys in O(1). Without any indices, these operations cost nothing extra.
+     * Keys are computed only when an entity is indexed - call reindex after modifying the key of an indexed entity
+     * @tparam CType Type of the indexed component
+     * @tparam KeyFn A callable type that accepts (CType const&) and returns a hashable key
+     * @param keyFn A callable object that accepts (CType const&) and returns a hashable key
+     * @returns A reference to the index, valid as long as this EntityManager
+     */
+    template <typename CType, typename KeyFn>
+    ComponentIndex<CType, KeyFn> const& addIndex(KeyFn keyFn);
+
+
+    /// Recomputes the keys of a given entity in every index of its components
+    /** 
+     * @param ent A valid entity
+     * @throws (Debug only) Throws the AssertionFailed exception if ent is invalid
+     */
+    void reindex(Entity ent);
+
+
+    /// Sets or removes the parent of an entity
+    /** 
+     * The relationship is removed when any of the entities is destroyed (children of a destroyed entity become roots).
+     * The hierarchy is not a part of snapshots, deltas nor WorldFrames
+     * @param child A valid entity
+     * @param parent A valid entity or an invalid one (e.g. Entity()) to remove the current parent
+     * @throws Throws the AssertionFailed exception (in debug and release) if parent is a descendant of child or child itself
+     * @throws (Debug only) Throws the AssertionFailed exception if child is invalid
+     */
+    void setParent(Entity child, Entity parent);
+
+
+    /// Returns the parent of an entity
+    /** 
+     * @param ent Any entity
+     * @returns The parent of ent or Entity() if ent has no valid parent
+     */
+    Entity parentOf(Entity ent) const { return hierarchy.parentOf(ent, entList); }
+
+
+    /// Reorders the entities of every spawner, so that the entities of the hierarchy are stored breadth-first
+    /** 
+     * Only the positions that the entities of the hierarchy already occupy are used, other entities are not moved.
+     * Afterwards, within each spawner, entities are ordered by depth and children of one parent are grouped together.
+     * Called by forEachHierarchy whenever the hierarchy was changed
+     */
+    void sortHierarchy();
+
+
+    /// Calls func on each entity that has a parent, parents always before their children
+    /** 
+     * Meant for propagating values (e.g. transforms) from the parents to the children in one pass.
+     * Entities are visited breadth-first, in the order they are stored in (see sortHierarchy), so the components are accessed 
+     * almost linearly. Runs on the calling thread only, see the overload with a ThreadPool for the parallel pass.
+     * Pairs where either the parent or the child does not own CType are skipped.
+     * @warning func mustn't spawn, destroy or change archetypes of any entities
+     * @tparam CType Type of the propagated component
+     * @tparam Func A callable type that accepts (Entity child, CType const& parentComponent, CType& childComponent) as arguments
+     * @param func A callable object that accepts (Entity child, CType const& parentComponent, CType& childComponent) as arguments
+     */
+    template <typename CType, typename Func>
+    void forEachHierarchy(Func func);
+
+
+    /// Calls func on each entity that has a parent, one depth at a time, the entities of one depth on many threads
+    /**
+     * Entities of one depth do not depend on each other (see Hierarchy::getDepthBegins), so each depth is split into chunks
+     * of up to HierarchyChunkSize entities that are taken by the threads of pool. The next depth starts after the whole
+     * previous one is done, so parents are still visited before their children.
+     * Every CType component of the spawners is marked as modified up front (like in Selection::reduce).
+     * Otherwise the same as forEachHierarchy(func)
+     * @warning func is called concurrently, it mustn't modify anything but its childComponent
+     * @tparam CType Type of the propagated component
+     * @tparam Func A callable type that accepts (Entity child, CType const& parentComponent, CType& childComponent) as arguments
+     * @param func A callable object that accepts (Entity child, CType const& parentComponent, CType& childComponent) as arguments
+     * @param pool The pool that runs the chunks
+     * @param threadsNum The maximal number of threads, including the calling one (0 - all threads of pool)
+     */
+    template <typename CType, typename Func>
+    void forEachHierarchy(Func func, ThreadPool& pool, std::size_t threadsNum = 0);
+
+
+    /// Reorders the entities of a given archetype by a key computed from one of their components
+    /** 
+     * Every CPool of the spawner and its entities are permuted together, with one shared permutation.
+     * Meant for improving the locality (e.g. Morton order of positions), entities with equal keys keep their relative order.
+     * Entities stay valid, but the order set by sortHierarchy is not preserved
+     * @tparam CType Type of the component the key is computed from
+     * @tparam KeyFn A callable type that accepts (CType const&) and returns a key comparable with operator<
+     * @param arch Any archetype that contains CType
+     * @param keyFn A callable object that accepts (CType const&) and returns a key comparable with operator<
+     * @throws (Debug only) Throws the AssertionFailed exception if arch does not contain CType
+     */
+    template <typename CType, typename KeyFn>
+    void sortSpawner(Archetype const& arch, KeyFn keyFn);
+
+
+    /// Restores the order set by sortSpawner after the entities were spawned, destroyed or their keys were modified
+    /** 
+     * Assumes that the spawner is almost sorted - entities out of order (e.g. moved by the swap-remove of destroy or appended
+     * by spawn) are sorted separately and merged with the rest, so the cost is linear plus O(k log k) for k entities out of order.
+     * The result is the same as the result of sortSpawner, except for the relative order of entities with equal keys
+     * @tparam CType Type of the component the key is computed from
+     * @tparam KeyFn A callable type that accepts (CType const&) and returns a key comparable with operator<
+     * @param arch Any archetype that contains CType
+     * @param keyFn A callable object that accepts (CType const&) and returns a key comparable with operator<
+     * @throws (Debug only) Throws the AssertionFailed exception if arch does not contain CType
+     */
+    template <typename CType, typename KeyFn>
+    void resortSpawner(Archetype const& arch, KeyFn keyFn);
+
+
     /// Returns an internal data that describes the location of a given entity
     /** 
      * @param ent Valid entity
@@ -145,6 +507,209 @@ public:
     TComp& componentOf(Entity ent);
 
 
+    /** @copydoc EntityManager::componentOf(Entity ent) */
+    template <typename TComp>
+    TComp const& componentOf(Entity ent) const;
+
+
+    /// Returns a proxy of the fields of T (stored as a structure of arrays, see SoALayout) owned by a given entity
+    /**
+     * The proxy is valid until the entity is moved (like a reference returned by componentOf)
+     * @tparam T A type with a SoALayout
+     * @param ent A valid entity that owns every field of T
+     * @returns A proxy of the fields of ent
+     * @throws (Debug only) Throws the AssertionFailed exception if ent is invalid or does not own the fields
+     */
+    template <typename T>
+    SoARef<T> fieldsOf(Entity ent);
+
+
+    /** @copydoc EntityManager::fieldsOf(Entity ent) */
+    template <typename T>
+    SoARef<T const> fieldsOf(Entity ent) const;
+
+
+    /// Returns references to the components of given types owned by a given entity
+    /**
+     * Reads the location of ent and resolves its spawner once, instead of once per component like componentOf
+     * @tparam CTypes Types of the components to return. Components of const types are not marked as modified
+     * @param ent A valid entity that owns every component
+     * @returns A tuple of references to the components
+     * @throws (Debug only) Throws the AssertionFailed exception if ent is invalid or does not own any of the components
+     */
+    template <typename... CTypes>
+    std::tuple<CTypes&...> componentsOf(Entity ent);
+
+
+    /** @copydoc EntityManager::componentsOf(Entity ent) */
+    template <typename... CTypes>
+    std::tuple<CTypes const&...> componentsOf(Entity ent) const;
+
+
+    /// Returns a handle of a given entity that caches the pools of its components
+    /**
+     * @tparam CTypes Types of the components accessed through the handle
+     * @param ent Any entity
+     * @returns A handle of ent (see EntityRef)
+     */
+    template <typename... CTypes>
+    EntityRef<CTypes...> refOf(Entity ent) { return EntityRef<CTypes...>(*this, ent); }
+
+
+    /// Calls a function with the components of each of given entities (random access to many entities at once)
+    /**
+     * Meant for lists of entities (e.g. targets, collision pairs) whose components are scattered among the pools.
+     * The cell of an entity is prefetched a few iterations before its components are, and these a few iterations before
+     * they are used, so the chains of dependent cache misses (cell -> pool -> component) of consecutive entities overlap.
+     * The pools of the last used spawner are cached. func mustn't spawn, destroy or change the archetypes of entities
+     * @tparam CTypes Types of the components passed to func. Components of const types are not marked as modified
+     * @tparam FnType Callable type that takes (Entity, CTypes&...)
+     * @param ents Pointer to the first of the entities
+     * @param n Number of entities
+     * @param func Function called for each entity
+     * @param sortByLocation If true, func is called in the order of the locations of the entities (by spawner, then by
+     *        index in the pools), so the components are read sequentially. Otherwise func is called in the order of ents
+     * @throws (Debug only) Throws the AssertionFailed exception if any of the entities is invalid or does not own any of the components
+     */
+    template <typename... CTypes, typename FnType>
+    void gather(Entity const* ents, std::size_t n, FnType func, bool sortByLocation = false);
+
+
+    /// Constructs a value shared by a group of entities
+    /** 
+     * Entities refer to the value with a Shared<T> component constructed from the returned handle 
+     * (e.g. creator.constructed<Shared<T>>(handle)), selections receive the value itself (see Selection::forEach).
+     * Values live until they are released (see releaseShared) or the EntityManager is destroyed, they are not a part of snapshots,
+     * deltas, WorldFrames nor checksums (only the handles are). Making new values does not move the existing ones,
+     * so the references returned by shared and sharedOf stay valid until their value is released
+     * @tparam T Type of the shared value, Shared<T> has to be a registered component
+     * @tparam Args Types of arguments that will be forwarded to the constructor
+     * @param args Arguments forwarded to the constructor of T
+     * @returns A handle of the new value
+     */
+    template <typename T, typename... Args>
+    Shared<T> makeShared(Args&&... args);
+
+
+    /// Destroys a value shared by a group of entities, its handle can be returned by the next makeShared call
+    /** 
+     * No entity can refer to the value anymore, neither can the entities in the snapshots and WorldFrames that will be restored
+     * @tparam T Type of the shared value
+     * @param handle A handle returned from the makeShared function
+     * @throws (Debug only) Throws the AssertionFailed exception if handle does not refer to a value or if any entity refers to it
+     */
+    template <typename T>
+    void releaseShared(Shared<T> handle);
+
+
+    /// Returns a value shared by a group of entities
+    /** 
+     * Modifying the value affects every entity that refers to it
+     * @param handle A handle returned from the makeShared function
+     * @returns A reference to the shared value
+     * @throws (Debug only) Throws the AssertionFailed exception if handle was not returned from the makeShared function
+     */
+    template <typename T>
+    T& shared(Shared<T> handle) { return sharedStoreOf<T>().get(handle); }
+
+
+    /** @copydoc EntityManager::shared(Shared<T> handle) */
+    template <typename T>
+    T const& shared(Shared<T> handle) const;
+
+
+    /// Returns the value shared by the group of a given entity
+    /** 
+     * @tparam T Type of the shared value
+     * @param ent A valid entity that owns the Shared<T> component
+     * @returns A reference to the value referred to by ent's Shared<T> component
+     * @throws (Debug only) Throws the AssertionFailed exception if ent is invalid or it does not own the Shared<T> component
+     */
+    template <typename T>
+    T const& sharedOf(Entity ent) const { return shared(componentOf<Shared<T>>(ent)); }
+
+
+    /// Constructs a sparse component of a given entity, replacing the current one
+    /** 
+     * Only the sparse set of CType is modified, the entity stays in its spawner. 
+     * Sparse components are removed together with their entities. They are not a part of snapshots, deltas, WorldFrames,
+     * checksums nor indices, and adding or removing them does not record events
+     * @tparam CType A sparse component type (see SparseStorage)
+     * @tparam Args Types of arguments that will be forwarded to the constructor
+     * @param ent A valid entity
+     * @param args Arguments forwarded to the constructor of CType
+     * @returns A reference to the new component
+     * @throws (Debug only) Throws the AssertionFailed exception if ent is invalid
+     */
+    template <typename CType, typename... Args>
+    CType& addSparse(Entity ent, Args&&... args);
+
+
+    /// Removes a sparse component of a given entity (no-op if it does not have one)
+    /** 
+     * @tparam CType A sparse component type (see SparseStorage)
+     * @param ent Any entity
+     */
+    template <typename CType>
+    void removeSparse(Entity ent);
+
+
+    /// Returns a sparse component of a given entity
+    /** 
+     * @tparam CType A sparse component type (see SparseStorage)
+     * @param ent Any entity
+     * @returns A pointer to the component or nullptr if ent does not have one
+     */
+    template <typename CType>
+    CType* findSparse(Entity ent);
+
+
+    /// Constructs a singleton resource of type T (e.g. time, input or config), replacing the current one
+    /** 
+     * The returned reference stays valid until the resource is removed or replaced, so systems and selection callbacks 
+     * can keep it and reach the resource with a single pointer load.
+     * Trivially copyable resources are a part of snapshots, deltas (the whole value) and WorldFrames
+     * @tparam T Type of the resource
+     * @tparam Args Types of arguments that will be forwarded to the constructor
+     * @param args Arguments forwarded to the constructor of T
+     * @returns A reference to the new resource
+     */
+    template <typename T, typename... Args>
+    T& addResource(Args&&... args) { return resources.emplace<T>(std::forward<Args>(args)...); }
+
+
+    /// Returns the singleton resource of type T
+    /** 
+     * @tparam T Type of the resource
+     * @returns A reference to the resource
+     * @throws (Debug only) Throws the AssertionFailed exception if there is no resource of type T
+     */
+    template <typename T>
+    T& resource();
+
+
+    /** @copydoc EntityManager::resource() */
+    template <typename T>
+    T const& resource() const;
+
+
+    /// Returns the singleton resource of type T if there is one
+    /** 
+     * @tparam T Type of the resource
+     * @returns A pointer to the resource or nullptr if there is none
+     */
+    template <typename T>
+    T* findResource() { return resources.find<T>(); }
+
+
+    /// Destroys the singleton resource of type T (no-op if there is none)
+    /** 
+     * @tparam T Type of the resource
+     */
+    template <typename T>
+    void removeResource() { resources.erase<T>(); }
+
+
     /// Returns a mask that describes which of the components are owned by a given entity
     /** 
      * @param ent A valid entity
@@ -180,6 +745,25 @@ public:
     bool isValid(Entity ent) const { return entList.isValid(ent); }
 
 
+    /// Checks the validity of many entities at once (e.g. stored lists of targets)
+    /**
+     * Faster than calling isValid for each entity, see EntityList::isValid(Entity const*, std::size_t, std::uint64_t*)
+     * @param ents Pointer to the first of the entities
+     * @param n Number of entities
+     * @param validBits Bitset of (n + 63) / 64 words, bit i % 64 of word i / 64 is set if ents[i] is valid, cleared otherwise
+     * @returns The number of valid entities
+     */
+    std::size_t isValid(Entity const* ents, std::size_t n, std::uint64_t* validBits) const { return entList.isValid(ents, n, validBits); }
+
+
+    /// Removes the invalid entities from a given vector, keeping the order of the valid ones
+    /**
+     * @param ents Any entities
+     * @returns The number of removed entities
+     */
+    std::size_t eraseInvalid(std::vector<Entity>& ents) const;
+
+
     /// Returns the number of alive entities
     /** 
      * @returns The number of alive entities
@@ -194,7 +778,17 @@ public:
      */
     std::size_t size(Archetype const& arch) const;
 
+
+    /** @returns The resource used to allocate the components and the list of entities */
+    std::pmr::memory_resource* getMemoryResource() const { return memoryResource; }
+
 private:
+    template <typename CType>
+    static CType& ComponentAt(CPool& pool, PoolIdx idx);
+    template <typename... CTypes, typename FnType, std::size_t... Is>
+    static void CallWithComponents(FnType& func, Entity ent, std::array<CPool*, sizeof...(CTypes)> const& pools, PoolIdx idx, std::index_sequence<Is...>);
+    template <typename... CTypes>
+    std::array<CPool*, sizeof...(CTypes)>& poolsOf(SpawnerId spawnerId, SpawnerId& cachedId, std::array<CPool*, sizeof...(CTypes)>& cached);
     EntitySpawner& _prepareToSpawn(Archetype const& arch, std::size_t n);
     EntitySpawner& getSpawner(Archetype const& arch);
     EntitySpawner& getSpawner(Entity ent) { return spawners[entList.get(ent).spawnerId.value]; }
@@ -202,69 +796,465 @@ private:
     Spawners_t::iterator findSpawner(Archetype const& arch);
     Spawners_t::const_iterator findSpawner(Archetype const& arch) const;
 
+    template <typename CType, typename KeyFn>
+    auto sortKeysOf(EntitySpawner const& spawner, KeyFn& keyFn) const;
+    void collectHierarchyPools(ComponentId cId);
+    template <typename CType, typename Func>
+    bool propagateToChild(Hierarchy::Link const& link, Func& func, bool markChanged);
+    template <typename T>
+    SharedStore<T>& sharedStoreOf();
+    template <typename T>
+    bool isSharedUsed(Shared<T> handle) const;
+    template <typename CType>
+    SparseSet<CType>& sparseSetOf();
+    template <typename CType, typename... CTypes>
+    void bindStorage(Selection<CTypes...>& selection);
+    void eraseSparse(Entity ent);
+    void destroyBatch();
+    void destroyMarked(std::vector<Entity>& marked);
+    void eraseInvalidSparse();
+    void updateObserved(EntitySpawner& spawner) const;
+    void load(std::istream& is, std::shared_ptr<void> const& memoryOwner);
+    void saveArchetype(std::ostream& os, EntitySpawner const& spawner) const;
+    EntitySpawner& loadArchetype(std::istream& is, std::size_t spawnerIdx);
+    EntitySpawner& makeSpawner(Archetype const& arch);
+    bool isTriviallyCopyable() const;
+    void updateIndices(Entity ent, CMask const& oldMask);
+    void unindex(Entity ent);
+    void rebuildIndices();
+    void resetBaseline(std::uint64_t frameId);
+    void restore(WorldFrame const& frame, bool onlyChanged);
+
 private:
+    std::pmr::memory_resource* memoryResource;
+
     Spawners_t spawners;
 
-    EntityList entList;
-};
+    Hierarchy hierarchy;
 
+    Indices_t indices;
 
-/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    std::vector<std::unique_ptr<SharedStoreBase>> sharedStores; // by ComponentId of Shared<T>, null if not used yet
 
+    std::vector<std::unique_ptr<SparseSetBase>> sparseSets; // by SparseSetBase::IdOf, null if not used yet
 
-template <typename FnType>
-inline std::enable_if_t<std::is_invocable_v<FnType, EntityCreator&&>, Entity>
-EntityManager::spawn(Archetype const& arch, FnType fn)
-{
-    return getSpawner(arch).spawn(entList, std::move(fn));
-}
+    Resources resources;
 
-template <typename FnType>
-inline std::pair<EntityManager::EPoolCIter_t, EntityManager::EPoolCIter_t>
-EntityManager::spawn(Archetype const& arch, std::size_t n, FnType fn)
-{
-    EntitySpawner& spawner = _prepareToSpawn(arch, n);
-    for (std::size_t i = 0; i < n; ++i)
-        spawner.spawn(entList, fn);
-    return { spawner.getEntities().data.end() - std::ptrdiff_t(n), spawner.getEntities().data.end() };
-}
+    std::vector<CPool*> hierarchyPools; // forEachHierarchy scratch - pools of the propagated component, by SpawnerId
 
-template <typename FnType>
-inline IterTimeChange EntityManager::changeArchetype(Entity ent, Archetype const& newArchetype, FnType fn)
-{
-    EPP_ASSERT(entList.isValid(ent));
-    EntitySpawner& spawner = getSpawner(ent);
-    if (spawner.mask != newArchetype.getMask()) {
-        getSpawner(newArchetype).moveEntityHere(ent, entList, spawner, std::move(fn));
-        return IterTimeChange::ArchetypeCurrent;
-    }
-    return IterTimeChange::ChangeFailed;
-}
+    Observers_t observers;
 
-template <typename FnType>
-inline IterTimeChange EntityManager::changeArchetype(Entity ent, IdList_t toRemove, IdList_t toAdd, FnType fn)
-{
-    EPP_ASSERT(entList.isValid(ent));
-    return changeArchetype(ent, getSpawner(ent).makeArchetype().removeComponent(toRemove).addComponent(toAdd), std::move(fn));
-}
+    bool trackingChanges = false;
 
-inline void EntityManager::destroy(Entity ent)
-{
-    EPP_ASSERT(entList.isValid(ent));
-    getSpawner(ent).destroy(ent, entList);
-}
+    std::uint64_t baselineFrameId = 0; // id of the last frame copied or restored since the changes are tracked, 0 if none
 
-inline void EntityManager::clear()
+    constexpr static std::uint32_t const SnapshotMagic = 0x53505045; // "EPPS"
+    constexpr static std::uint32_t const DeltaMagic = 0x44505045;    // "EPPD"
+    constexpr static std::uint32_t const SnapshotVersion = 3;
+
+    constexpr static std::size_t const HierarchyChunkSize = 1024; // entities of one task of the parallel forEachHierarchy
+
+    EntityEvents_t eventsBatch;   // memory reused by notifyObservers for the events of a spawner
+
+    EntityEvents_t eventsScratch; // memory reused by notifyObservers for the events filtered for one observer
+
+    std::size_t notifyDepth = 0; // number of notifyObservers calls in progress (callbacks can call it again)
+
+    std::vector<std::uint64_t> destroyKeys; // destroy(first, last) scratch - (SpawnerId, PoolIdx) of each entity
+
+    std::vector<std::size_t> destroyIdxs;   // destroy(first, last) and applyArchetypeChanges scratch - PoolIdxs of the entities of one spawner
+
+    std::vector<std::pair<Entity, SpawnerId>> queuedChanges; // entities queued by queueArchetypeChange and their destinations
+
+    std::vector<std::pair<std::uint64_t, Entity>> changeKeys; // applyArchetypeChanges scratch - (destination, origin) of each entity
+
+    std::vector<std::uint64_t> gatherKeys; // gather scratch - (SpawnerId, PoolIdx) of each entity
+
+    EntityList entList;
+
+    template <typename... CTypes>
+    friend class EntityRef;
+};
+
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+/// A handle of an entity that caches the pools of the components of types CTypes
+/**
+ * The pools are looked up on the first access and again only after the entity changes its archetype, so every access
+ * costs a single read of the entity's location. Spawners and their pools are never removed, so the handle stays usable
+ * for the whole life of the EntityManager that made it
+ * @tparam CTypes Types of the components. Components of const types are not marked as modified
+ */
+template <typename... CTypes>
+class EntityRef {
+public:
+    /// Constructs a handle of no entity
+    EntityRef() = default;
+
+
+    /** @returns The entity this handle refers to */
+    Entity getEntity() const { return ent; }
+
+
+    /** @returns True if the entity was not destroyed */
+    bool isValid() const { return mgr && mgr->isValid(ent); }
+
+
+    /// Returns references to the components of the entity
+    /**
+     * @returns A tuple of references to the components
+     * @throws (Debug only) Throws the AssertionFailed exception if the entity is invalid or does not own any of the components
+     */
+    std::tuple<CTypes&...> get();
+
+
+    /// Returns a reference to one of the components of the entity
+    /**
+     * @tparam CType One of CTypes
+     * @returns A reference to the component
+     * @throws (Debug only) Throws the AssertionFailed exception if the entity is invalid or does not own the component
+     */
+    template <typename CType>
+    CType& get();
+
+private:
+    EntityRef(EntityManager& manager, Entity entity) : mgr(&manager), ent(entity) {}
+    PoolIdx locate();
+
+    template <typename CType>
+    static constexpr std::size_t IndexOf()
+    {
+        std::size_t idx = 0;
+        ((std::is_same_v<CType, CTypes> ? false : (++idx, true)) && ...);
+        return idx;
+    }
+
+private:
+    EntityManager* mgr = nullptr;
+
+    Entity ent;
+
+    SpawnerId spawnerId; // the spawner the pools belong to, BadValue if not looked up yet
+
+    std::array<CPool*, sizeof...(CTypes)> pools{};
+
+    friend class EntityManager;
+};
+
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+template <typename FnType>
+inline std::enable_if_t<std::is_invocable_v<FnType, EntityCreator&&>, Entity>
+EntityManager::spawn(Archetype const& arch, FnType fn)
+{
+    Entity ent = getSpawner(arch).spawn(entList, std::move(fn));
+    if (!indices.empty())
+        updateIndices(ent, CMask());
+    return ent;
+}
+
+template <typename FnType>
+inline std::pair<EntityManager::EPoolCIter_t, EntityManager::EPoolCIter_t>
+EntityManager::spawn(Archetype const& arch, std::size_t n, FnType fn)
+{
+    EntitySpawner& spawner = _prepareToSpawn(arch, n);
+    for (std::size_t i = 0; i < n; ++i)
+        spawner.spawn(entList, fn);
+    if (!indices.empty())
+        for (auto it = spawner.getEntities().data.end() - std::ptrdiff_t(n); it != spawner.getEntities().data.end(); ++it)
+            updateIndices(*it, CMask());
+    return { spawner.getEntities().data.end() - std::ptrdiff_t(n), spawner.getEntities().data.end() };
+}
+
+inline std::pair<EntityManager::EPoolCIter_t, EntityManager::EPoolCIter_t> EntityManager::instantiate(Entity prototype, std::size_t n)
+{
+    EPP_ASSERT(entList.isValid(prototype));
+    EntitySpawner& spawner = getSpawner(prototype);
+    entList.fitNextN(n);
+    spawner.instantiate(entList.get(prototype).poolIdx, n, entList);
+    if (!indices.empty())
+        for (auto it = spawner.getEntities().data.end() - std::ptrdiff_t(n); it != spawner.getEntities().data.end(); ++it)
+            updateIndices(*it, CMask());
+    return { spawner.getEntities().data.end() - std::ptrdiff_t(n), spawner.getEntities().data.end() };
+}
+
+template <typename FnType>
+inline IterTimeChange EntityManager::changeArchetype(Entity ent, Archetype const& newArchetype, FnType fn)
+{
+    EPP_ASSERT(entList.isValid(ent));
+    EntitySpawner& spawner = getSpawner(ent);
+    if (spawner.mask != newArchetype.getMask()) {
+        getSpawner(newArchetype).moveEntityHere(ent, entList, spawner, std::move(fn));
+        if (!indices.empty())
+            updateIndices(ent, spawner.mask);
+        return IterTimeChange::ArchetypeCurrent;
+    }
+    return IterTimeChange::ChangeFailed;
+}
+
+template <typename FnType>
+inline IterTimeChange EntityManager::changeArchetype(Entity ent, IdList_t toRemove, IdList_t toAdd, FnType fn)
+{
+    EPP_ASSERT(entList.isValid(ent));
+    return changeArchetype(ent, getSpawner(ent).makeArchetype().removeComponent(toRemove).addComponent(toAdd), std::move(fn));
+}
+
+inline void EntityManager::queueArchetypeChange(Entity ent, Archetype const& newArchetype)
+{
+    EPP_ASSERT(entList.isValid(ent));
+    queuedChanges.emplace_back(ent, getSpawner(newArchetype).spawnerId);
+}
+
+template <typename FnType>
+inline void EntityManager::applyArchetypeChanges(FnType fn)
+{
+    // the last queued change of each entity wins - reversed, so it is the first one of its entity after the stable sort
+    std::reverse(queuedChanges.begin(), queuedChanges.end());
+    auto byEntity = [](auto const& lhs, auto const& rhs) {
+        return std::make_pair(lhs.first.listIdx.value, lhs.first.version.value) < std::make_pair(rhs.first.listIdx.value, rhs.first.version.value);
+    };
+    std::stable_sort(queuedChanges.begin(), queuedChanges.end(), byEntity);
+    auto sameEntity = [](auto const& lhs, auto const& rhs) { return lhs.first == rhs.first; };
+    queuedChanges.erase(std::unique(queuedChanges.begin(), queuedChanges.end(), sameEntity), queuedChanges.end());
+
+    changeKeys.clear();
+    for (auto [ent, dstId] : queuedChanges)
+        if (entList.isValid(ent) && entList.get(ent).spawnerId != dstId)
+            changeKeys.emplace_back(std::uint64_t(dstId.value) << 32 | entList.get(ent).spawnerId.value, ent);
+    queuedChanges.clear();
+    std::sort(changeKeys.begin(), changeKeys.end(), [](auto const& lhs, auto const& rhs) { return lhs.first < rhs.first; });
+    for (auto key = changeKeys.begin(); key != changeKeys.end();) {
+        auto& dst = spawners[key->first >> 32];
+        auto& src = spawners[key->first & 0xFFFFFFFF];
+        destroyIdxs.clear();
+        for (auto group = key->first; key != changeKeys.end() && key->first == group; ++key)
+            destroyIdxs.push_back(entList.get(key->second).poolIdx.value); // each entity is moved once
+        std::sort(destroyIdxs.begin(), destroyIdxs.end());
+        dst.moveEntitiesHere(destroyIdxs, entList, src, fn);
+        if (!indices.empty())
+            for (auto it = dst.getEntities().data.end() - std::ptrdiff_t(destroyIdxs.size()); it != dst.getEntities().data.end(); ++it)
+                updateIndices(*it, src.mask);
+    }
+}
+
+inline std::size_t EntityManager::eraseInvalid(std::vector<Entity>& ents) const
+{
+    auto newEnd = ents.begin() + (entList.removeInvalid(ents.data(), ents.data() + ents.size()) - ents.data());
+    std::size_t removed = std::size_t(ents.end() - newEnd);
+    ents.erase(newEnd, ents.end());
+    return removed;
+}
+
+inline void EntityManager::destroy(Entity ent)
+{
+    EPP_ASSERT(entList.isValid(ent));
+    getSpawner(ent).destroy(ent, entList);
+    if (!indices.empty())
+        unindex(ent);
+    if (!sparseSets.empty())
+        eraseSparse(ent);
+}
+
+template <typename EntIt>
+inline void EntityManager::destroy(EntIt first, EntIt last)
+{
+    destroyKeys.clear();
+    for (; first != last; ++first) {
+        Entity ent = *first;
+        EPP_ASSERT(entList.isValid(ent));
+        auto cell = entList.get(ent);
+        destroyKeys.push_back(std::uint64_t(cell.spawnerId.value) << 32 | cell.poolIdx.value);
+    }
+    destroyBatch();
+}
+
+inline void EntityManager::destroyBatch()
+{
+    std::sort(destroyKeys.begin(), destroyKeys.end());
+    destroyKeys.erase(std::unique(destroyKeys.begin(), destroyKeys.end()), destroyKeys.end());
+    for (auto key = destroyKeys.begin(); key != destroyKeys.end();) {
+        auto& spawner = spawners[*key >> 32];
+        destroyIdxs.clear();
+        for (; key != destroyKeys.end() && (*key >> 32) == spawner.spawnerId.value; ++key) {
+            std::size_t idx = *key & 0xFFFFFFFF;
+            destroyIdxs.push_back(idx);
+            if (!indices.empty())
+                unindex(spawner.getEntities().data[idx]);
+            if (!sparseSets.empty())
+                eraseSparse(spawner.getEntities().data[idx]);
+        }
+        spawner.destroy(destroyIdxs, entList);
+    }
+}
+
+inline void EntityManager::destroyMarked(std::vector<Entity>& marked)
+{
+    // marked entities could have been destroyed in the meantime
+    marked.erase(std::remove_if(marked.begin(), marked.end(), [this](Entity ent) { return !entList.isValid(ent); }), marked.end());
+    destroy(marked.begin(), marked.end());
+}
+
+inline void EntityManager::clear()
 {
     for (auto& spawner : spawners)
         spawner.clear();
     entList.freeAll();
+    for (auto& index : indices)
+        index->clear();
+    for (auto& set : sparseSets)
+        if (set)
+            set->clear();
+}
+
+inline void EntityManager::save(std::ostream& os) const
+{
+    EPP_ASSERTA_M(isTriviallyCopyable(), "Only trivially copyable components and resources can be saved"); // validate before writing anything
+
+    WriteValue(os, SnapshotMagic);
+    WriteValue(os, SnapshotVersion);
+    entList.save(os);
+    WriteValue(os, std::uint64_t(spawners.size()));
+    for (auto const& spawner : spawners) {
+        saveArchetype(os, spawner);
+        spawner.save(os);
+    }
+    resources.save(os);
+}
+
+inline void EntityManager::load(std::istream& is)
+{
+    load(is, nullptr);
+}
+
+inline void EntityManager::loadMapped(std::string const& path)
+{
+    auto file = std::make_shared<MappedFile>(path);
+    MemoryBuf buf(file->data(), file->size());
+    std::istream is(&buf);
+    load(is, file);
+}
+
+inline void EntityManager::load(std::istream& is, std::shared_ptr<void> const& memoryOwner)
+{
+    EPP_ASSERTA_M(ReadValue<std::uint32_t>(is) == SnapshotMagic, "Not a snapshot of EntityManager");
+    EPP_ASSERTA_M(ReadValue<std::uint32_t>(is) == SnapshotVersion, "Unsupported version of the snapshot");
+    clear();
+    try {
+        entList.load(is);
+        auto spawnersNum = std::size_t(ReadValue<std::uint64_t>(is));
+        for (std::size_t i = 0; i < spawnersNum; ++i)
+            loadArchetype(is, i).load(is, memoryOwner);
+        resources.load(is);
+    } catch (...) {
+        clear();
+        throw;
+    }
+    rebuildIndices();
+}
+
+inline void EntityManager::trackChanges(bool enable)
+{
+    trackingChanges = enable;
+    baselineFrameId = 0;
+    entList.trackChanges(enable);
+    for (auto& spawner : spawners)
+        spawner.trackChanges(enable);
+}
+
+inline void EntityManager::saveDelta(std::ostream& os)
+{
+    EPP_ASSERTA_M(trackingChanges, "Changes are not tracked");
+    EPP_ASSERTA_M(isTriviallyCopyable(), "Only trivially copyable components and resources can be saved"); // validate before writing anything
+    WriteValue(os, DeltaMagic);
+    WriteValue(os, SnapshotVersion);
+    entList.saveChanges(os);
+    WriteValue(os, std::uint64_t(spawners.size()));
+    for (auto const& spawner : spawners) {
+        saveArchetype(os, spawner);
+        spawner.saveChanges(os);
+    }
+    resources.save(os);
+    resetBaseline(0);
+}
+
+inline void EntityManager::loadDelta(std::istream& is)
+{
+    EPP_ASSERTA_M(ReadValue<std::uint32_t>(is) == DeltaMagic, "Not a delta of EntityManager");
+    EPP_ASSERTA_M(ReadValue<std::uint32_t>(is) == SnapshotVersion, "Unsupported version of the delta");
+    entList.loadChanges(is);
+    auto spawnersNum = std::size_t(ReadValue<std::uint64_t>(is));
+    for (std::size_t i = 0; i < spawnersNum; ++i)
+        loadArchetype(is, i).loadChanges(is);
+    resources.load(is);
+    rebuildIndices();
+    if (!sparseSets.empty())
+        eraseInvalidSparse();
+}
+
+inline void EntityManager::snapshotInto(WorldFrame& frame)
+{
+    EPP_ASSERTA_M(isTriviallyCopyable(), "Only trivially copyable components and resources can be copied");
+    frame.entList.copyFrom(entList);
+    frame.entList.assignChanges(entList.getChanges());
+    frame.spawners.resize(spawners.size());
+    for (std::size_t i = 0; i < spawners.size(); ++i)
+        spawners[i].copyInto(frame.spawners[i]);
+    resources.copyInto(frame.resources);
+    frame.id = WorldFrame::NextId();
+    frame.previousId = trackingChanges ? baselineFrameId : 0;
+    if (trackingChanges)
+        resetBaseline(frame.id);
+}
+
+inline void EntityManager::restoreFrom(WorldFrame const& frame)
+{
+    restoreFrom(frame, static_cast<WorldFrame const*>(nullptr), static_cast<WorldFrame const*>(nullptr));
+}
+
+template <typename FrameIter>
+inline void EntityManager::restoreFrom(WorldFrame const& frame, FrameIter newerFirst, FrameIter newerLast)
+{
+    bool onlyChanged = trackingChanges && !frame.isEmpty();
+    std::uint64_t lastId = frame.id;
+    for (auto it = newerFirst; onlyChanged && it != newerLast; ++it) {
+        WorldFrame const& newer = *it;
+        onlyChanged = newer.previousId == lastId;
+        lastId = newer.id;
+    }
+    onlyChanged = onlyChanged && lastId == baselineFrameId;
+    for (auto it = newerFirst; onlyChanged && it != newerLast; ++it) { // blocks modified in any of the newer frames differ too
+        WorldFrame const& newer = *it;
+        entList.mergeChanges(newer.entList.getChanges());
+        for (std::size_t i = 0; i < spawners.size() && i < newer.spawners.size(); ++i)
+            spawners[i].mergeChanges(newer.spawners[i]);
+    }
+    restore(frame, onlyChanged);
+}
+
+inline std::uint64_t EntityManager::checksum(CMask const& excluded)
+{
+    std::uint64_t hash = HashCombine(0, entList.size());
+    for (auto& spawner : spawners)
+        if (!spawner.getEntities().data.empty())
+            hash = HashCombine(HashCombine(hash, spawner.spawnerId.value), spawner.checksum(excluded));
+    return hash;
 }
 
 inline void EntityManager::clear(Archetype const& arch)
 {
-    if (auto spawner = findSpawner(arch); spawner != spawners.end())
+    if (auto spawner = findSpawner(arch); spawner != spawners.end()) {
+        if (!indices.empty())
+            for (auto ent : spawner->getEntities().data)
+                unindex(ent);
+        if (!sparseSets.empty())
+            for (auto ent : spawner->getEntities().data)
+                eraseSparse(ent);
         spawner->clear(entList);
+    }
 }
 
 inline void EntityManager::prepareToSpawn(Archetype const& arch, std::size_t n)
@@ -284,11 +1274,249 @@ inline void EntityManager::shrinkToFit()
         spawner.shrinkToFit();
 }
 
+inline void EntityManager::reserveVirtual(Archetype const& arch, std::size_t maxN)
+{
+    getSpawner(arch).reserveVirtual(maxN);
+}
+
 template <typename... CTypes>
 inline void EntityManager::updateSelection(Selection<CTypes...>& selection)
 {
     while (selection.checkedSpawnersNum < spawners.size())
         selection.addSpawnerIfMeetsRequirements(spawners[selection.checkedSpawnersNum++]);
+    selection.entList = &entList;
+    selection.owner = this;
+    selection.destroyMarked = [](void* owner, std::vector<Entity>& marked) { static_cast<EntityManager*>(owner)->destroyMarked(marked); };
+    if constexpr (sizeof...(CTypes) > 0)
+        (bindStorage<CTypes>(selection), ...);
+}
+
+inline ObserverId EntityManager::observe(CMask wanted, Observer::Callback_t callback, CMask unwanted)
+{
+    EPP_ASSERT(callback);
+    ObserverId id(observers.size());
+    observers.emplace_back(std::move(wanted), std::move(unwanted), std::move(callback));
+    for (auto& spawner : spawners)
+        updateObserved(spawner);
+    return id;
+}
+
+inline void EntityManager::removeObserver(ObserverId id)
+{
+    EPP_ASSERT(id.value < observers.size() && observers[id.value].isActive());
+    observers[id.value].deactivate();
+    if (notifyDepth == 0) // otherwise the callback may be running, it is released after the notification
+        observers[id.value].releaseCallback();
+    for (auto& spawner : spawners)
+        updateObserved(spawner);
+}
+
+inline void EntityManager::notifyObservers()
+{
+    // local batches - a callback may call notifyObservers again, the members only keep the memory between the calls
+    EntityEvents_t batch;
+    EntityEvents_t scratch;
+    batch.swap(eventsBatch);
+    scratch.swap(eventsScratch);
+    ++notifyDepth;
+    try {
+        // indices instead of iterators - observers may spawn entities (and create new spawners) or register other observers
+        for (std::size_t sIdx = 0; sIdx < spawners.size(); ++sIdx) {
+            if (spawners[sIdx].getEvents().empty())
+                continue;
+            CMask const& spawnerMask = spawners[sIdx].mask;
+            spawners[sIdx].takeEvents(batch); // events recorded during the callbacks will be delivered on the next call
+            for (std::size_t oIdx = 0; oIdx < observers.size(); ++oIdx) {
+                Observer const& observer = observers[oIdx];
+                if (!observer.meetsRequirements(spawnerMask))
+                    continue;
+                // moves between two spawners accepted by the same observer are not reported to it
+                auto isReported = [&](EntityEvent const& event) {
+                    return (event.type != EntityEvent::Type::Arrival && event.type != EntityEvent::Type::Departure) ||
+                           !observer.meetsRequirements(spawners[event.otherSpawnerId.value].mask);
+                };
+                if (std::all_of(batch.begin(), batch.end(), isReported))
+                    observer.notify(batch);
+                else {
+                    scratch.clear();
+                    std::copy_if(batch.begin(), batch.end(), std::back_inserter(scratch), isReported);
+                    if (scratch.size())
+                        observer.notify(scratch);
+                }
+            }
+        }
+    } catch (...) {
+        --notifyDepth;
+        throw;
+    }
+    if (--notifyDepth == 0) // no callback is running, the removed ones can be destroyed
+        for (auto& observer : observers)
+            if (!observer.isActive())
+                observer.releaseCallback();
+    eventsBatch.swap(batch);
+    eventsScratch.swap(scratch);
+}
+
+template <typename CType, typename KeyFn>
+inline ComponentIndex<CType, KeyFn> const& EntityManager::addIndex(KeyFn keyFn)
+{
+    auto index = std::make_unique<ComponentIndex<CType, KeyFn>>(std::move(keyFn), memoryResource);
+    auto& ref = *index;
+    indices.push_back(std::move(index));
+    rebuildIndices(); // indexes the existing entities
+    return ref;
+}
+
+inline void EntityManager::reindex(Entity ent)
+{
+    EPP_ASSERT(entList.isValid(ent));
+    updateIndices(ent, CMask());
+}
+
+inline void EntityManager::setParent(Entity child, Entity parent)
+{
+    hierarchy.setParent(child, parent, entList);
+}
+
+inline void EntityManager::sortHierarchy()
+{
+    hierarchy.rebuild(entList);
+    std::vector<std::vector<std::size_t>> slots(spawners.size()); // pool indices of the hierarchy's entities, in the order of the hierarchy
+    for (auto const& link : hierarchy.getOrder()) {
+        auto cell = entList.get(link.entity);
+        slots[cell.spawnerId.value].push_back(cell.poolIdx.value);
+    }
+    std::vector<std::size_t> sortedSlots;
+    std::vector<std::size_t> order;
+    for (std::size_t s = 0; s < spawners.size(); ++s) {
+        sortedSlots = slots[s];
+        std::sort(sortedSlots.begin(), sortedSlots.end());
+        if (sortedSlots == slots[s])
+            continue;
+        order.resize(spawners[s].getEntities().data.size());
+        std::iota(order.begin(), order.end(), std::size_t(0));
+        for (std::size_t k = 0; k < sortedSlots.size(); ++k)
+            order[sortedSlots[k]] = slots[s][k];
+        spawners[s].permute(order, entList);
+    }
+}
+
+template <typename CType, typename Func>
+inline void EntityManager::forEachHierarchy(Func func)
+{
+    static_assert(std::is_invocable_v<Func, Entity, CType const&, CType&>);
+    if (hierarchy.isDirty())
+        sortHierarchy();
+
+    collectHierarchyPools(IdOf<CType>());
+    for (auto const& link : hierarchy.getOrder())
+        if (!propagateToChild<CType>(link, func, true))
+            hierarchy.markDirty();
+}
+
+template <typename CType, typename Func>
+inline void EntityManager::forEachHierarchy(Func func, ThreadPool& pool, std::size_t threadsNum)
+{
+    static_assert(std::is_invocable_v<Func, Entity, CType const&, CType&>);
+    if (hierarchy.isDirty())
+        sortHierarchy();
+
+    collectHierarchyPools(IdOf<CType>());
+    for (CPool* cPool : hierarchyPools) // before the threads start, DirtyBlocks are not synchronized
+        if (cPool)
+            cPool->markChanged(0, cPool->size());
+
+    if (threadsNum == 0)
+        threadsNum = pool.size();
+    auto const& order = hierarchy.getOrder();
+    auto const& depthBegins = hierarchy.getDepthBegins();
+    std::atomic<bool> stale{ false };
+    for (std::size_t depth = 1; depth + 1 < depthBegins.size(); ++depth) { // roots (depth 0) have no parents
+        std::size_t first = depthBegins[depth];
+        std::size_t last = depthBegins[depth + 1];
+        std::atomic<std::size_t> nextChunk{ first };
+        auto work = [&]() {
+            for (std::size_t chunk; (chunk = nextChunk.fetch_add(HierarchyChunkSize)) < last;)
+                for (std::size_t pos = chunk; pos < std::min(chunk + HierarchyChunkSize, last); ++pos)
+                    if (!propagateToChild<CType>(order[pos], func, false))
+                        stale = true;
+        };
+        pool.run(work, std::min(threadsNum, (last - first + HierarchyChunkSize - 1) / HierarchyChunkSize));
+    }
+    if (stale)
+        hierarchy.markDirty();
+}
+
+inline void EntityManager::collectHierarchyPools(ComponentId cId)
+{
+    hierarchyPools.assign(spawners.size(), nullptr);
+    for (auto& spawner : spawners)
+        if (spawner.mask.get(cId))
+            hierarchyPools[spawner.spawnerId.value] = &spawner.getPool(cId);
+}
+
+template <typename CType, typename Func>
+inline bool EntityManager::propagateToChild(Hierarchy::Link const& link, Func& func, bool markChanged)
+{
+    if (link.parentPos == Hierarchy::BadPos)
+        return true;
+    Entity parent = hierarchy.getOrder()[link.parentPos].entity;
+    if (!entList.isValid(link.entity) || !entList.isValid(parent)) // destroyed since the last sort
+        return false;
+    auto childCell = entList.get(link.entity);
+    auto parentCell = entList.get(parent);
+    CPool* childPool = hierarchyPools[childCell.spawnerId.value];
+    CPool const* parentPool = hierarchyPools[parentCell.spawnerId.value];
+    if (!childPool || !parentPool)
+        return true;
+    // the const operator[] does not mark the component, the parallel pass marks the pools up front
+    void* child = markChanged ? (*childPool)[childCell.poolIdx.value] : const_cast<void*>(std::as_const(*childPool)[childCell.poolIdx.value]);
+    func(link.entity, *static_cast<CType const*>((*parentPool)[parentCell.poolIdx.value]), *static_cast<CType*>(child));
+    return true;
+}
+
+template <typename CType, typename KeyFn>
+inline void EntityManager::sortSpawner(Archetype const& arch, KeyFn keyFn)
+{
+    EPP_ASSERT(arch.has(IdOf<CType>()));
+    auto spawner = findSpawner(arch);
+    if (spawner == spawners.end())
+        return;
+    auto keys = sortKeysOf<CType>(*spawner, keyFn);
+    if (std::is_sorted(keys.begin(), keys.end()))
+        return;
+    std::vector<std::size_t> order(keys.size());
+    std::iota(order.begin(), order.end(), std::size_t(0));
+    std::stable_sort(order.begin(), order.end(), [&](std::size_t l, std::size_t r) { return keys[l] < keys[r]; });
+    spawner->permute(order, entList);
+}
+
+template <typename CType, typename KeyFn>
+inline void EntityManager::resortSpawner(Archetype const& arch, KeyFn keyFn)
+{
+    EPP_ASSERT(arch.has(IdOf<CType>()));
+    auto spawner = findSpawner(arch);
+    if (spawner == spawners.end())
+        return;
+    auto keys = sortKeysOf<CType>(*spawner, keyFn);
+    auto less = [&](std::size_t l, std::size_t r) { return keys[l] < keys[r]; };
+
+    // an entity stays in place if it does not break the order of the kept ones, nor is greater than its successor
+    std::vector<std::size_t> kept;
+    std::vector<std::size_t> moved;
+    kept.reserve(keys.size());
+    for (std::size_t i = 0; i < keys.size(); ++i) {
+        if ((kept.empty() || !less(i, kept.back())) && (i + 1 == keys.size() || !less(i + 1, i)))
+            kept.push_back(i);
+        else
+            moved.push_back(i);
+    }
+    if (moved.empty())
+        return;
+    std::stable_sort(moved.begin(), moved.end(), less);
+    std::vector<std::size_t> order(keys.size());
+    std::merge(kept.begin(), kept.end(), moved.begin(), moved.end(), order.begin(), less);
+    spawner->permute(order, entList);
 }
 
 inline EntityList::Cell::Occupied EntityManager::cellOf(Entity ent) const
@@ -304,6 +1532,188 @@ inline TComp& EntityManager::componentOf(Entity ent)
     return *static_cast<TComp*>(getSpawner(ent).getPool(IdOf<TComp>())[entList.get(ent).poolIdx.value]);
 }
 
+template <typename TComp>
+inline TComp const& EntityManager::componentOf(Entity ent) const
+{
+    EPP_ASSERT(entList.isValid(ent) && getSpawner(ent).mask.get(IdOf<TComp>()));
+    return *static_cast<TComp const*>(getSpawner(ent).getPool(IdOf<TComp>())[entList.get(ent).poolIdx.value]);
+}
+
+template <typename... CTypes>
+inline std::tuple<CTypes&...> EntityManager::componentsOf(Entity ent)
+{
+    EPP_ASSERT(entList.isValid(ent));
+    auto cell = entList.get(ent);
+    EntitySpawner& spawner = spawners[cell.spawnerId.value];
+    EPP_ASSERT(spawner.mask.contains(CMask(IdOfL<std::remove_const_t<CTypes>...>())));
+    return std::tuple<CTypes&...>(ComponentAt<CTypes>(spawner.getPool(IdOf<std::remove_const_t<CTypes>>()), cell.poolIdx)...);
+}
+
+template <typename... CTypes>
+inline std::tuple<CTypes const&...> EntityManager::componentsOf(Entity ent) const
+{
+    EPP_ASSERT(entList.isValid(ent));
+    auto cell = entList.get(ent);
+    EntitySpawner const& spawner = spawners[cell.spawnerId.value];
+    EPP_ASSERT(spawner.mask.contains(CMask(IdOfL<std::remove_const_t<CTypes>...>())));
+    return std::tuple<CTypes const&...>(*static_cast<CTypes const*>(spawner.getPool(IdOf<std::remove_const_t<CTypes>>())[cell.poolIdx.value])...);
+}
+
+template <typename... CTypes, typename FnType>
+inline void EntityManager::gather(Entity const* ents, std::size_t n, FnType func, bool sortByLocation)
+{
+    static_assert(std::is_invocable_v<FnType, Entity, CTypes&...>);
+    constexpr std::size_t CellDistance = 16;     // the cell of ents[i + CellDistance] is prefetched in the i-th iteration
+    constexpr std::size_t ComponentDistance = 8; // and the components of ents[i + ComponentDistance]
+
+    using Pools_t = std::array<CPool*, sizeof...(CTypes)>;
+    SpawnerId usedId, prefetchedId;
+    Pools_t used{}, prefetched{};
+    for (std::size_t i = 0; i < std::min(n, CellDistance); ++i)
+        entList.prefetch(ents[i]);
+
+    if (sortByLocation) {
+        gatherKeys.clear();
+        for (std::size_t i = 0; i < n; ++i) {
+            if (i + CellDistance < n)
+                entList.prefetch(ents[i + CellDistance]);
+            EPP_ASSERT(entList.isValid(ents[i]));
+            auto cell = entList.get(ents[i]);
+            gatherKeys.push_back(std::uint64_t(cell.spawnerId.value) << 32 | cell.poolIdx.value);
+        }
+        std::sort(gatherKeys.begin(), gatherKeys.end());
+        for (auto key : gatherKeys) { // components are read sequentially, the hardware prefetcher is enough
+            SpawnerId spawnerId(std::uint32_t(key >> 32));
+            PoolIdx idx(std::uint32_t(key & 0xFFFFFFFF));
+            Entity ent = spawners[spawnerId.value].getEntities().data[idx.value];
+            CallWithComponents<CTypes...>(func, ent, poolsOf<CTypes...>(spawnerId, usedId, used), idx, std::index_sequence_for<CTypes...>());
+        }
+        return;
+    }
+
+    for (std::size_t i = 0; i < n; ++i) {
+        if (i + CellDistance < n)
+            entList.prefetch(ents[i + CellDistance]);
+        if (i + ComponentDistance < n && entList.isValid(ents[i + ComponentDistance])) { // the cell should be in the cache by now
+            auto cell = entList.get(ents[i + ComponentDistance]);
+            for (CPool* pool : poolsOf<CTypes...>(cell.spawnerId, prefetchedId, prefetched))
+                Prefetch(std::as_const(*pool)[cell.poolIdx.value]);
+        }
+        EPP_ASSERT(entList.isValid(ents[i]));
+        auto cell = entList.get(ents[i]);
+        CallWithComponents<CTypes...>(func, ents[i], poolsOf<CTypes...>(cell.spawnerId, usedId, used), cell.poolIdx, std::index_sequence_for<CTypes...>());
+    }
+}
+
+template <typename... CTypes, typename FnType, std::size_t... Is>
+inline void EntityManager::CallWithComponents(FnType& func, Entity ent, std::array<CPool*, sizeof...(CTypes)> const& pools, PoolIdx idx, std::index_sequence<Is...>)
+{
+    func(ent, ComponentAt<CTypes>(*pools[Is], idx)...);
+}
+
+template <typename... CTypes>
+inline std::array<CPool*, sizeof...(CTypes)>& EntityManager::poolsOf(SpawnerId spawnerId, SpawnerId& cachedId, std::array<CPool*, sizeof...(CTypes)>& cached)
+{
+    if (spawnerId != cachedId) {
+        EntitySpawner& spawner = spawners[spawnerId.value];
+        EPP_ASSERT(spawner.mask.contains(CMask(IdOfL<std::remove_const_t<CTypes>...>())));
+        cached = { &spawner.getPool(IdOf<std::remove_const_t<CTypes>>())... };
+        cachedId = spawnerId;
+    }
+    return cached;
+}
+
+template <typename CType>
+inline CType& EntityManager::ComponentAt(CPool& pool, PoolIdx idx)
+{
+    if constexpr (std::is_const_v<CType>)
+        return *static_cast<CType*>(std::as_const(pool)[idx.value]); // const access does not mark the component
+    else
+        return *static_cast<CType*>(pool[idx.value]);
+}
+
+template <typename T>
+inline SoARef<T> EntityManager::fieldsOf(Entity ent)
+{
+    EPP_ASSERT(entList.isValid(ent) && getSpawner(ent).mask.contains(CMask(IdOfFields<T>())));
+    typename SoARef<T>::Arrays_t arrays;
+    auto id = IdOfFields<T>().begin();
+    for (auto& array : arrays) {
+        auto& pool = getSpawner(ent).getPool(*id++);
+        pool.markChanged(entList.get(ent).poolIdx.value, entList.get(ent).poolIdx.value + 1);
+        array = pool.rawData();
+    }
+    return SoARef<T>(arrays, entList.get(ent).poolIdx.value);
+}
+
+template <typename T>
+inline SoARef<T const> EntityManager::fieldsOf(Entity ent) const
+{
+    EPP_ASSERT(entList.isValid(ent) && getSpawner(ent).mask.contains(CMask(IdOfFields<T>())));
+    typename SoARef<T const>::Arrays_t arrays;
+    auto id = IdOfFields<T>().begin();
+    for (auto& array : arrays)
+        array = const_cast<void*>(getSpawner(ent).getPool(*id++).rawData());
+    return SoARef<T const>(arrays, entList.get(ent).poolIdx.value);
+}
+
+template <typename T, typename... Args>
+inline Shared<T> EntityManager::makeShared(Args&&... args)
+{
+    return sharedStoreOf<T>().make(std::forward<Args>(args)...);
+}
+
+template <typename T>
+inline void EntityManager::releaseShared(Shared<T> handle)
+{
+    EPP_ASSERT_M(!isSharedUsed(handle), "The shared value is used by an entity");
+    sharedStoreOf<T>().release(handle);
+}
+
+template <typename T>
+inline T const& EntityManager::shared(Shared<T> handle) const
+{
+    auto id = IdOf<Shared<T>>().value;
+    EPP_ASSERT(id < sharedStores.size() && sharedStores[id]);
+    return static_cast<SharedStore<T> const&>(*sharedStores[id]).get(handle);
+}
+
+template <typename CType, typename... Args>
+inline CType& EntityManager::addSparse(Entity ent, Args&&... args)
+{
+    static_assert(IsSparse_v<CType>, "Specialize SparseStorage for sparse components");
+    EPP_ASSERT(entList.isValid(ent));
+    return sparseSetOf<CType>().emplace(ent, std::forward<Args>(args)...);
+}
+
+template <typename CType>
+inline void EntityManager::removeSparse(Entity ent)
+{
+    static_assert(IsSparse_v<CType>, "Specialize SparseStorage for sparse components");
+    sparseSetOf<CType>().erase(ent);
+}
+
+template <typename CType>
+inline CType* EntityManager::findSparse(Entity ent)
+{
+    static_assert(IsSparse_v<CType>, "Specialize SparseStorage for sparse components");
+    return sparseSetOf<CType>().find(ent);
+}
+
+template <typename T>
+inline T& EntityManager::resource()
+{
+    EPP_ASSERT(resources.find<T>());
+    return *resources.find<T>();
+}
+
+template <typename T>
+inline T const& EntityManager::resource() const
+{
+    EPP_ASSERT(resources.find<T>());
+    return *resources.find<T>();
+}
+
 inline CMask EntityManager::maskOf(Entity ent) const
 {
     EPP_ASSERT(entList.isValid(ent));
@@ -338,11 +1748,181 @@ inline EntitySpawner& EntityManager::_prepareToSpawn(Archetype const& arch, std:
     return spawner;
 }
 
+template <typename CType, typename KeyFn>
+inline auto EntityManager::sortKeysOf(EntitySpawner const& spawner, KeyFn& keyFn) const
+{
+    static_assert(std::is_invocable_v<KeyFn, CType const&>);
+    using Key_t = std::decay_t<std::invoke_result_t<KeyFn, CType const&>>;
+    CPool const& pool = spawner.getPool(IdOf<CType>());
+    std::vector<Key_t> keys;
+    keys.reserve(pool.size());
+    for (std::size_t i = 0; i < pool.size(); ++i)
+        keys.push_back(keyFn(*static_cast<CType const*>(pool[i])));
+    return keys;
+}
+
+template <typename T>
+inline SharedStore<T>& EntityManager::sharedStoreOf()
+{
+    auto id = IdOf<Shared<T>>().value;
+    if (sharedStores.size() <= id)
+        sharedStores.resize(std::size_t(id) + 1);
+    if (!sharedStores[id])
+        sharedStores[id] = std::make_unique<SharedStore<T>>();
+    return static_cast<SharedStore<T>&>(*sharedStores[id]);
+}
+
+template <typename T>
+inline bool EntityManager::isSharedUsed(Shared<T> handle) const
+{
+    for (auto const& spawner : spawners) {
+        if (!spawner.mask.get(IdOf<Shared<T>>()))
+            continue;
+        auto const& pool = spawner.getPool(IdOf<Shared<T>>());
+        for (std::size_t i = 0; i < pool.size(); ++i)
+            if (*static_cast<Shared<T> const*>(pool[i]) == handle)
+                return true;
+    }
+    return false;
+}
+
+template <typename CType>
+inline SparseSet<CType>& EntityManager::sparseSetOf()
+{
+    auto id = SparseSetBase::IdOf<CType>();
+    if (sparseSets.size() <= id)
+        sparseSets.resize(id + 1);
+    if (!sparseSets[id])
+        sparseSets[id] = std::make_unique<SparseSet<CType>>(memoryResource);
+    return static_cast<SparseSet<CType>&>(*sparseSets[id]);
+}
+
+template <typename CType, typename... CTypes>
+inline void EntityManager::bindStorage(Selection<CTypes...>& selection)
+{
+    if constexpr (IsShared_v<CType>)
+        selection.template getStore<CType>() = &sharedStoreOf<typename std::remove_const_t<CType>::Value_t>();
+    if constexpr (IsSparse_v<CType>)
+        selection.template getSparse<CType>() = &sparseSetOf<std::remove_const_t<CType>>();
+}
+
+inline void EntityManager::eraseSparse(Entity ent)
+{
+    for (auto& set : sparseSets)
+        if (set)
+            set->erase(ent);
+}
+
+inline void EntityManager::eraseInvalidSparse()
+{
+    for (auto& set : sparseSets)
+        if (set)
+            set->eraseInvalid(entList);
+}
+
 inline EntitySpawner& EntityManager::getSpawner(Archetype const& arch)
 {
     if (auto found = findSpawner(arch); found != spawners.end())
         return *found;
-    return spawners.emplace_back(SpawnerId(spawners.size()), arch); // if not found, make one
+    return makeSpawner(arch); // if not found, make one
+}
+
+inline EntitySpawner& EntityManager::makeSpawner(Archetype const& arch)
+{
+    EntitySpawner& spawner = spawners.emplace_back(SpawnerId(spawners.size()), arch, memoryResource);
+    updateObserved(spawner);
+    spawner.trackChanges(trackingChanges);
+    return spawner;
+}
+
+inline void EntityManager::updateIndices(Entity ent, CMask const& oldMask)
+{
+    EntitySpawner const& spawner = getSpawner(ent);
+    auto poolIdx = entList.get(ent).poolIdx.value;
+    for (auto& index : indices) {
+        if (spawner.mask.get(index->getCId()))
+            index->insert(ent, spawner.getPool(index->getCId())[poolIdx]);
+        else if (oldMask.get(index->getCId()))
+            index->erase(ent);
+    }
+}
+
+inline void EntityManager::unindex(Entity ent)
+{
+    for (auto& index : indices)
+        index->erase(ent);
+}
+
+inline void EntityManager::rebuildIndices()
+{
+    for (auto& index : indices) {
+        index->clear();
+        for (auto const& spawner : spawners)
+            if (spawner.mask.get(index->getCId())) {
+                auto const& pool = spawner.getPool(index->getCId());
+                auto const& ents = spawner.getEntities().data;
+                for (std::size_t i = 0; i < ents.size(); ++i)
+                    index->insert(ents[i], pool[i]);
+            }
+    }
+}
+
+inline bool EntityManager::isTriviallyCopyable() const
+{
+    for (auto const& spawner : spawners) {
+        Archetype arch = spawner.makeArchetype(); // getCIds refers to the archetype
+        for (auto cId : arch.getCIds())
+            if (!CMetadata::GetData(cId).triviallyCopyable)
+                return false;
+    }
+    return resources.isTriviallyCopyable();
+}
+
+inline void EntityManager::resetBaseline(std::uint64_t frameId)
+{
+    baselineFrameId = frameId;
+    entList.clearChanges();
+    for (auto& spawner : spawners)
+        spawner.clearChanges();
+}
+
+inline void EntityManager::restore(WorldFrame const& frame, bool onlyChanged)
+{
+    EPP_ASSERTA_M(!frame.isEmpty(), "The frame does not contain a copy");
+    std::vector<Archetype> missing; // validate before changing anything
+    for (std::size_t i = 0; i < frame.spawners.size(); ++i) {
+        Archetype arch;
+        for (auto const& pool : frame.spawners[i].cPools)
+            arch.addComponent(pool.getCId());
+        if (i < spawners.size()) {
+            EPP_ASSERTA_M(spawners[i].mask == arch.getMask(), "The frame does not match this EntityManager");
+        } else {
+            EPP_ASSERTA_M(findSpawner(arch) == spawners.end(), "The frame does not match this EntityManager");
+            missing.push_back(std::move(arch));
+        }
+    }
+    resources.restoreFrom(frame.resources); // validates before changing anything too
+    for (auto const& arch : missing)
+        makeSpawner(arch);
+
+    if (onlyChanged)
+        entList.copyChangedFrom(frame.entList);
+    else
+        entList.copyFrom(frame.entList);
+    for (std::size_t i = 0; i < spawners.size(); ++i) {
+        if (i < frame.spawners.size())
+            spawners[i].restoreFrom(frame.spawners[i], onlyChanged);
+        else { // created after the frame was copied
+            bool observed = spawners[i].isObserved();
+            spawners[i].setObserved(false); // restoring records no events
+            spawners[i].clear();
+            spawners[i].setObserved(observed);
+        }
+    }
+    resetBaseline(trackingChanges ? frame.id : 0);
+    rebuildIndices();
+    if (!sparseSets.empty())
+        eraseInvalidSparse();
 }
 
 inline EntityManager::Spawners_t::iterator
@@ -357,6 +1937,65 @@ EntityManager::findSpawner(Archetype const& arch) const
     return std::find_if(spawners.begin(), spawners.end(), [mask = arch.getMask()](EntitySpawner const& spawner) { return spawner.mask == mask; });
 }
 
+inline void EntityManager::saveArchetype(std::ostream& os, EntitySpawner const& spawner) const
+{
+    Archetype arch = spawner.makeArchetype();
+    auto const& cIds = arch.getCIds();
+    WriteValue(os, std::uint32_t(cIds.size()));
+    for (auto cId : cIds)
+        WriteValue(os, cId);
+}
+
+inline EntitySpawner& EntityManager::loadArchetype(std::istream& is, std::size_t spawnerIdx)
+{
+    Archetype arch;
+    for (auto n = ReadValue<std::uint32_t>(is); n > 0; --n) {
+        auto cId = ReadValue<ComponentId>(is);
+        EPP_ASSERTA_M(CMetadata::IsRegistered(cId), "Snapshot contains unregistered components");
+        arch.addComponent(cId);
+    }
+    EPP_ASSERTA_M(spawnerIdx <= spawners.size(), "Corrupted snapshot");
+    if (spawnerIdx < spawners.size()) {
+        EPP_ASSERTA_M(spawners[spawnerIdx].mask == arch.getMask(), "Archetypes used by this EntityManager do not match the snapshot");
+        return spawners[spawnerIdx];
+    }
+    return makeSpawner(arch);
+}
+
+inline void EntityManager::updateObserved(EntitySpawner& spawner) const
+{
+    spawner.setObserved(std::any_of(observers.begin(), observers.end(), [&spawner](Observer const& observer) { return observer.meetsRequirements(spawner.mask); }));
+    if (!spawner.isObserved())
+        spawner.clearEvents();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+template <typename... CTypes>
+inline std::tuple<CTypes&...> EntityRef<CTypes...>::get()
+{
+    PoolIdx idx = locate();
+    return std::tuple<CTypes&...>(EntityManager::ComponentAt<CTypes>(*pools[IndexOf<CTypes>()], idx)...);
+}
+
+template <typename... CTypes>
+template <typename CType>
+inline CType& EntityRef<CTypes...>::get()
+{
+    static_assert(IndexOf<CType>() < sizeof...(CTypes), "CType has to be one of CTypes");
+    PoolIdx idx = locate();
+    return EntityManager::ComponentAt<CType>(*pools[IndexOf<CType>()], idx);
+}
+
+template <typename... CTypes>
+inline PoolIdx EntityRef<CTypes...>::locate()
+{
+    EPP_ASSERT(isValid());
+    auto cell = mgr->entList.get(ent);
+    mgr->poolsOf<CTypes...>(cell.spawnerId, spawnerId, pools); // looks up on the first access or after the entity changed its archetype
+    return cell.poolIdx;
+}
 
 } // namespace epp
 
@@ -2,7 +2,14 @@
 #define EPP_CPOOL_H
 
 #include <ECSpp/Component.h>
+#include <ECSpp/internal/utility/BinaryIO.h>
+#include <ECSpp/internal/utility/BlockHashes.h>
+#include <ECSpp/internal/utility/DirtyBlocks.h>
 #include <ECSpp/internal/utility/Pool.h>
+#include <ECSpp/internal/utility/VirtualRange.h>
+#include <cstring>
+#include <memory>
+#include <memory_resource>
 
 namespace epp {
 
@@ -18,8 +25,9 @@ public:
     /**
      * CPool uses the cId to get metadata from the CMetadata::GetData static function
      * @param cId A ComponentId returned from CMetadata::Id (or IdOf) function
+     * @param resource The resource used to allocate the components, their tracked changes and cached hashes
      */
-    explicit CPool(ComponentId cId);
+    explicit CPool(ComponentId cId, std::pmr::memory_resource* resource = std::pmr::get_default_resource());
 
 
     /// Move constructor
@@ -98,6 +106,18 @@ public:
     void construct(Idx_t idx, void* rValComp);
 
 
+    /// Appends n copies of the component located at a given index
+    /**
+     * Trivially copyable components are replicated with memcpy, the others with the copy constructor.
+     * If a copy constructor throws, the copies made so far are destroyed and the size does not change
+     * @param idx Index of the component to copy
+     * @param n Number of copies
+     * @throws (Debug only) Throws the AssertionFailed exception if idx is greater or equal to the size()
+     * @throws Throws the AssertionFailed exception if the component is not copyable (see CopyableComponent)
+     */
+    void replicate(Idx_t idx, std::size_t n);
+
+
     /// Calls the destructor on the component located at a given index
     /**
      * The last components is moved in place of the removed one
@@ -109,6 +129,14 @@ public:
     bool destroy(Idx_t idx);
 
 
+    /// Destroys many components in one pass, the holes are filled with the last components (see FillHolesFromTail)
+    /**
+     * @param sortedIdxs Sorted unique indices of the components to destroy
+     * @throws (Debug only) Throws the AssertionFailed exception if any of the indices is greater or equal to the size()
+     */
+    void destroy(std::vector<std::size_t> const& sortedIdxs);
+
+
     /// The next alloc(n) call or n alloc() calls will not require reallocation
     /** 
      * CPool will grow its capacity to the next power of 2 that will fit size() + n components 
@@ -125,6 +153,24 @@ public:
     void clear();
 
 
+    /// Changes the number of components to exactly n
+    /**
+     * @details If n < size() then the last components are destroyed
+     * @details If n > size() then new components are default-constructed at the end
+     * @param n New size
+     */
+    void resize(std::size_t n);
+
+
+    /// Reorders the components so that the component at index order[i] is moved to index i
+    /**
+     * Components are moved to a new buffer of the same capacity, only the moved components are marked as modified
+     * @param order A permutation of indices [0, size())
+     * @throws (Debug only) Throws the AssertionFailed exception if order.size() != size()
+     */
+    void permute(std::vector<std::size_t> const& order);
+
+
     /// Changes the capacity to exactly newReserved
     /**
      * @details If newReserved < size() then components that don't fit get destroyed
@@ -135,8 +181,25 @@ public:
     void reserve(std::size_t newReserved);
 
 
+    /// Moves the components into a range of addresses that fits maxN components, reserved up front
+    /**
+     * From now on growing the pool only commits the next pages of the range, so the components are never moved
+     * to make room for new ones and pointers to them stay valid (swap-remove in destroy still moves the last component).
+     * The range does not come from the memory resource of the pool. Adopting external storage leaves this mode
+     * @param maxN The maximal capacity of the pool, not lower than size()
+     * @throws Throws the AssertionFailed exception (in debug and release) if the range could not be reserved
+     * @throws (Debug only) Throws the AssertionFailed exception if maxN < size() or the components are aligned to more than a page
+     */
+    void reserveVirtual(std::size_t maxN);
+
+
+    /** @returns True if the pool grows in place (see reserveVirtual) */
+    bool isVirtual() const { return vRange.data() != nullptr; }
+
+
     /// Returns pointer to the component located at a given index
     /**
+     * When the change tracking is enabled, the component is assumed to be modified
      * @param idx Index of the component in this pool
      * @returns A Pointer to the component located at a given index
      * @throws (Debug only) Throws the AssertionFailed exception if idx is greater or equal to the size()
@@ -148,6 +211,146 @@ public:
     void const* operator[](Idx_t idx) const;
 
 
+    /// Writes the schema of the components (name hash, size, alignment) and all of the components as one contiguous block
+    /**
+     * @param os Binary output stream
+     * @throws Throws the AssertionFailed exception (in debug and release) if the components are not trivially copyable or if writing failed
+     */
+    void save(std::ostream& os) const;
+
+
+    /// Reads the components written by the save function and appends them to this pool
+    /**
+     * Components are read with a single read call, directly into the pool's memory.
+     * If the pool is empty, is reads from a MemoryBuf and memoryOwner is not null, the components are not copied at all -
+     * the pool adopts the memory of the buffer (see adopt)
+     * @param is Binary input stream
+     * @param memoryOwner An object that keeps the memory of the MemoryBuf alive
+     * @throws Throws the AssertionFailed exception (in debug and release) if the saved schema does not match 
+     * the metadata of this pool or if the stream ended unexpectedly
+     */
+    void load(std::istream& is, std::shared_ptr<void> const& memoryOwner = nullptr);
+
+
+    /// Makes the pool use externally owned storage, without copying the components
+    /**
+     * The storage is used until the pool has to grow, then the components are moved to the memory owned by the pool
+     * and memoryOwner is released. Components are never moved back to the external storage
+     * @param mem Address of n constructed components, aligned to the components' alignment
+     * @param n Number of components
+     * @param memoryOwner An object that keeps mem alive (e.g. a MappedFile), released when the pool stops using mem
+     * @throws (Debug only) Throws the AssertionFailed exception if the pool is not empty, if the components are
+     * not trivially copyable or if mem is not aligned
+     */
+    void adopt(void* mem, std::size_t n, std::shared_ptr<void> memoryOwner);
+
+
+    /// Returns whether the pool uses externally owned storage
+    bool isExternal() const { return bool(externalOwner); }
+
+
+    /// Enables or disables tracking of the modified blocks of components, the current state becomes a baseline
+    /**
+     * While enabled, every block of components that was created, destroyed, relocated or accessed with the non-const operator[] is marked as modified
+     * @param enable True to enable the tracking
+     */
+    void trackChanges(bool enable)
+    {
+        changes.enable(enable);
+        hashes.invalidate();
+    }
+
+
+    /// Marks the components in the range [first, last) as modified (used by writers that access rawData directly)
+    /**
+     * @param first Index of the first modified component
+     * @param last Index past the last modified component
+     */
+    void markChanged(Idx_t first, Idx_t last) { changes.mark(first, last); }
+
+
+    /// Returns the blocks of components modified since the baseline
+    DirtyBlocks const& getChanges() const { return changes; }
+
+
+    /// Makes the current state a new baseline
+    void clearChanges() { changes.clear(); }
+
+
+    /// Writes the size of the pool and the blocks of components modified since the baseline
+    /**
+     * @param os Binary output stream
+     * @throws Throws the AssertionFailed exception (in debug and release) if the components are not trivially copyable or if writing failed
+     */
+    void saveChanges(std::ostream& os) const;
+
+
+    /// Applies the changes written by the saveChanges function to a pool in the baseline state
+    /**
+     * @param is Binary input stream
+     * @throws Throws the AssertionFailed exception (in debug and release) if the saved schema does not match 
+     * the metadata of this pool or if the stream ended unexpectedly
+     */
+    void loadChanges(std::istream& is);
+
+
+    /// Marks every block that is marked in changes (e.g. changes recorded by another pool)
+    /**
+     * @param other Blocks of components to be marked as modified
+     */
+    void mergeChanges(DirtyBlocks const& other) { changes.merge(other); }
+
+
+    /// Replaces the blocks marked as modified with the ones marked in other
+    /**
+     * @param other Blocks of components to be marked as modified
+     */
+    void assignChanges(DirtyBlocks const& other) { changes.assign(other); }
+
+
+    /// Replaces the components with copies of src's components, reuses the reserved memory
+    /**
+     * Components are copied with a single memcpy, every copied block is marked as modified
+     * @param src A pool of the same type of components
+     * @throws Throws the AssertionFailed exception (in debug and release) if the components are not trivially copyable
+     * @throws (Debug only) Throws the AssertionFailed exception if src stores a different type of components
+     */
+    void copyFrom(CPool const& src);
+
+
+    /// Makes this pool equal to src, assuming that they differ only in the blocks marked as modified in this pool
+    /**
+     * Used to restore a copy of the baseline state - copies only the blocks modified since the baseline 
+     * (and the components past the current size)
+     * @param src A pool of the same type of components in the baseline state
+     * @throws Throws the AssertionFailed exception (in debug and release) if the components are not trivially copyable
+     * @throws (Debug only) Throws the AssertionFailed exception if src stores a different type of components
+     */
+    void copyChangedFrom(CPool const& src);
+
+
+    /// Returns the hash of the bytes of every component
+    /**
+     * When the change tracking is enabled, only the blocks modified since the last checksum call are rehashed.
+     * The components should have no padding bytes, otherwise the result is not deterministic
+     * @returns The hash of the components
+     * @throws Throws the AssertionFailed exception (in debug and release) if the components are not trivially copyable
+     */
+    std::uint64_t checksum();
+
+
+    /// Returns the address of the first component (the components are stored contiguously)
+    void* rawData() { return data; }
+
+
+    /** @copydoc CPool::rawData() */
+    void const* rawData() const { return data; }
+
+
+    /// Returns the metadata of the components stored in this pool
+    CMetadata const& getMetadata() const { return metadata; }
+
+
     /// Returns the ComponentId of this pool
     ComponentId getCId() const { return metadata.cId; }
 
@@ -164,21 +367,36 @@ private:
 
     void* addressAtIdx(void* base, Idx_t idx) const { return reinterpret_cast<void*>(static_cast<std::uint8_t*>(base) + metadata.size * std::uintptr_t(idx)); }
 
+    void* allocate(std::size_t n) { return resource->allocate(metadata.size * n, metadata.alignment); }
+
+    void deallocate(void* mem, std::size_t n) { resource->deallocate(mem, metadata.size * n, metadata.alignment); }
+
 private:
     void* data = nullptr;
     std::size_t reserved = 0;
     std::size_t dataUsed = 0;
     CMetadata const metadata;
+    std::pmr::memory_resource* resource;
+    std::shared_ptr<void> externalOwner; // not null when data is owned by someone else
+    VirtualRange vRange;                 // not empty when data is the beginning of the range
+    DirtyBlocks changes;
+    BlockHashes hashes;
 };
 
 
-inline CPool::CPool(ComponentId cid) : metadata(CMetadata::GetData(cid)) {}
+inline CPool::CPool(ComponentId cid, std::pmr::memory_resource* resource)
+    : metadata(CMetadata::GetData(cid)), resource(resource), changes(resource), hashes(resource) {}
 
 inline CPool::CPool(CPool&& rval)
     : data(rval.data),
       reserved(rval.reserved),
       dataUsed(rval.dataUsed),
-      metadata(rval.metadata)
+      metadata(rval.metadata),
+      resource(rval.resource),
+      externalOwner(std::move(rval.externalOwner)),
+      vRange(std::move(rval.vRange)),
+      changes(std::move(rval.changes)),
+      hashes(std::move(rval.hashes))
 {
     rval.data = nullptr;
     rval.reserved = 0;
@@ -195,7 +413,8 @@ inline void* CPool::alloc()
 {
     if (dataUsed >= reserved)
         fitNextN(reserved ? reserved : 4); // 4 as first size
-    return addressAtIdx(dataUsed++);       // post-inc here
+    changes.mark(dataUsed);
+    return addressAtIdx(dataUsed++); // post-inc here
 }
 
 inline void* CPool::alloc(Idx_t n)
@@ -204,6 +423,7 @@ inline void* CPool::alloc(Idx_t n)
         return nullptr;
     fitNextN(n);
     void* ptr = addressAtIdx(dataUsed);
+    changes.mark(dataUsed, dataUsed + n);
     dataUsed += n;
     return ptr;
 }
@@ -211,15 +431,45 @@ inline void* CPool::alloc(Idx_t n)
 inline void CPool::construct(Idx_t idx)
 {
     EPP_ASSERT(idx < dataUsed);
+    changes.mark(idx);
     metadata.defaultConstructor(addressAtIdx(idx));
 }
 
 inline void CPool::construct(Idx_t idx, void* rValComp)
 {
     EPP_ASSERT(idx < dataUsed);
+    changes.mark(idx);
     metadata.moveConstructor(addressAtIdx(idx), rValComp);
 }
 
+inline void CPool::replicate(Idx_t idx, std::size_t n)
+{
+    EPP_ASSERT(idx < dataUsed);
+    EPP_ASSERTA_M(metadata.copyConstructor, "The component is not copyable");
+    if (n == 0)
+        return;
+    fitNextN(n); // may relocate the copied component, use the indices from now on
+    auto first = dataUsed;
+    auto last = first + n;
+    if (metadata.triviallyCopyable) {
+        for (Idx_t i = first; i < last; ++i)
+            std::memcpy(addressAtIdx(i), addressAtIdx(idx), metadata.size);
+    }
+    else {
+        Idx_t i = first;
+        try {
+            for (; i < last; ++i)
+                metadata.copyConstructor(addressAtIdx(i), addressAtIdx(idx));
+        } catch (...) { // dataUsed covers only the constructed components
+            while (i-- > first)
+                metadata.destructor(addressAtIdx(i));
+            throw;
+        }
+    }
+    changes.mark(first, last);
+    dataUsed = last;
+}
+
 inline bool CPool::destroy(Idx_t idx)
 {
     EPP_ASSERT(idx < dataUsed);
@@ -233,17 +483,40 @@ inline bool CPool::destroy(Idx_t idx)
     return notLast;
 }
 
+inline void CPool::destroy(std::vector<std::size_t> const& sortedIdxs)
+{
+    EPP_ASSERT(sortedIdxs.size() <= dataUsed && (sortedIdxs.empty() || sortedIdxs.back() < dataUsed));
+    FillHolesFromTail(sortedIdxs, dataUsed, [this](std::size_t hole, std::size_t src) {
+        metadata.destructor(addressAtIdx(hole));
+        construct(hole, addressAtIdx(src));
+    });
+    std::size_t newUsed = dataUsed - sortedIdxs.size();
+    for (Idx_t i = newUsed; i < dataUsed; ++i) // the removed ones and the moved-from ones
+        metadata.destructor(addressAtIdx(i));
+    dataUsed = newUsed;
+}
+
 inline void CPool::fitNextN(std::size_t n)
 {
-    reserve(SizeToFitNextN(n, reserved, reserved - dataUsed));
+    auto newReserved = SizeToFitNextN(n, reserved, reserved - dataUsed);
+    if (isVirtual()) // doubling is not needed, but commits fewer times
+        newReserved = std::max(std::min(newReserved, vRange.size() / metadata.size), dataUsed + n);
+    reserve(newReserved);
 }
 
 inline void CPool::reserve(std::size_t newReserved)
 {
     if (newReserved == reserved)
         return;
-    void* newData = newReserved ? operator new[](metadata.size* newReserved, std::align_val_t(metadata.alignment))
-                                : nullptr;
+    if (isVirtual()) {
+        vRange.commit(metadata.size * newReserved);
+        for (Idx_t i = newReserved; i < dataUsed; ++i)
+            metadata.destructor(addressAtIdx(i));
+        dataUsed = std::min(dataUsed, newReserved);
+        reserved = newReserved; // committed pages are kept
+        return;
+    }
+    void* newData = newReserved ? allocate(newReserved) : nullptr;
     if (data) {
         auto toMove = std::min(newReserved, dataUsed);
         for (Idx_t i = 0; i < toMove; ++i)
@@ -251,12 +524,64 @@ inline void CPool::reserve(std::size_t newReserved)
         for (Idx_t i = 0; i < dataUsed; ++i)
             metadata.destructor(addressAtIdx(i));
         dataUsed = toMove;
-        operator delete[](data, std::align_val_t(metadata.alignment));
+        if (externalOwner)
+            externalOwner = nullptr;
+        else
+            deallocate(data, reserved);
     }
     data = newData;
     reserved = newReserved;
 }
 
+inline void CPool::reserveVirtual(std::size_t maxN)
+{
+    EPP_ASSERT(maxN > 0 && maxN >= dataUsed && metadata.alignment <= VirtualRange::PageSize());
+    VirtualRange newRange(metadata.size * maxN);
+    newRange.commit(metadata.size * dataUsed);
+    void* newData = newRange.data();
+    for (Idx_t i = 0; i < dataUsed; ++i) {
+        metadata.moveConstructor(addressAtIdx(newData, i), addressAtIdx(i));
+        metadata.destructor(addressAtIdx(i));
+    }
+    if (data && !isVirtual()) {
+        if (externalOwner)
+            externalOwner = nullptr;
+        else
+            deallocate(data, reserved);
+    }
+    vRange = std::move(newRange);
+    data = newData;
+    reserved = dataUsed;
+}
+
+inline void CPool::permute(std::vector<std::size_t> const& order)
+{
+    EPP_ASSERT(order.size() == dataUsed);
+    if (dataUsed == 0)
+        return;
+    void* newData = allocate(reserved);
+    for (Idx_t i = 0; i < dataUsed; ++i) {
+        metadata.moveConstructor(addressAtIdx(newData, i), addressAtIdx(order[i]));
+        if (order[i] != i)
+            changes.mark(i);
+    }
+    for (Idx_t i = 0; i < dataUsed; ++i)
+        metadata.destructor(addressAtIdx(i));
+    if (isVirtual()) { // the range stays in place - move the components back
+        for (Idx_t i = 0; i < dataUsed; ++i) {
+            metadata.moveConstructor(addressAtIdx(i), addressAtIdx(newData, i));
+            metadata.destructor(addressAtIdx(newData, i));
+        }
+        deallocate(newData, reserved);
+        return;
+    }
+    if (externalOwner)
+        externalOwner = nullptr;
+    else
+        deallocate(data, reserved);
+    data = newData;
+}
+
 inline void CPool::clear()
 {
     for (Idx_t i = 0; i < dataUsed; ++i)
@@ -264,9 +589,24 @@ inline void CPool::clear()
     dataUsed = 0;
 }
 
+inline void CPool::resize(std::size_t n)
+{
+    for (Idx_t i = n; i < dataUsed; ++i)
+        metadata.destructor(addressAtIdx(i));
+    if (n < dataUsed)
+        dataUsed = n;
+    else if (n > dataUsed) {
+        auto first = dataUsed;
+        alloc(n - first);
+        for (Idx_t i = first; i < n; ++i)
+            metadata.defaultConstructor(addressAtIdx(i));
+    }
+}
+
 inline void* CPool::operator[](Idx_t idx)
 {
     EPP_ASSERT(idx < dataUsed)
+    changes.mark(idx);
     return addressAtIdx(idx);
 }
 
@@ -276,6 +616,97 @@ inline void const* CPool::operator[](Idx_t idx) const
     return addressAtIdx(idx);
 }
 
+inline void CPool::save(std::ostream& os) const
+{
+    EPP_ASSERTA_M(metadata.triviallyCopyable, "Only trivially copyable components can be saved");
+    WriteValue(os, metadata.nameHash);
+    WriteValue(os, metadata.size);
+    WriteValue(os, metadata.alignment);
+    WriteValue(os, std::uint64_t(dataUsed));
+    WritePadding(os, metadata.alignment); // for the components to be aligned in mapped files
+    WriteBytes(os, data, metadata.size * dataUsed);
+}
+
+inline void CPool::load(std::istream& is, std::shared_ptr<void> const& memoryOwner)
+{
+    EPP_ASSERTA_M(metadata.triviallyCopyable, "Only trivially copyable components can be loaded");
+    EPP_ASSERTA_M(ReadValue<std::uint64_t>(is) == metadata.nameHash &&
+                      ReadValue<std::uint32_t>(is) == metadata.size &&
+                      ReadValue<std::uint32_t>(is) == metadata.alignment,
+                  "Saved component does not match the registered one");
+    auto n = Idx_t(ReadValue<std::uint64_t>(is));
+    SkipPadding(is);
+    if (auto memBuf = dynamic_cast<MemoryBuf*>(is.rdbuf()); memoryOwner && memBuf && dataUsed == 0 && n > 0) {
+        auto mem = memBuf->begin() + std::streamoff(is.tellg());
+        if ((std::uintptr_t(mem) & (metadata.alignment - 1)) == 0) { // not aligned when written to a non-seekable stream
+            EPP_ASSERTA_M(is.seekg(std::streamoff(metadata.size * n), std::ios_base::cur), "Unexpected end of the stream");
+            adopt(mem, n, memoryOwner);
+            changes.mark(0, n);
+            return;
+        }
+    }
+    void* dest = alloc(n); // trivially copyable, so reading the bytes constructs the components
+    ReadBytes(is, dest, metadata.size * n);
+}
+
+inline void CPool::saveChanges(std::ostream& os) const
+{
+    EPP_ASSERTA_M(metadata.triviallyCopyable, "Only trivially copyable components can be saved");
+    WriteValue(os, metadata.nameHash);
+    WriteValue(os, std::uint64_t(dataUsed));
+    changes.save(os, data, metadata.size, dataUsed);
+}
+
+inline void CPool::loadChanges(std::istream& is)
+{
+    EPP_ASSERTA_M(metadata.triviallyCopyable, "Only trivially copyable components can be loaded");
+    EPP_ASSERTA_M(ReadValue<std::uint64_t>(is) == metadata.nameHash, "Saved component does not match the registered one");
+    resize(Idx_t(ReadValue<std::uint64_t>(is)));
+    changes.load(is, data, metadata.size, dataUsed);
+}
+
+inline void CPool::copyFrom(CPool const& src)
+{
+    EPP_ASSERTA_M(metadata.triviallyCopyable, "Only trivially copyable components can be copied");
+    EPP_ASSERT(src.getCId() == getCId());
+    dataUsed = 0; // trivially copyable - no need to destroy
+    if (reserved < src.dataUsed)
+        reserve(src.dataUsed);
+    if (src.dataUsed > 0) // data of empty pools can be null
+        std::memcpy(data, src.data, metadata.size * src.dataUsed);
+    dataUsed = src.dataUsed;
+    changes.mark(0, dataUsed);
+}
+
+inline void CPool::copyChangedFrom(CPool const& src)
+{
+    EPP_ASSERTA_M(metadata.triviallyCopyable, "Only trivially copyable components can be copied");
+    EPP_ASSERT(src.getCId() == getCId());
+    auto common = std::min(dataUsed, src.dataUsed);
+    if (src.dataUsed > dataUsed) // components past the current size were removed since the baseline
+        std::memcpy(alloc(src.dataUsed - dataUsed), src.addressAtIdx(common), metadata.size * (src.dataUsed - common));
+    dataUsed = src.dataUsed;
+    changes.copyMarked(data, src.data, metadata.size, common);
+}
+
+inline std::uint64_t CPool::checksum()
+{
+    EPP_ASSERTA_M(metadata.triviallyCopyable, "Only trivially copyable components can be hashed");
+    return hashes.update(data, metadata.size, dataUsed, changes);
+}
+
+inline void CPool::adopt(void* mem, std::size_t n, std::shared_ptr<void> memoryOwner)
+{
+    EPP_ASSERT(dataUsed == 0 && metadata.triviallyCopyable && memoryOwner);
+    EPP_ASSERT((std::uintptr_t(mem) & (metadata.alignment - 1)) == 0);
+    reserve(0);
+    vRange = VirtualRange();
+    data = mem;
+    reserved = n;
+    dataUsed = n;
+    externalOwner = std::move(memoryOwner);
+}
+
 } // namespace epp
 
 #endif // CPool_H
\ No newline at end of file
@@ -0,0 +1,217 @@
+#ifndef EPP_COLDSTORAGE_H
+#define EPP_COLDSTORAGE_H
+
+#include <ECSpp/internal/utility/Assert.h>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace epp {
+
+/// A lazily grown region of memory for the values of type T referred to by Cold<T> components
+/**
+ * Values are allocated in pages of PageSize slots, pages are never moved nor freed (freed slots are reused),
+ * so growing the region does not touch the values that already exist. The region is shared by every EntityManager
+ * and guarded by a mutex, as it is used only when a value is created or destroyed
+ * @tparam T Type of the values
+ */
+template <typename T>
+class ColdRegion {
+public:
+    constexpr static std::size_t const PageSize = 64;
+
+public:
+    /** @returns The region of values of type T */
+    static ColdRegion& Get()
+    {
+        static ColdRegion* region = new ColdRegion(); // never destroyed - values may outlive static objects
+        return *region;
+    }
+
+
+    /// Constructs a new value in a free slot
+    /**
+     * @tparam Args Types of arguments that will be forwarded to the constructor
+     * @param args Arguments forwarded to the constructor of T
+     * @returns The address of the new value
+     */
+    template <typename... Args>
+    T* make(Args&&... args);
+
+
+    /// Destroys a value and frees its slot
+    /**
+     * @param value An address returned from the make function
+     */
+    void destroy(T* value);
+
+
+    /** @returns The number of slots in the allocated pages */
+    std::size_t capacity() const { return pages.size() * PageSize; }
+
+private:
+    union Slot {
+        Slot* nextFree;
+        std::aligned_storage_t<sizeof(T), alignof(T)> storage;
+    };
+
+private:
+    std::mutex mutex;
+
+    std::vector<std::unique_ptr<Slot[]>> pages;
+
+    Slot* freeSlots = nullptr; // linked list of the free slots
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+/// A component that keeps a rarely accessed (cold) value of type T outside of the CPools
+/**
+ * CPools store only the pointer, so destroying, moving between spawners and growing the pools of the entities
+ * moves 8 bytes instead of the whole value. The value is allocated in a ColdRegion on the first non-const access
+ * (a never modified value costs no memory in the region). Selections that list Cold<T> pass T& to forEach, the ones that list
+ * Cold<T> const pass T const* (nullptr if the value was not allocated).
+ * Cold<T> has to be registered like any other component. It is not trivially copyable, so it cannot be saved nor copied into frames
+ * @tparam T Type of the cold value
+ */
+template <typename T>
+class Cold {
+public:
+    using Value_t = T;
+
+public:
+    /// Constructs a default value (lazily, on the first non-const access)
+    Cold() = default;
+
+
+    /// Constructs a copy of a given value
+    /**
+     * @param val Any value
+     */
+    explicit Cold(T val) : value(ColdRegion<T>::Get().make(std::move(val))) {}
+
+
+    /// Move constructor - takes over the value of rval, does not move the value itself
+    Cold(Cold&& rval) noexcept : value(std::exchange(rval.value, nullptr)) {}
+
+
+    /// Copy constructor - copies the value
+    Cold(Cold const& other) : value(other.value ? ColdRegion<T>::Get().make(*other.value) : nullptr) {}
+
+
+    /// Move assignment - takes over the value of rval, does not move the value itself
+    Cold& operator=(Cold&& rval) noexcept
+    {
+        std::swap(value, rval.value);
+        return *this;
+    }
+
+
+    /// Copy assignment - copies the value
+    Cold& operator=(Cold const& other) { return *this = Cold(other); }
+
+
+    /// Destroys the value
+    ~Cold()
+    {
+        if (value)
+            ColdRegion<T>::Get().destroy(value);
+    }
+
+
+    /** @returns The value, allocated if it was not yet */
+    T& operator*()
+    {
+        if (!value)
+            value = ColdRegion<T>::Get().make();
+        return *value;
+    }
+
+
+    /// Returns the allocated value
+    /**
+     * @returns The value
+     * @throws (Debug only) Throws the AssertionFailed exception if the value was not allocated (see get)
+     */
+    T const& operator*() const
+    {
+        EPP_ASSERT_M(value, "The cold value was not allocated");
+        return *value;
+    }
+
+
+    /** @copydoc Cold::operator*() */
+    T* operator->() { return &**this; }
+
+
+    /** @copydoc Cold::operator*() const */
+    T const* operator->() const { return &**this; }
+
+
+    /** @returns The value, or nullptr if it was not allocated */
+    T const* get() const { return value; }
+
+
+    /** @returns True if the value was allocated */
+    bool isAllocated() const { return value != nullptr; }
+
+private:
+    T* value = nullptr;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+template <typename T>
+struct IsCold : std::false_type {
+};
+
+template <typename T>
+struct IsCold<Cold<T>> : std::true_type {
+};
+
+template <typename T>
+inline constexpr bool IsCold_v = IsCold<std::remove_const_t<T>>::value;
+
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+template <typename T>
+template <typename... Args>
+inline T* ColdRegion<T>::make(Args&&... args)
+{
+    Slot* slot;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!freeSlots) {
+            auto& page = pages.emplace_back(new Slot[PageSize]);
+            for (std::size_t i = PageSize; i-- > 0;)
+                page[i].nextFree = std::exchange(freeSlots, &page[i]);
+        }
+        slot = std::exchange(freeSlots, freeSlots->nextFree);
+    }
+    try {
+        return new (&slot->storage) T(std::forward<Args>(args)...);
+    } catch (...) {
+        std::lock_guard<std::mutex> lock(mutex);
+        slot->nextFree = std::exchange(freeSlots, slot);
+        throw;
+    }
+}
+
+template <typename T>
+inline void ColdRegion<T>::destroy(T* value)
+{
+    value->~T();
+    auto slot = reinterpret_cast<Slot*>(value);
+    std::lock_guard<std::mutex> lock(mutex);
+    slot->nextFree = std::exchange(freeSlots, slot);
+}
+
+} // namespace epp
+
+#endif // EPP_COLDSTORAGE_H
\ No newline at end of file
@@ -0,0 +1,165 @@
+#ifndef EPP_COMPONENTINDEX_H
+#define EPP_COMPONENTINDEX_H
+
+#include <ECSpp/Component.h>
+#include <ECSpp/internal/EntityList.h>
+#include <memory_resource>
+#include <optional>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+namespace epp {
+
+/// A type-erased interface of ComponentIndex used by EntityManager to keep the indices up to date
+class ComponentIndexBase {
+public:
+    /// Constructs an index of the components with a given ComponentId
+    /**
+     * @param id ComponentId of the indexed components
+     */
+    explicit ComponentIndexBase(ComponentId id) : cId(id) {}
+
+
+    /// Virtual destructor
+    virtual ~ComponentIndexBase() = default;
+
+
+    /// Indexes an entity under the key of its component (replaces the previous key of the entity)
+    /**
+     * @param ent A valid entity
+     * @param component Address of the ent's component
+     */
+    virtual void insert(Entity ent, void const* component) = 0;
+
+
+    /// Removes an entity from the index (no-op if the entity is not indexed)
+    /**
+     * The key stored by insert is used, so the component does not have to exist anymore
+     * @param ent Any entity
+     */
+    virtual void erase(Entity ent) = 0;
+
+
+    /// Removes every entity from the index
+    virtual void clear() = 0;
+
+
+    /** @returns ComponentId of the indexed components */
+    ComponentId getCId() const { return cId; }
+
+private:
+    ComponentId const cId;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+/// A hash index of the entities by a key computed from one of their components (e.g. a network id)
+/**
+ * Stores Entities, so the index does not have to be updated when the components are relocated in CPools.
+ * Keys are computed when an entity is indexed (see EntityManager::addIndex) - if a key is modified afterwards,
+ * EntityManager::reindex has to be called
+ * @tparam CType Type of the indexed component
+ * @tparam KeyFn A callable type that accepts (CType const&) and returns a hashable key
+ */
+template <typename CType, typename KeyFn>
+class ComponentIndex final : public ComponentIndexBase {
+public:
+    using Key_t = std::decay_t<std::invoke_result_t<KeyFn, CType const&>>;
+
+public:
+    /// Constructs an empty index
+    /**
+     * @param fn A callable object that accepts (CType const&) and returns a hashable key
+     * @param resource The resource used to allocate the buckets and the keys
+     */
+    explicit ComponentIndex(KeyFn fn, std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : ComponentIndexBase(IdOf<CType>()), keyFn(std::move(fn)), entities(resource), keys(resource) {}
+
+
+    /// Returns an entity indexed under a given key
+    /**
+     * @param key Any key
+     * @returns An entity with a given key or Entity() if there is none. If there are several, returns any of them
+     */
+    Entity find(Key_t const& key) const;
+
+
+    /// Returns the number of entities indexed under a given key
+    /**
+     * @param key Any key
+     * @returns The number of entities with a given key
+     */
+    std::size_t count(Key_t const& key) const { return entities.count(key); }
+
+
+    /** @returns The number of indexed entities */
+    std::size_t size() const { return entities.size(); }
+
+
+    /** @copydoc ComponentIndexBase::insert */
+    void insert(Entity ent, void const* component) override;
+
+
+    /** @copydoc ComponentIndexBase::erase */
+    void erase(Entity ent) override;
+
+
+    /** @copydoc ComponentIndexBase::clear */
+    void clear() override;
+
+private:
+    KeyFn keyFn;
+
+    std::pmr::unordered_multimap<Key_t, Entity> entities;
+
+    std::pmr::vector<std::optional<Key_t>> keys; // key of each indexed entity, by ListIdx
+};
+
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+template <typename CType, typename KeyFn>
+inline Entity ComponentIndex<CType, KeyFn>::find(Key_t const& key) const
+{
+    auto found = entities.find(key);
+    return found != entities.end() ? found->second : Entity();
+}
+
+template <typename CType, typename KeyFn>
+inline void ComponentIndex<CType, KeyFn>::insert(Entity ent, void const* component)
+{
+    erase(ent);
+    if (keys.size() <= ent.listIdx.value)
+        keys.resize(std::size_t(ent.listIdx.value) + 1);
+    Key_t key = keyFn(*static_cast<CType const*>(component));
+    entities.emplace(key, ent);
+    keys[ent.listIdx.value] = std::move(key);
+}
+
+template <typename CType, typename KeyFn>
+inline void ComponentIndex<CType, KeyFn>::erase(Entity ent)
+{
+    if (ent.listIdx.value >= keys.size() || !keys[ent.listIdx.value])
+        return;
+    auto [begin, end] = entities.equal_range(*keys[ent.listIdx.value]);
+    for (auto it = begin; it != end; ++it)
+        if (it->second.listIdx == ent.listIdx) { // versions may differ - only one entity with this ListIdx is indexed
+            entities.erase(it);
+            break;
+        }
+    keys[ent.listIdx.value].reset();
+}
+
+template <typename CType, typename KeyFn>
+inline void ComponentIndex<CType, KeyFn>::clear()
+{
+    entities.clear();
+    keys.clear();
+}
+
+} // namespace epp
+
+#endif // EPP_COMPONENTINDEX_H
\ No newline at end of file
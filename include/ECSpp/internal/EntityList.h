@@ -2,9 +2,15 @@
 #define EPP_ENTITYLIST_H
 
 #include <ECSpp/internal/utility/Assert.h>
+#include <ECSpp/internal/utility/BinaryIO.h>
+#include <ECSpp/internal/utility/DirtyBlocks.h>
 #include <ECSpp/internal/utility/IndexType.h>
 #include <ECSpp/internal/utility/Pool.h>
+#include <ECSpp/internal/utility/Prefetch.h>
+#include <algorithm>
 #include <cstring>
+#include <memory_resource>
+#include <utility>
 
 
 namespace epp {
@@ -138,10 +144,42 @@ public:
     /** By default EntityList reserves memory for 32 elements */
     EntityList() { reserve(32); }; // init size
 
-    EntityList(EntityList&& rhs) = delete;
-    EntityList& operator=(EntityList&& rhs) = delete;
-    EntityList(const EntityList&) = delete;
-    EntityList& operator=(const EntityList&) = delete;
+
+    /// Constructs a list that allocates its cells from a given resource
+    /**
+     * @param memoryResource The resource used to allocate the cells and the tracked changes
+     */
+    explicit EntityList(std::pmr::memory_resource* memoryResource) : changes(memoryResource), resource(memoryResource) { reserve(32); }
+
+
+    /// Copy constructor
+    /**
+     * Copies every cell (both free and occupied ones), the change tracking is not copied
+     * @param rhs Any EntityList
+     */
+    EntityList(EntityList const& rhs) { copyFrom(rhs); }
+
+
+    /// Copy assignment
+    /**
+     * @copydetails EntityList::EntityList(EntityList const&)
+     */
+    EntityList& operator=(EntityList const& rhs);
+
+
+    /// Move constructor
+    /**
+     * Moves the ownership of rhs' cells, rhs becomes an empty list
+     * @param rhs Any EntityList
+     */
+    EntityList(EntityList&& rhs) : EntityList() { swap(rhs); }
+
+
+    /// Move assignment
+    /**
+     * @copydetails EntityList::EntityList(EntityList&&)
+     */
+    EntityList& operator=(EntityList&& rhs);
 
 
     /// Destructor
@@ -201,6 +239,38 @@ public:
     bool isValid(Entity ent) const { return ent.listIdx.value < reserved && ent.version.value == data[ent.listIdx.value].entVersion().value; }
 
 
+    /// Checks the validity of many entities at once
+    /**
+     * Cells are prefetched a few entities ahead and the bits are computed without branches,
+     * so the cache misses of consecutive entities overlap
+     * @param ents Pointer to the first of the entities
+     * @param n Number of entities
+     * @param validBits Bitset of (n + 63) / 64 words, bit i % 64 of word i / 64 is set if ents[i] is valid, cleared otherwise
+     * @returns The number of valid entities
+     */
+    std::size_t isValid(Entity const* ents, std::size_t n, std::uint64_t* validBits) const;
+
+
+    /// Removes the invalid entities from a range, keeping the order of the valid ones (like std::remove_if)
+    /**
+     * @param first Pointer to the first of the entities
+     * @param last Pointer past the last of the entities
+     * @returns The new end of the range
+     */
+    Entity* removeInvalid(Entity* first, Entity* last) const;
+
+
+    /// Starts loading the cell of a given entity into the cache (see Prefetch), so the next get(ent) does not stall
+    /**
+     * @param ent Any entity
+     */
+    void prefetch(Entity ent) const
+    {
+        if (ent.listIdx.value < reserved)
+            Prefetch(data + ent.listIdx.value);
+    }
+
+
     /// Returns the values that describe the location of a given entity
     /**
      * @param ent A valid entity
@@ -216,15 +286,105 @@ public:
      */
     std::size_t size() const { return reserved - freeLeft; }
 
+
+    /// Writes every cell (both free and occupied ones) as one contiguous block
+    /**
+     * @param os Binary output stream
+     * @throws Throws the AssertionFailed exception (in debug and release) if writing failed
+     */
+    void save(std::ostream& os) const;
+
+
+    /// Replaces every cell with the ones written by the save function
+    /**
+     * Entities that were valid when the list was saved become valid again
+     * @param is Binary input stream
+     * @throws Throws the AssertionFailed exception (in debug and release) if the stream ended unexpectedly
+     */
+    void load(std::istream& is);
+
+
+    /// Enables or disables tracking of the modified blocks of cells, the current state becomes a baseline
+    /**
+     * @param enable True to enable the tracking
+     */
+    void trackChanges(bool enable) { changes.enable(enable); }
+
+
+    /// Makes the current state a new baseline
+    void clearChanges() { changes.clear(); }
+
+
+    /// Writes the blocks of cells modified since the baseline
+    /**
+     * @param os Binary output stream
+     * @throws Throws the AssertionFailed exception (in debug and release) if writing failed
+     */
+    void saveChanges(std::ostream& os) const;
+
+
+    /// Applies the changes written by the saveChanges function to a list in the baseline state
+    /**
+     * @param is Binary input stream
+     * @throws Throws the AssertionFailed exception (in debug and release) if the stream ended unexpectedly or the changes do not fit this list
+     */
+    void loadChanges(std::istream& is);
+
+    /// Returns the blocks of cells modified since the baseline
+    DirtyBlocks const& getChanges() const { return changes; }
+
+
+    /// Marks every block that is marked in other (e.g. changes recorded by another list)
+    /**
+     * @param other Blocks of cells to be marked as modified
+     */
+    void mergeChanges(DirtyBlocks const& other) { changes.merge(other); }
+
+
+    /// Replaces the blocks marked as modified with the ones marked in other
+    /**
+     * @param other Blocks of cells to be marked as modified
+     */
+    void assignChanges(DirtyBlocks const& other) { changes.assign(other); }
+
+
+    /// Replaces every cell with the cells of src, reuses the memory if both lists have the same number of cells
+    /**
+     * Every cell is marked as modified
+     * @param src Any EntityList
+     */
+    void copyFrom(EntityList const& src);
+
+
+    /// Makes this list equal to src, assuming that they differ only in the blocks marked as modified in this list
+    /**
+     * Used to restore a copy of the baseline state - copies only the cells modified since the baseline.
+     * Falls back to copyFrom if the lists have different number of cells
+     * @param src A list in the baseline state
+     */
+    void copyChangedFrom(EntityList const& src);
+
 private:
     void reserve(std::size_t newReserved);
 
+    void swap(EntityList& rhs);
+
+    bool isValidBranchless(Entity ent) const; // assumes that reserved > 0
+
+    Cell* allocate(std::size_t n) { return static_cast<Cell*>(resource->allocate(sizeof(Cell) * n, alignof(Cell))); }
+
+    void deallocate(Cell* mem, std::size_t n) { resource->deallocate(mem, sizeof(Cell) * n, alignof(Cell)); }
+
 private:
     Cell* data = nullptr;
     std::size_t freeLeft = 0;
     std::size_t reserved = 0;
 
     ListIdx freeIndex;
+
+    DirtyBlocks changes;
+
+    std::pmr::memory_resource* resource = std::pmr::get_default_resource(); // copies use the default resource, like pmr containers
 };
 
 
@@ -235,7 +395,30 @@ inline EntityList::~EntityList()
 {
     // no need to destroy
     if (data)
-        operator delete[](data);
+        deallocate(data, reserved);
+}
+
+inline EntityList& EntityList::operator=(EntityList const& rhs)
+{
+    if (this != &rhs)
+        copyFrom(rhs);
+    return *this;
+}
+
+inline EntityList& EntityList::operator=(EntityList&& rhs)
+{
+    swap(rhs);
+    return *this;
+}
+
+inline void EntityList::swap(EntityList& rhs)
+{
+    std::swap(data, rhs.data);
+    std::swap(freeLeft, rhs.freeLeft);
+    std::swap(reserved, rhs.reserved);
+    std::swap(freeIndex, rhs.freeIndex);
+    std::swap(changes, rhs.changes);
+    std::swap(resource, rhs.resource);
 }
 
 inline Entity EntityList::allocEntity(PoolIdx poolIdx, SpawnerId spawnerId)
@@ -248,6 +431,7 @@ inline Entity EntityList::allocEntity(PoolIdx poolIdx, SpawnerId spawnerId)
     EntVersion version = data[idx.value].entVersion();
     freeIndex = data[idx.value].nextFreeListIdx();
     data[idx.value] = Cell(Cell::Occupied{ poolIdx, version, spawnerId });
+    changes.mark(idx.value);
     --freeLeft;
 
     return Entity{ idx, version };
@@ -259,6 +443,7 @@ inline void EntityList::changeEntity(Entity ent, PoolIdx poolIdx, SpawnerId spaw
     EPP_ASSERT(isValid(ent));
 
     data[ent.listIdx.value] = Cell(Cell::Occupied{ poolIdx, ent.version, spawnerId });
+    changes.mark(ent.listIdx.value);
 }
 
 inline void EntityList::freeEntity(Entity ent)
@@ -266,6 +451,7 @@ inline void EntityList::freeEntity(Entity ent)
     EPP_ASSERT(isValid(ent));
     // increment version now, so old references wont be valid for freed cells
     data[ent.listIdx.value] = Cell(Cell::Free{ freeIndex, ent.version.nextVersion() });
+    changes.mark(ent.listIdx.value);
     freeIndex = ent.listIdx;
     ++freeLeft;
 }
@@ -279,6 +465,7 @@ inline void EntityList::freeAll()
     for (auto i = freeIndex; i.value < reserved - 1; ++i.value)
         data[i.value] = Cell(Cell::Free{ ListIdx(i.value + 1), data[i.value].entVersion().nextVersion() });
     data[reserved - 1] = Cell(Cell::Free{ ListIdx(ListIdx::BadValue), data[reserved - 1].entVersion().nextVersion() });
+    changes.mark(0, reserved);
 }
 
 inline void EntityList::fitNextN(std::size_t n)
@@ -291,10 +478,10 @@ inline void EntityList::fitNextN(std::size_t n)
 inline void EntityList::reserve(std::size_t newReserved)
 {
     EPP_ASSERT(newReserved > reserved);
-    Cell* newMemory = reinterpret_cast<Cell*>(operator new[](sizeof(Cell) * std::uintptr_t(newReserved)));
+    Cell* newMemory = allocate(newReserved);
     if (data) {
         std::memcpy(newMemory, data, reserved * sizeof(Cell));
-        operator delete[](data);
+        deallocate(data, reserved);
     }
     freeLeft += newReserved - reserved;
     data = newMemory;
@@ -304,10 +491,128 @@ inline void EntityList::reserve(std::size_t newReserved)
         new (data + i.value) Cell(Cell::Free{ ListIdx(i.value + 1), EntVersion(0) });
     new (data + (newReserved - 1)) Cell(Cell::Free{ ListIdx(freeIndex), EntVersion(0) });
 
+    changes.mark(reserved, newReserved);
     freeIndex = ListIdx(reserved);
     reserved = newReserved;
 }
 
+inline void EntityList::save(std::ostream& os) const
+{
+    WriteValue(os, std::uint64_t(reserved));
+    WriteValue(os, std::uint64_t(freeLeft));
+    WriteValue(os, freeIndex);
+    WriteBytes(os, data, reserved * sizeof(Cell));
+}
+
+inline void EntityList::load(std::istream& is)
+{
+    auto newReserved = std::size_t(ReadValue<std::uint64_t>(is));
+    auto newFreeLeft = std::size_t(ReadValue<std::uint64_t>(is));
+    auto newFreeIndex = ReadValue<ListIdx>(is);
+    EPP_ASSERTA_M(newReserved > 0 && newFreeLeft <= newReserved, "Corrupted list of entities");
+    Cell* newMemory = allocate(newReserved);
+    try {
+        ReadBytes(is, newMemory, newReserved * sizeof(Cell));
+    } catch (...) { // keep the current state on failure
+        deallocate(newMemory, newReserved);
+        throw;
+    }
+    if (data)
+        deallocate(data, reserved);
+    data = newMemory;
+    reserved = newReserved;
+    freeLeft = newFreeLeft;
+    freeIndex = newFreeIndex;
+    changes.mark(0, reserved);
+}
+
+inline void EntityList::saveChanges(std::ostream& os) const
+{
+    WriteValue(os, std::uint64_t(reserved));
+    WriteValue(os, std::uint64_t(freeLeft));
+    WriteValue(os, freeIndex);
+    changes.save(os, data, sizeof(Cell), reserved);
+}
+
+inline void EntityList::loadChanges(std::istream& is)
+{
+    auto newReserved = std::size_t(ReadValue<std::uint64_t>(is));
+    auto newFreeLeft = std::size_t(ReadValue<std::uint64_t>(is));
+    auto newFreeIndex = ReadValue<ListIdx>(is);
+    EPP_ASSERTA_M(newReserved >= reserved && newFreeLeft <= newReserved, "Delta does not match the list of entities");
+    if (newReserved > reserved)
+        reserve(newReserved); // new cells are overwritten by the loaded blocks
+    changes.load(is, data, sizeof(Cell), reserved);
+    freeLeft = newFreeLeft;
+    freeIndex = newFreeIndex;
+}
+
+inline void EntityList::copyFrom(EntityList const& src)
+{
+    if (reserved != src.reserved) {
+        if (data)
+            deallocate(data, reserved);
+        data = allocate(src.reserved);
+        reserved = src.reserved;
+    }
+    std::memcpy(data, src.data, reserved * sizeof(Cell));
+    freeLeft = src.freeLeft;
+    freeIndex = src.freeIndex;
+    changes.mark(0, reserved);
+}
+
+inline void EntityList::copyChangedFrom(EntityList const& src)
+{
+    if (reserved != src.reserved)
+        return copyFrom(src);
+    changes.copyMarked(data, src.data, sizeof(Cell), reserved);
+    freeLeft = src.freeLeft;
+    freeIndex = src.freeIndex;
+}
+
+inline std::size_t EntityList::isValid(Entity const* ents, std::size_t n, std::uint64_t* validBits) const
+{
+    constexpr std::size_t Distance = 16; // the cell of ents[i + Distance] is prefetched in the i-th iteration
+    std::fill_n(validBits, (n + 63) / 64, 0);
+    if (reserved == 0)
+        return 0;
+    for (std::size_t i = 0; i < std::min(n, Distance); ++i)
+        prefetch(ents[i]);
+    std::size_t valid = 0;
+    for (std::size_t i = 0; i < n; ++i) {
+        if (i + Distance < n)
+            prefetch(ents[i + Distance]);
+        std::uint64_t bit = isValidBranchless(ents[i]);
+        validBits[i / 64] |= bit << (i % 64);
+        valid += bit;
+    }
+    return valid;
+}
+
+inline Entity* EntityList::removeInvalid(Entity* first, Entity* last) const
+{
+    constexpr std::ptrdiff_t Distance = 16;
+    if (reserved == 0)
+        return first;
+    for (Entity* ent = first; ent != last && ent - first < Distance; ++ent)
+        prefetch(*ent);
+    Entity* out = first;
+    for (Entity* ent = first; ent != last; ++ent) {
+        if (last - ent > Distance)
+            prefetch(ent[Distance]);
+        *out = *ent; // always written, kept only if valid
+        out += isValidBranchless(*ent);
+    }
+    return out;
+}
+
+inline bool EntityList::isValidBranchless(Entity ent) const
+{
+    bool inRange = ent.listIdx.value < reserved;
+    auto idx = inRange ? ent.listIdx.value : 0; // conditional move, not a branch
+    return inRange & (ent.version.value == data[idx].entVersion().value);
+}
+
 inline EntityList::Cell::Occupied EntityList::get(Entity ent) const
 {
     EPP_ASSERT(isValid(ent));
@@ -4,6 +4,7 @@
 #include <ECSpp/internal/Archetype.h>
 #include <ECSpp/internal/CPool.h>
 #include <ECSpp/internal/EntityList.h>
+#include <ECSpp/internal/Observer.h>
 
 namespace epp {
 
@@ -67,13 +68,26 @@ public:
 private:
     using CPools_t = std::vector<CPool>;
 
+public:
+    /// A copy of the entities and components of a spawner (a part of WorldFrame)
+    /**
+     * Besides the copies, it stores the blocks that were modified between the previous copy and this one 
+     * (the changes tracked by the spawner when the copy was made)
+     */
+    struct Frame {
+        std::vector<Entity> entities;
+        DirtyBlocks entityChanges;
+        CPools_t cPools;
+    };
+
 public:
     /// Constructs the spawner to spawn entities of a given archetype
     /** 
      * @param id A unique id to identify this spawner
      * @param arch Archetype of entities that will be spawned in this spawner
+     * @param resource The resource used to allocate the components and the tracked changes (the entities use the default allocator)
     */
-    EntitySpawner(SpawnerId id, Archetype const& arch);
+    EntitySpawner(SpawnerId id, Archetype const& arch, std::pmr::memory_resource* resource = std::pmr::get_default_resource());
 
     EntitySpawner(EntitySpawner&&) = delete;
     EntitySpawner& operator=(EntitySpawner&&) = delete;
@@ -92,6 +106,19 @@ public:
     Entity spawn(EntityList& entList, FnType fn);
 
 
+    /// Spawns n copies of an entity owned by this spawner
+    /**
+     * Memory is reserved once and each pool copies the component of the prototype n times (see CPool::replicate)
+     * @param prototype PoolIdx of the entity to copy
+     * @param n Number of copies
+     * @param entList List of entities to get unique Entity instances from
+     * @throws (Debug only) Throws the AssertionFailed exception if prototype is greater or equal to the number of entities
+     * @throws Throws the AssertionFailed exception if any of the components is not copyable (see CopyableComponent).
+     * Nothing is spawned in that case nor when a copy constructor throws
+     */
+    void instantiate(PoolIdx prototype, std::size_t n, EntityList& entList);
+
+
     /// Destroys a valid entity and makes it invalid
     /**
      * @param ent A valid entity
@@ -101,6 +128,15 @@ public:
     void destroy(Entity ent, EntityList& entList);
 
 
+    /// Destroys many entities in one pass over each pool and makes them invalid
+    /**
+     * @param sortedIdxs Sorted unique PoolIdxs of the entities to destroy
+     * @param entList List of entities to free the entities for future use
+     * @throws (Debug only) Throws the AssertionFailed exception if any of the indices is greater or equal to the number of entities
+     */
+    void destroy(std::vector<std::size_t> const& sortedIdxs, EntityList& entList);
+
+
     /// Changes the archetype of a given entity
     /**
      * @details Components that are not present in this spawner's archetype are destroyed
@@ -119,6 +155,23 @@ public:
     void moveEntityHere(Entity ent, EntityList& entList, EntitySpawner& originSpawner, FnType fn);
 
 
+    /// Changes the archetype of many entities of originSpawner, moving their components pool by pool
+    /**
+     * Reserves the memory once, then each pool of this spawner takes all of the entities before the next pool is touched,
+     * and each pool of originSpawner is compacted in one pass (see CPool::destroy(sortedIdxs)).
+     * Moved entities are appended in the order of sortedIdxs
+     * @tparam FnType Callable type that takes r-value reference to the EntityCreator
+     * @param sortedIdxs Sorted unique PoolIdxs (in originSpawner) of the entities to move
+     * @param entList List of entities to change the location data of the moved entities
+     * @param originSpawner any OTHER spawner
+     * @param fn A Callable type that can use the Creator instance to construct new components, called for each moved entity
+     * @throws (Debug only) Throws the AssertionFailed exception if &originSpawner == this or if any of the indices is greater
+     *          or equal to the number of entities of originSpawner
+     */
+    template <typename FnType>
+    void moveEntitiesHere(std::vector<std::size_t> const& sortedIdxs, EntityList& entList, EntitySpawner& originSpawner, FnType fn);
+
+
     /// Destroys every entity in this spawner, keeps resereved memory
     /** 
      * Frees each entity individually in entList, to ensure that no entity cell will be lost 
@@ -145,6 +198,108 @@ public:
     void shrinkToFit();
 
 
+    /// Makes every CPool grow in place within a range of addresses that fits maxN entities (see CPool::reserveVirtual)
+    /**
+     * The entities themselves are kept in a std::vector (see getEntities), which still grows by doubling, nothing is reserved for them up front
+     * @param maxN The maximal number of entities, not lower than the current one
+     */
+    void reserveVirtual(std::size_t maxN);
+
+
+    /// Reorders the entities (and their components) so that the entity at index order[i] is moved to index i
+    /**
+     * @param order A permutation of indices [0, number of entities)
+     * @param entList List of entities to change the location data of the moved entities
+     * @throws (Debug only) Throws the AssertionFailed exception if order has a wrong size
+     */
+    void permute(std::vector<std::size_t> const& order, EntityList& entList);
+
+
+    /// Writes the pool of entities and every CPool as contiguous blocks
+    /** 
+     * @param os Binary output stream
+     * @throws Throws the AssertionFailed exception (in debug and release) if any of the components is not trivially copyable or if writing failed
+     */
+    void save(std::ostream& os) const;
+
+
+    /// Reads the entities and components written by the save function
+    /** 
+     * Entities' cells are not changed, so the EntityList must be loaded separately
+     * @param is Binary input stream
+     * @param memoryOwner If not null and is reads from a MemoryBuf, the CPools adopt the memory of the buffer (see CPool::load)
+     * @throws Throws the AssertionFailed exception (in debug and release) if this spawner is not empty, 
+     * if the saved data does not match this spawner's archetype or if the stream ended unexpectedly
+     */
+    void load(std::istream& is, std::shared_ptr<void> const& memoryOwner = nullptr);
+
+
+    /// Enables or disables tracking of the modified blocks of entities and components, the current state becomes a baseline
+    /** 
+     * @param enable True to enable the tracking
+     */
+    void trackChanges(bool enable);
+
+
+    /// Makes the current state a new baseline
+    void clearChanges();
+
+
+    /// Writes the number of entities and the blocks of entities and components modified since the baseline
+    /** 
+     * @param os Binary output stream
+     * @throws Throws the AssertionFailed exception (in debug and release) if any of the components is not trivially copyable or if writing failed
+     */
+    void saveChanges(std::ostream& os) const;
+
+
+    /// Applies the changes written by the saveChanges function to a spawner in the baseline state
+    /** 
+     * Entities' cells are not changed, so the changes of the EntityList must be loaded separately
+     * @param is Binary input stream
+     * @throws Throws the AssertionFailed exception (in debug and release) if the saved data does not match 
+     * this spawner's archetype or if the stream ended unexpectedly
+     */
+    void loadChanges(std::istream& is);
+
+
+    /// Returns the hash of the entities and the components that are not excluded
+    /**
+     * When the change tracking is enabled, only the blocks modified since the last checksum call are rehashed
+     * @param excluded Mask of components that are not hashed
+     * @returns The hash of this spawner's data
+     * @throws Throws the AssertionFailed exception (in debug and release) if any of the hashed components is not trivially copyable
+     */
+    std::uint64_t checksum(CMask const& excluded);
+
+
+    /// Copies the entities and components to a given frame, reuses the memory of the frame
+    /**
+     * The frame also receives the changes tracked since the baseline
+     * @param frame A frame of this spawner (or an empty one)
+     * @throws Throws the AssertionFailed exception (in debug and release) if any of the components is not trivially copyable
+     */
+    void copyInto(Frame& frame) const;
+
+
+    /// Replaces the entities and components with the ones stored in a given frame
+    /**
+     * Does not record any EntityEvents. Entities' cells are not changed, so the EntityList must be restored separately
+     * @param frame A frame made by the copyInto function of a spawner with the same archetype
+     * @param onlyChanged If true, assumes that the spawner differs from the frame only in the blocks modified 
+     * since the baseline (see CPool::copyChangedFrom), otherwise everything is copied
+     * @throws Throws the AssertionFailed exception (in debug and release) if the frame was made by a spawner with a different archetype
+     */
+    void restoreFrom(Frame const& frame, bool onlyChanged);
+
+
+    /// Marks as modified every block that is marked in a given frame
+    /**
+     * @param frame A frame made by the copyInto function of a spawner with the same archetype
+     */
+    void mergeChanges(Frame const& frame);
+
+
     /// Returns CPool of components with cId id
     /** 
      * @param cId ComponentId that is present in the archetype of this spawner
@@ -172,9 +327,48 @@ public:
      */
     Archetype makeArchetype() const;
 
+
+    /// Enables or disables recording of EntityEvents in this spawner
+    /** 
+     * Spawners that are not observed do not record any events
+     * @param isObserved True if at least one observer accepts this spawner
+     */
+    void setObserved(bool isObserved) { observed = isObserved; }
+
+
+    /** @returns True if this spawner records EntityEvents */
+    bool isObserved() const { return observed; }
+
+
+    /// Returns the events recorded since the last clearEvents call
+    /** 
+     * @returns A reference to the queue of events
+     */
+    EntityEvents_t const& getEvents() const { return events; }
+
+
+    /// Clears the queue of events, keeps reserved memory
+    void clearEvents() { events.clear(); }
+
+
+    /// Moves the recorded events to a given vector and clears the queue
+    /** 
+     * The buffers are swapped, so the memory reserved by both of them is reused
+     * @param out A vector that will receive the recorded events (its previous content is discarded)
+     */
+    void takeEvents(EntityEvents_t& out)
+    {
+        out.clear();
+        out.swap(events);
+    }
+
 private:
     void removeFromEntityPool(PoolIdx idx, EntityList& entList);
 
+    void removeFromEntityPool(std::vector<std::size_t> const& sortedIdxs, EntityList& entList);
+
+    void recordEvent(EntityEvent::Type type, Entity ent, SpawnerId otherId = SpawnerId());
+
 public:
     SpawnerId const spawnerId;
     CMask const mask;
@@ -182,7 +376,15 @@ public:
 private:
     EntityPool_t entityPool;
 
+    DirtyBlocks entityChanges;
+
+    BlockHashes entityHashes;
+
     CPools_t cPools;
+
+    EntityEvents_t events;
+
+    bool observed = false;
 };
 
 
@@ -229,12 +431,12 @@ inline EntityCreator::~Creator()
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 
-inline EntitySpawner::EntitySpawner(SpawnerId id, Archetype const& arch)
-    : spawnerId(id), mask(arch.getMask())
+inline EntitySpawner::EntitySpawner(SpawnerId id, Archetype const& arch, std::pmr::memory_resource* resource)
+    : spawnerId(id), mask(arch.getMask()), entityChanges(resource), entityHashes(resource)
 {
     cPools.reserve(arch.getCIds().size());
     for (auto cId : arch.getCIds())
-        cPools.emplace_back(cId);
+        cPools.emplace_back(cId, resource);
     std::sort(cPools.begin(), cPools.end(), [](auto const& lhs, auto const& rhs) { return lhs.getCId() < rhs.getCId(); });
 }
 
@@ -246,19 +448,46 @@ inline Entity EntitySpawner::spawn(EntityList& entList, FnType fn)
     PoolIdx idx(entityPool.data.size());
     Entity ent = entList.allocEntity(idx, spawnerId);
     entityPool.create(ent);
+    entityChanges.mark(idx.value);
     for (auto& pool : cPools)
         pool.alloc(); // only allocates memory (constructor is not called yet)
     fn(Creator(*this, idx));
     // constructors of the components are now already called
-    // notify({ EntityEvent::Type::Creation, ent });
+    recordEvent(EntityEvent::Type::Creation, ent);
     return ent;
 }
 
+inline void EntitySpawner::instantiate(PoolIdx prototype, std::size_t n, EntityList& entList)
+{
+    EPP_ASSERT(prototype.value < entityPool.data.size());
+    for (auto const& pool : cPools) { // validate before changing anything
+        EPP_ASSERTA_M(pool.getMetadata().copyConstructor, "The component is not copyable");
+    }
+    fitNextN(n);
+    std::size_t replicated = 0;
+    try {
+        for (; replicated < cPools.size(); ++replicated)
+            cPools[replicated].replicate(prototype.value, n);
+    } catch (...) { // keep the pools as long as the pool of entities
+        for (std::size_t i = 0; i < replicated; ++i)
+            for (std::size_t j = 0; j < n; ++j)
+                cPools[i].destroy(cPools[i].size() - 1);
+        throw;
+    }
+    for (std::size_t i = 0; i < n; ++i) {
+        PoolIdx idx(entityPool.data.size());
+        Entity ent = entList.allocEntity(idx, spawnerId);
+        entityPool.create(ent);
+        entityChanges.mark(idx.value);
+        recordEvent(EntityEvent::Type::Creation, ent);
+    }
+}
+
 inline void EntitySpawner::destroy(Entity ent, EntityList& entList)
 {
     EPP_ASSERT(entList.isValid(ent));
 
-    // notify({ EntityEvent::Type::Destruction, ent });
+    recordEvent(EntityEvent::Type::Destruction, ent);
 
     PoolIdx entPoolIdx = entList.get(ent).poolIdx;
     for (auto& pool : cPools)
@@ -267,10 +496,42 @@ inline void EntitySpawner::destroy(Entity ent, EntityList& entList)
     entList.freeEntity(ent);
 }
 
+inline void EntitySpawner::destroy(std::vector<std::size_t> const& sortedIdxs, EntityList& entList)
+{
+    auto& ents = entityPool.data;
+    EPP_ASSERT(sortedIdxs.size() <= ents.size() && (sortedIdxs.empty() || sortedIdxs.back() < ents.size()));
+    for (auto idx : sortedIdxs) {
+        recordEvent(EntityEvent::Type::Destruction, ents[idx]);
+        entList.freeEntity(ents[idx]);
+    }
+    for (auto& pool : cPools)
+        pool.destroy(sortedIdxs);
+    removeFromEntityPool(sortedIdxs, entList);
+}
+
 inline void EntitySpawner::removeFromEntityPool(PoolIdx idx, EntityList& entList)
 {
-    if (entityPool.destroy(idx.value)) // if data was relocated in pools, change poolIdx in entList
+    if (entityPool.destroy(idx.value)) { // if data was relocated in pools, change poolIdx in entList
         entList.changeEntity(entityPool.data[idx.value], idx, spawnerId);
+        entityChanges.mark(idx.value);
+    }
+}
+
+inline void EntitySpawner::removeFromEntityPool(std::vector<std::size_t> const& sortedIdxs, EntityList& entList)
+{
+    auto& ents = entityPool.data;
+    FillHolesFromTail(sortedIdxs, ents.size(), [&](std::size_t hole, std::size_t src) {
+        ents[hole] = ents[src];
+        entList.changeEntity(ents[hole], PoolIdx(hole), spawnerId);
+        entityChanges.mark(hole);
+    });
+    ents.resize(ents.size() - sortedIdxs.size());
+}
+
+inline void EntitySpawner::recordEvent(EntityEvent::Type type, Entity ent, SpawnerId otherId)
+{
+    if (observed) // unobserved spawners pay only for this branch
+        events.push_back({ type, ent, otherId });
 }
 
 template <typename FnType>
@@ -297,8 +558,48 @@ inline void EntitySpawner::moveEntityHere(Entity ent, EntityList& entList, Entit
         (oriPoolsPtr++)->destroy(oldIdx.value);
     originSpawner.removeFromEntityPool(oldIdx, entList); // remove entity
     entityPool.create(ent);                              // add entity
+    entityChanges.mark(newIdx.value);
     entList.changeEntity(ent, newIdx, spawnerId);
     fn(Creator(*this, newIdx, originSpawner.mask)); // originSpawner.mask contains all the components that were moved, no need to delete possible excess
+    originSpawner.recordEvent(EntityEvent::Type::Departure, ent, spawnerId);
+    recordEvent(EntityEvent::Type::Arrival, ent, originSpawner.spawnerId);
+}
+
+template <typename FnType>
+inline void EntitySpawner::moveEntitiesHere(std::vector<std::size_t> const& sortedIdxs, EntityList& entList, EntitySpawner& originSpawner, FnType fn)
+{
+    static_assert(std::is_invocable_v<FnType, Creator&&>);
+    auto const& oriEnts = originSpawner.entityPool.data;
+    EPP_ASSERT(&originSpawner != this && sortedIdxs.size() <= oriEnts.size() && (sortedIdxs.empty() || sortedIdxs.back() < oriEnts.size()));
+
+    std::size_t n = sortedIdxs.size();
+    std::size_t first = entityPool.data.size();
+    fitNextN(n);
+    auto oriPoolsPtr = originSpawner.cPools.begin();
+    auto oriPoolsEnd = originSpawner.cPools.end();
+    for (auto& pool : cPools) { // pools are sorted by their cIds, like in moveEntityHere
+        while (oriPoolsPtr != oriPoolsEnd && oriPoolsPtr->getCId() < pool.getCId())
+            ++oriPoolsPtr;
+        pool.alloc(n);                                                            // only allocates memory (constructors are not called yet)
+        if (oriPoolsPtr != oriPoolsEnd && oriPoolsPtr->getCId() == pool.getCId()) // this component is in the original spawner, move it
+            for (std::size_t i = 0; i < n; ++i)
+                pool.construct(first + i, (*oriPoolsPtr)[sortedIdxs[i]]);
+    }
+    for (auto& pool : originSpawner.cPools) // destroys the moved-from components and the ones that are not in this spawner
+        pool.destroy(sortedIdxs);
+    for (std::size_t i = 0; i < n; ++i) {
+        Entity ent = oriEnts[sortedIdxs[i]];
+        entityPool.create(ent);
+        entList.changeEntity(ent, PoolIdx(first + i), spawnerId);
+        entityChanges.mark(first + i);
+    }
+    originSpawner.removeFromEntityPool(sortedIdxs, entList);
+    for (std::size_t i = 0; i < n; ++i) {
+        Entity ent = entityPool.data[first + i];
+        fn(Creator(*this, PoolIdx(first + i), originSpawner.mask));
+        originSpawner.recordEvent(EntityEvent::Type::Departure, ent, spawnerId);
+        recordEvent(EntityEvent::Type::Arrival, ent, originSpawner.spawnerId);
+    }
 }
 
 
@@ -311,6 +612,9 @@ inline void EntitySpawner::clear(EntityList& entList)
 
 inline void EntitySpawner::clear()
 {
+    if (observed)
+        for (auto ent : entityPool.data)
+            recordEvent(EntityEvent::Type::Destruction, ent);
     entityPool.data.clear();
     for (auto& pool : cPools)
         pool.clear();
@@ -330,6 +634,136 @@ inline void EntitySpawner::shrinkToFit()
         pool.shrinkToFit();
 }
 
+inline void EntitySpawner::reserveVirtual(std::size_t maxN)
+{
+    for (auto& pool : cPools)
+        pool.reserveVirtual(maxN);
+}
+
+inline void EntitySpawner::permute(std::vector<std::size_t> const& order, EntityList& entList)
+{
+    EPP_ASSERT(order.size() == entityPool.data.size());
+    for (auto& pool : cPools)
+        pool.permute(order);
+    EntityPool_t::Container_t permuted(order.size());
+    for (std::size_t i = 0; i < order.size(); ++i) {
+        permuted[i] = entityPool.data[order[i]];
+        if (order[i] != i) {
+            entList.changeEntity(permuted[i], PoolIdx(i), spawnerId);
+            entityChanges.mark(i);
+        }
+    }
+    entityPool.data.swap(permuted);
+}
+
+inline void EntitySpawner::save(std::ostream& os) const
+{
+    WriteValue(os, std::uint64_t(entityPool.data.size()));
+    WriteBytes(os, entityPool.data.data(), entityPool.data.size() * sizeof(Entity));
+    for (auto const& pool : cPools)
+        pool.save(os);
+}
+
+inline void EntitySpawner::load(std::istream& is, std::shared_ptr<void> const& memoryOwner)
+{
+    EPP_ASSERTA(entityPool.data.empty());
+    auto n = std::size_t(ReadValue<std::uint64_t>(is));
+    entityPool.data.resize(n);
+    ReadBytes(is, entityPool.data.data(), n * sizeof(Entity));
+    entityChanges.mark(0, n);
+    for (auto& pool : cPools) {
+        pool.load(is, memoryOwner);
+        EPP_ASSERTA_M(pool.size() == n, "Corrupted spawner");
+    }
+    if (observed)
+        for (auto ent : entityPool.data)
+            recordEvent(EntityEvent::Type::Creation, ent);
+}
+
+inline void EntitySpawner::trackChanges(bool enable)
+{
+    entityChanges.enable(enable);
+    entityHashes.invalidate();
+    for (auto& pool : cPools)
+        pool.trackChanges(enable);
+}
+
+inline void EntitySpawner::clearChanges()
+{
+    entityChanges.clear();
+    for (auto& pool : cPools)
+        pool.clearChanges();
+}
+
+inline void EntitySpawner::saveChanges(std::ostream& os) const
+{
+    WriteValue(os, std::uint64_t(entityPool.data.size()));
+    entityChanges.save(os, entityPool.data.data(), sizeof(Entity), entityPool.data.size());
+    for (auto const& pool : cPools)
+        pool.saveChanges(os);
+}
+
+inline void EntitySpawner::loadChanges(std::istream& is)
+{
+    auto n = std::size_t(ReadValue<std::uint64_t>(is));
+    entityPool.data.resize(n);
+    entityChanges.load(is, entityPool.data.data(), sizeof(Entity), n);
+    for (auto& pool : cPools) {
+        pool.loadChanges(is);
+        EPP_ASSERTA_M(pool.size() == n, "Corrupted delta");
+    }
+}
+
+inline std::uint64_t EntitySpawner::checksum(CMask const& excluded)
+{
+    std::uint64_t hash = entityHashes.update(entityPool.data.data(), sizeof(Entity), entityPool.data.size(), entityChanges);
+    for (auto& pool : cPools)
+        if (!excluded.get(pool.getCId()))
+            hash = HashCombine(HashCombine(hash, pool.getCId().value), pool.checksum());
+    return hash;
+}
+
+inline void EntitySpawner::copyInto(Frame& frame) const
+{
+    bool sameLayout = frame.cPools.size() == cPools.size() &&
+                      std::equal(cPools.begin(), cPools.end(), frame.cPools.begin(), [](CPool const& lhs, CPool const& rhs) { return lhs.getCId() == rhs.getCId(); });
+    if (!sameLayout) {
+        frame.cPools.clear();
+        for (auto const& pool : cPools)
+            frame.cPools.emplace_back(pool.getCId());
+    }
+    frame.entities.assign(entityPool.data.begin(), entityPool.data.end());
+    frame.entityChanges.assign(entityChanges);
+    for (std::size_t i = 0; i < cPools.size(); ++i) {
+        frame.cPools[i].copyFrom(cPools[i]);
+        frame.cPools[i].assignChanges(cPools[i].getChanges());
+    }
+}
+
+inline void EntitySpawner::restoreFrom(Frame const& frame, bool onlyChanged)
+{
+    EPP_ASSERTA_M(frame.cPools.size() == cPools.size(), "The frame does not match the spawner");
+    for (std::size_t i = 0; i < cPools.size(); ++i) {
+        EPP_ASSERTA_M(frame.cPools[i].getCId() == cPools[i].getCId(), "The frame does not match the spawner");
+        if (onlyChanged)
+            cPools[i].copyChangedFrom(frame.cPools[i]);
+        else
+            cPools[i].copyFrom(frame.cPools[i]);
+    }
+    auto common = onlyChanged ? std::min(entityPool.data.size(), frame.entities.size()) : 0;
+    entityPool.data.resize(frame.entities.size());
+    std::copy(frame.entities.begin() + common, frame.entities.end(), entityPool.data.begin() + common);
+    entityChanges.mark(common, entityPool.data.size());
+    entityChanges.copyMarked(entityPool.data.data(), frame.entities.data(), sizeof(Entity), common);
+}
+
+inline void EntitySpawner::mergeChanges(Frame const& frame)
+{
+    entityChanges.merge(frame.entityChanges);
+    for (std::size_t i = 0; i < cPools.size() && i < frame.cPools.size(); ++i)
+        cPools[i].mergeChanges(frame.cPools[i].getChanges());
+}
+
 inline Archetype EntitySpawner::makeArchetype() const
 {
     Archetype arch;
@@ -0,0 +1,169 @@
+#ifndef EPP_HIERARCHY_H
+#define EPP_HIERARCHY_H
+
+#include <ECSpp/internal/EntityList.h>
+#include <algorithm>
+#include <vector>
+
+namespace epp {
+
+/// Parent/child relationships of entities, flattened into an order where every parent precedes its children
+/**
+ * Relationships are stored by the ListIdx of the child, together with its version, so links of destroyed entities
+ * become stale by themselves - a child of a destroyed entity becomes a root.
+ * The flattened order is built breadth-first: entities are ordered by depth and children of one parent are grouped together
+ */
+class Hierarchy {
+public:
+    /// An entity in the flattened order
+    struct Link {
+        Entity entity;
+        std::uint32_t parentPos; // position of the parent in the order, BadPos for roots
+    };
+
+    using Order_t = std::vector<Link>;
+
+    constexpr static std::uint32_t const BadPos = std::uint32_t(-1);
+
+public:
+    /// Sets or removes the parent of an entity
+    /**
+     * @param child A valid entity
+     * @param parent A valid entity or an invalid one (e.g. Entity()) to remove the current parent
+     * @param entList List of entities used to check the validity
+     * @throws Throws the AssertionFailed exception (in debug and release) if parent is a descendant of child or child itself
+     * @throws (Debug only) Throws the AssertionFailed exception if child is invalid
+     */
+    void setParent(Entity child, Entity parent, EntityList const& entList);
+
+
+    /// Returns the parent of an entity
+    /**
+     * @param ent Any entity
+     * @param entList List of entities used to check the validity
+     * @returns The parent of ent or Entity() if ent has no valid parent
+     */
+    Entity parentOf(Entity ent, EntityList const& entList) const;
+
+
+    /// Rebuilds the flattened order (if the hierarchy was changed since the last rebuild)
+    /**
+     * Roots are ordered by their ListIdxs, children of one parent too
+     * @param entList List of entities used to check the validity
+     */
+    void rebuild(EntityList const& entList);
+
+
+    /// Forces the next rebuild (e.g. when a destroyed entity was found in the order)
+    void markDirty() { dirty = true; }
+
+
+    /** @returns True if the order is not up to date */
+    bool isDirty() const { return dirty; }
+
+
+    /// Returns the flattened order
+    /**
+     * @returns Every entity that has a parent or a child, parents always precede their children
+     */
+    Order_t const& getOrder() const { return order; }
+
+
+    /// Returns the positions in the order where each depth begins
+    /**
+     * Entities of one depth do not depend on each other, so they can be processed in any order
+     * @returns The beginning of each depth (roots are depth 0), followed by the size of the order
+     */
+    std::vector<std::size_t> const& getDepthBegins() const { return depthBegins; }
+
+private:
+    struct Node {
+        Entity self;
+        Entity parent;
+    };
+
+private:
+    std::vector<Node> nodes; // indexed by ListIdx of the child
+
+    Order_t order;
+
+    std::vector<std::size_t> depthBegins;
+
+    std::vector<std::uint32_t> childBegins; // rebuild scratch - children of ListIdx i are in children[childBegins[i], childBegins[i + 1])
+
+    std::vector<std::uint32_t> nextChild;
+
+    std::vector<ListIdx> children;
+
+    bool dirty = false;
+};
+
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+inline void Hierarchy::setParent(Entity child, Entity parent, EntityList const& entList)
+{
+    EPP_ASSERT(entList.isValid(child));
+    for (Entity ancestor = parent; entList.isValid(ancestor); ancestor = parentOf(ancestor, entList)) {
+        EPP_ASSERTA_M(ancestor != child, "Cycles are not allowed");
+    }
+    if (nodes.size() <= child.listIdx.value)
+        nodes.resize(std::size_t(child.listIdx.value) + 1, Node{ Entity(), Entity() });
+    nodes[child.listIdx.value] = Node{ child, entList.isValid(parent) ? parent : Entity() };
+    dirty = true;
+}
+
+inline Entity Hierarchy::parentOf(Entity ent, EntityList const& entList) const
+{
+    if (ent.listIdx.value >= nodes.size() || nodes[ent.listIdx.value].self != ent || !entList.isValid(nodes[ent.listIdx.value].parent))
+        return Entity();
+    return nodes[ent.listIdx.value].parent;
+}
+
+inline void Hierarchy::rebuild(EntityList const& entList)
+{
+    if (!dirty)
+        return;
+    dirty = false;
+    auto hasParent = [&](std::size_t i) { return i < nodes.size() && entList.isValid(nodes[i].self) && entList.isValid(nodes[i].parent); };
+
+    // children grouped by the ListIdx of their parent (counting sort)
+    std::size_t bound = nodes.size();
+    for (std::size_t i = 0; i < nodes.size(); ++i)
+        if (hasParent(i))
+            bound = std::max(bound, std::size_t(nodes[i].parent.listIdx.value) + 1);
+    childBegins.assign(bound + 1, 0);
+    for (std::size_t i = 0; i < nodes.size(); ++i)
+        if (hasParent(i))
+            ++childBegins[nodes[i].parent.listIdx.value + 1];
+    for (std::size_t i = 1; i < childBegins.size(); ++i)
+        childBegins[i] += childBegins[i - 1];
+    children.resize(childBegins.back());
+    nextChild.assign(childBegins.begin(), childBegins.end() - 1);
+    for (std::size_t i = 0; i < nodes.size(); ++i)
+        if (hasParent(i))
+            children[nextChild[nodes[i].parent.listIdx.value]++] = ListIdx(i);
+
+    // roots - entities with children, but without a parent
+    order.clear();
+    for (std::size_t i = 0; i < bound; ++i)
+        if (childBegins[i] != childBegins[i + 1] && !hasParent(i))
+            order.push_back({ nodes[children[childBegins[i]].value].parent, BadPos });
+
+    // breadth-first, one depth at a time
+    depthBegins.assign(1, 0);
+    for (std::size_t pos = 0; pos < order.size();) {
+        std::size_t depthEnd = order.size();
+        for (; pos < depthEnd; ++pos) {
+            auto parentIdx = order[pos].entity.listIdx.value;
+            for (auto c = childBegins[parentIdx]; c < childBegins[parentIdx + 1]; ++c)
+                order.push_back({ nodes[children[c].value].self, std::uint32_t(pos) });
+        }
+        depthBegins.push_back(depthEnd);
+    }
+}
+
+} // namespace epp
+
+#endif // EPP_HIERARCHY_H
\ No newline at end of file
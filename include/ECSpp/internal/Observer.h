@@ -0,0 +1,112 @@
+#ifndef EPP_OBSERVER_H
+#define EPP_OBSERVER_H
+
+#include <ECSpp/internal/CMask.h>
+#include <ECSpp/internal/EntityList.h>
+#include <functional>
+#include <vector>
+
+namespace epp {
+
+using ObserverId = IndexType<4>;
+
+/// A structural change of a single entity, recorded by EntitySpawner
+struct EntityEvent {
+    enum class Type : std::uint8_t { Creation,    // entity was spawned
+                                     Destruction, // entity was destroyed (it is already invalid when the event is delivered)
+                                     Arrival,     // entity was moved to this spawner from otherSpawnerId (components were added/removed)
+                                     Departure }; // entity was moved from this spawner to otherSpawnerId (components were added/removed)
+
+    Type type;
+    Entity entity;
+    SpawnerId otherSpawnerId; // used only by Arrival and Departure events
+};
+
+using EntityEvents_t = std::vector<EntityEvent>;
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+/// A callback that receives batches of EntityEvents of the entities that own a certain set of components
+/**
+ * Observer works like a Selection - it accepts spawners that contain all of the wanted components and none of the unwanted ones.
+ * Events are buffered in the queues of accepted spawners and delivered in batches (one batch for each spawner) by EntityManager::notifyObservers.
+ * For Arrival and Departure events, the observer is notified only when the entity starts or stops meeting its requirements
+ * (moving between two accepted spawners is not reported)
+ */
+class Observer {
+public:
+    using Callback_t = std::function<void(EntityEvents_t const&)>;
+
+public:
+    /// Constructs an observer with a specified requirements
+    /**
+     * @param wanted Mask of components the entities must have
+     * @param unwanted Mask of components the entities mustn't have
+     * @param callback A callable object that accepts a batch of events (EntityEvents_t const&)
+     */
+    Observer(CMask wanted, CMask unwanted, Callback_t callback);
+
+
+    /// Returns whether entities of a spawner with a given mask are observed
+    /**
+     * @param spawnerMask The mask of some spawner
+     * @returns True if the mask contains all of the wanted components and none of the unwanted ones, false otherwise
+     */
+    bool meetsRequirements(CMask const& spawnerMask) const;
+
+
+    /// Returns whether the observer was not removed
+    bool isActive() const { return active; }
+
+
+    /// Stops delivering events to this observer
+    /** The callback is kept until releaseCallback is called, so an observer can be deactivated by its own callback */
+    void deactivate() { active = false; }
+
+
+    /// Destroys the callback of a deactivated observer
+    void releaseCallback()
+    {
+        EPP_ASSERT(!active);
+        callback = nullptr;
+    }
+
+
+    /// Delivers a batch of events to the callback
+    /**
+     * @param events Events recorded by one spawner
+     */
+    void notify(EntityEvents_t const& events) const { callback(events); }
+
+
+    /** @returns Mask with wanted types of components */
+    CMask const& getWanted() const { return wantedMask; }
+
+
+    /** @returns Mask with unwanted types of components */
+    CMask const& getUnwanted() const { return unwantedMask; }
+
+private:
+    CMask wantedMask;
+    CMask unwantedMask;
+    Callback_t callback;
+    bool active = true;
+};
+
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+inline Observer::Observer(CMask wanted, CMask unwanted, Callback_t cb)
+    : wantedMask(std::move(wanted)), unwantedMask(unwanted.removeCommon(wantedMask)), callback(std::move(cb))
+{}
+
+inline bool Observer::meetsRequirements(CMask const& spawnerMask) const
+{
+    return isActive() && spawnerMask.contains(wantedMask) && !spawnerMask.hasCommon(unwantedMask);
+}
+
+} // namespace epp
+
+#endif // EPP_OBSERVER_H
\ No newline at end of file
@@ -0,0 +1,226 @@
+#ifndef EPP_RESOURCES_H
+#define EPP_RESOURCES_H
+
+#include <ECSpp/internal/utility/BinaryIO.h>
+#include <ECSpp/internal/utility/Hash.h>
+#include <ECSpp/internal/utility/IndexType.h>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <type_traits>
+#include <typeinfo>
+#include <vector>
+
+namespace epp {
+
+using ResourceId = IndexType<5>;
+
+/// Typed singletons (e.g. time, input, config) owned by EntityManager, at most one value of each type
+/**
+ * Every value is allocated separately, so references to it stay valid until it is removed.
+ * Trivially copyable values can be saved, loaded and copied into frames - they are matched by the hash of the type's name
+ */
+class Resources {
+public:
+    /// A copy of the values (a part of WorldFrame)
+    struct Frame {
+        struct Value {
+            ResourceId id;
+            std::vector<std::uint8_t> bytes;
+        };
+
+        std::vector<Value> values;
+    };
+
+public:
+    /// Returns a unique id of a given type, assigned on the first call
+    /**
+     * Ids are shared by every instance of Resources, but they depend on the order of the first calls,
+     * so they mustn't be serialized
+     * @tparam T Any type
+     * @returns The id of T
+     */
+    template <typename T>
+    static ResourceId IdOf()
+    {
+        static ResourceId id(NextId()++);
+        return id;
+    }
+
+
+    /// Constructs a value of type T, replacing the current one
+    /**
+     * @tparam T Type of the value
+     * @tparam Args Types of arguments that will be forwarded to the constructor
+     * @param args Arguments forwarded to the constructor of T
+     * @returns A reference to the new value
+     */
+    template <typename T, typename... Args>
+    T& emplace(Args&&... args);
+
+
+    /// Returns the value of type T
+    /**
+     * @tparam T Type of the value
+     * @returns A pointer to the value or nullptr if there is none
+     */
+    template <typename T>
+    T* find()
+    {
+        auto id = IdOf<T>().value;
+        return id < entries.size() ? static_cast<T*>(entries[id].data.get()) : nullptr;
+    }
+
+
+    /** @copydoc Resources::find() */
+    template <typename T>
+    T const* find() const { return const_cast<Resources*>(this)->find<T>(); }
+
+
+    /// Destroys the value of type T (no-op if there is none)
+    /**
+     * @tparam T Type of the value
+     */
+    template <typename T>
+    void erase();
+
+
+    /** @returns True if every value is trivially copyable */
+    bool isTriviallyCopyable() const;
+
+
+    /// Writes every value
+    /**
+     * @param os Binary output stream
+     * @throws Throws the AssertionFailed exception (in debug and release) if any of the values is not trivially copyable or if writing failed
+     */
+    void save(std::ostream& os) const;
+
+
+    /// Reads the values written by the save function, over the current values of the same types
+    /**
+     * Values that were not saved are not changed
+     * @param is Binary input stream
+     * @throws Throws the AssertionFailed exception (in debug and release) if the stream contains a value of a type that
+     * does not have a value here (a resource has to be added before loading) or if the stream ended unexpectedly
+     */
+    void load(std::istream& is);
+
+
+    /// Copies every value into a frame, reusing its memory
+    /**
+     * @param frame Any frame
+     * @throws (Debug only) Throws the AssertionFailed exception if any of the values is not trivially copyable
+     */
+    void copyInto(Frame& frame) const;
+
+
+    /// Copies the values stored in a frame back (values added after the copy was made are not changed)
+    /**
+     * @param frame A frame filled by the copyInto function
+     * @throws Throws the AssertionFailed exception (in debug and release) if any of the copied values was removed since then
+     */
+    void restoreFrom(Frame const& frame);
+
+private:
+    struct Entry {
+        std::shared_ptr<void> data; // null if there is no value of this type
+        std::uint64_t nameHash;
+        std::size_t size;
+        bool triviallyCopyable;
+    };
+
+private:
+    static std::atomic<std::size_t>& NextId()
+    {
+        static std::atomic<std::size_t> nextId{ 0 };
+        return nextId;
+    }
+
+private:
+    std::vector<Entry> entries; // by ResourceId
+};
+
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+template <typename T, typename... Args>
+inline T& Resources::emplace(Args&&... args)
+{
+    static_assert(std::is_same_v<std::decay_t<T>, T>);
+    auto id = IdOf<T>().value;
+    if (entries.size() <= id)
+        entries.resize(std::size_t(id) + 1);
+    auto value = std::make_shared<T>(std::forward<Args>(args)...);
+    T& ref = *value;
+    entries[id] = Entry{ std::move(value), HashString(typeid(T).name()), sizeof(T), std::is_trivially_copyable_v<T> };
+    return ref;
+}
+
+template <typename T>
+inline void Resources::erase()
+{
+    if (auto id = IdOf<T>().value; id < entries.size())
+        entries[id].data = nullptr;
+}
+
+inline bool Resources::isTriviallyCopyable() const
+{
+    for (auto const& entry : entries)
+        if (entry.data && !entry.triviallyCopyable)
+            return false;
+    return true;
+}
+
+inline void Resources::save(std::ostream& os) const
+{
+    EPP_ASSERTA_M(isTriviallyCopyable(), "Only trivially copyable resources can be saved");
+    WriteValue(os, std::uint64_t(std::count_if(entries.begin(), entries.end(), [](Entry const& entry) { return bool(entry.data); })));
+    for (auto const& entry : entries)
+        if (entry.data) {
+            WriteValue(os, entry.nameHash);
+            WriteValue(os, std::uint64_t(entry.size));
+            WriteBytes(os, entry.data.get(), entry.size);
+        }
+}
+
+inline void Resources::load(std::istream& is)
+{
+    for (auto n = ReadValue<std::uint64_t>(is); n > 0; --n) {
+        auto nameHash = ReadValue<std::uint64_t>(is);
+        auto size = std::size_t(ReadValue<std::uint64_t>(is));
+        auto entry = std::find_if(entries.begin(), entries.end(), [nameHash](Entry const& e) { return e.data && e.nameHash == nameHash; });
+        EPP_ASSERTA_M(entry != entries.end() && entry->size == size && entry->triviallyCopyable, "Saved resource does not exist in this EntityManager");
+        ReadBytes(is, entry->data.get(), size);
+    }
+}
+
+inline void Resources::copyInto(Frame& frame) const
+{
+    EPP_ASSERT(isTriviallyCopyable());
+    std::size_t n = 0;
+    for (std::size_t id = 0; id < entries.size(); ++id)
+        if (entries[id].data) {
+            if (frame.values.size() <= n)
+                frame.values.emplace_back();
+            auto bytes = static_cast<std::uint8_t const*>(entries[id].data.get());
+            frame.values[n].id = ResourceId(id);
+            frame.values[n++].bytes.assign(bytes, bytes + entries[id].size);
+        }
+    frame.values.resize(n);
+}
+
+inline void Resources::restoreFrom(Frame const& frame)
+{
+    for (auto const& value : frame.values) {
+        EPP_ASSERTA_M(value.id.value < entries.size() && entries[value.id.value].data, "The frame does not match this EntityManager");
+    }
+    for (auto const& value : frame.values)
+        std::memcpy(entries[value.id.value].data.get(), value.bytes.data(), value.bytes.size());
+}
+
+} // namespace epp
+
+#endif // EPP_RESOURCES_H
\ No newline at end of file
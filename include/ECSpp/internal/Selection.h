@@ -1,22 +1,38 @@
 #ifndef EPP_SELECTION_H
 #define EPP_SELECTION_H
 
+#include <ECSpp/internal/ColdStorage.h>
 #include <ECSpp/internal/EntityList.h>
 #include <ECSpp/internal/EntitySpawner.h>
+#include <ECSpp/internal/SharedStore.h>
+#include <ECSpp/internal/SoA.h>
+#include <ECSpp/internal/SparseSet.h>
+#include <ECSpp/internal/utility/ThreadPool.h>
 #include <ECSpp/internal/utility/TuplePP.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <exception>
+#include <iterator>
+#include <tuple>
 #include <type_traits>
+#include <utility>
+#include <vector>
 
 
 namespace epp {
 
 /// A set of valid iteration-time operations on EntityManager
 /** "Current" refers to the entity provided by Selection in forEach method. \
- * This means, that performing these operations on other entities is an undefined behaviour. */
+ * This means, that performing these operations on other entities is an undefined behaviour.
+ * MarkedCurrent destroys the current entity after the whole spawner is visited, together with the other marked ones
+ * (one compaction of each pool instead of a swap-remove per entity, see EntityManager::destroy(first, last)) */
 enum class IterTimeChange : std::size_t { ArchetypeCurrent = 0,
                                           DestroyedCurrent = 0,
                                           SpawnedNew = 1,
                                           AnyClear = 1,
-                                          ChangeFailed = 1 };
+                                          ChangeFailed = 1,
+                                          MarkedCurrent = 2 };
 
 
 template <typename... CTypes>
@@ -27,6 +43,70 @@ class Selection;
 template <bool IsConst, typename T>
 using CondConstType = std::conditional_t<IsConst, std::add_const_t<T>, T>;
 
+/// The type of the value passed to Selection::forEach for a selected component type
+/** The value of a shared component (const), the value of a cold component (a pointer to it for a const one, nullptr if it was not allocated),
+ * a proxy of the fields of a SoA<T>, the component itself otherwise */
+template <typename T>
+struct SelectedType {
+    using type = T;
+};
+
+template <typename T>
+struct SelectedType<Shared<T>> {
+    using type = T const;
+};
+
+template <typename T>
+struct SelectedType<Shared<T> const> {
+    using type = T const;
+};
+
+template <typename T>
+struct SelectedType<Cold<T>> {
+    using type = T;
+};
+
+template <typename T>
+struct SelectedType<Cold<T> const> {
+    using type = T const*;
+};
+
+template <typename T>
+struct SelectedType<SoA<T>> {
+    using type = SoARef<T>;
+};
+
+template <typename T>
+struct SelectedType<SoA<T> const> {
+    using type = SoARef<T const>;
+};
+
+template <typename T>
+using SelectedType_t = typename SelectedType<T>::type;
+
+/// The type of the argument passed to Selection::forEach - a reference to SelectedType_t<T>, proxies and pointers are passed by value
+template <typename T>
+using SelectedArg_t = std::conditional_t<IsSoA_v<T> || std::is_pointer_v<SelectedType_t<T>>, SelectedType_t<T>, SelectedType_t<T>&>;
+
+/// The type of the argument passed to Selection::forEachChunk - the arrays of the fields of a SoA<T>, the array of the components otherwise
+template <typename T>
+struct SelectedChunk {
+    using type = T*;
+};
+
+template <typename T>
+struct SelectedChunk<SoA<T>> {
+    using type = SoAChunk<T>;
+};
+
+template <typename T>
+struct SelectedChunk<SoA<T> const> {
+    using type = SoAChunk<T const>;
+};
+
+template <typename T>
+using SelectedChunk_t = typename SelectedChunk<T>::type;
+
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 
@@ -45,11 +125,27 @@ struct SelectionBase<true, CTypes...> {
     template <typename T> // discard T
     struct PoolsPtrs_t : public std::vector<CPool*> {};
 
+    template <typename T> // used only by shared components
+    struct StorePtr_t {
+        SharedStore<std::remove_const_t<SelectedType_t<T>>> const* store = nullptr;
+    };
+
+    template <typename T> // used only by sparse components
+    struct SparsePtr_t {
+        SparseSet<std::remove_const_t<T>>* set = nullptr;
+    };
+
     using PoolsPtrsPack_t = TuplePP<PoolsPtrs_t<CTypes>...>;
+    using StoresPtrsPack_t = TuplePP<StorePtr_t<CTypes>...>;
+    using SparsePtrsPack_t = TuplePP<SparsePtr_t<CTypes>...>;
 
 
     PoolsPtrsPack_t poolsPack; // for each component type, a vector of pools of that component,
                                // one pool for each accepted spawner (archetype)
+
+    StoresPtrsPack_t storesPack; // for each shared component type, the store of its values
+
+    SparsePtrsPack_t sparsePack; // for each sparse component type, the set of the components
 };
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -59,7 +155,9 @@ struct SelectionBase<true, CTypes...> {
 /**
  * Using forEach member function you can iterate over each entity that ows at least all of the components of CTypes... types.
  * This class stores pointers to CPools and EntityPools of the EntitySpawners with
- * archetypes that matches the specified requirements (CTypes and unwanted mask)
+ * archetypes that matches the specified requirements (CTypes and unwanted mask).
+ * Sparse components (see SparseStorage) are not a part of the archetypes - the entities of the accepted spawners are 
+ * filtered by them or, if the smallest of the sparse sets is smaller than the accepted spawners, the sparse set is iterated instead
  * @tparam CTypes A pack of component types used to select wanted entities
  */
 template <typename... CTypes>
@@ -69,6 +167,10 @@ class Selection : public SelectionBase<(sizeof...(CTypes) > 0), CTypes...> {
     using SpawnerIds_t = std::vector<SpawnerId>;
 
 
+public:
+    class Iterator;
+
+
 public:
     /// Constructs a selection with a specified requirements
     /**
@@ -79,13 +181,96 @@ public:
 
     /// Calls func on each entity that this selection covers
     /**
-     * @tparam Func A callable type that accepts (Entity, CTypes&...) as arguments
-     * @param func A callable object that accepts (Entity, CTypes&...) as arguments
+     * Components of non-const types of every visited entity are assumed to be modified (see CPool::trackChanges), 
+     * so use const types for the components that are only read. A delta of a world iterated with non-const types grows with
+     * the number of visited entities - to modify only a few of them, select const types and write through EntityManager::componentOf.
+     * For shared components (Shared<T>), func receives a const reference to the shared value (T const&).
+     * For SoA<T>, func receives a SoARef<T> by value.
+     * func may add and remove sparse components of the current entity. func returning IterTimeChange::MarkedCurrent
+     * destroys the current entity in a batch, after the rest of its spawner is visited
+     * @tparam Func A callable type that accepts (Entity, SelectedArg_t<CTypes>...) as arguments
+     * @param func A callable object that accepts (Entity, SelectedArg_t<CTypes>...) as arguments
      */
     template <typename Func>
     void forEach(Func func);
 
 
+    /// Calls func once for each non-empty accepted spawner, with the arrays of its entities and components
+    /**
+     * Meant for vectorized loops - for SoA<T>, func receives the arrays of the fields (SoAChunk<T>).
+     * Every non-const component of the spawner is assumed to be modified. Only plain components and SoA<T> can be selected.
+     * func mustn't spawn, destroy or move entities
+     * @tparam Func A callable type that accepts (Entity const*, std::size_t, SelectedChunk_t<CTypes>...) as arguments
+     * @param func A callable object that accepts (Entity const* entities, std::size_t n, SelectedChunk_t<CTypes>...) as arguments
+     */
+    template <typename Func>
+    void forEachChunk(Func func);
+
+
+    /// Returns an iterator to the first entity that this selection covers, for the range-based for loop and std algorithms
+    /**
+     * Marks every non-const component of the covered entities as modified (like forEach), so the iteration itself can run
+     * on many threads (e.g. std::for_each(std::execution::par_unseq, ...)). Iterators are invalidated when an entity is
+     * spawned, destroyed or moved. Sparse components cannot be selected
+     * @returns An iterator to the first entity
+     */
+    Iterator begin();
+
+
+    /** @returns An iterator past the last entity that this selection covers */
+    Iterator end();
+
+
+    /// Calls func once for each non-empty accepted spawner, with the iterators to its first and past its last entity
+    /**
+     * Meant for algorithms that should stay contiguous within each spawner (the components of one spawner are stored in arrays)
+     * @tparam Func A callable type that accepts (Iterator, Iterator) as arguments
+     * @param func A callable object that accepts (Iterator first, Iterator last) as arguments
+     */
+    template <typename Func>
+    void forEachSegment(Func func);
+
+
+    /// Reduces the entities that this selection covers to a single value, using many threads
+    /**
+     * Runs on the threads of a persistent ThreadPool (no threads are created per call).
+     * Entities are split into chunks of up to ReduceChunkSize consecutive entities of one spawner. Each chunk is accumulated
+     * into its own copy of identity (kept in a local variable, so the loop over an arithmetic type can stay in registers)
+     * and the results of the chunks are combined in the order of the chunks on the calling thread, so the result does not depend
+     * on the number of threads, also for the operations that are not associative (like floating-point addition).
+     * Components are marked as modified like in forEach, so use const types.
+     * accumulate is called concurrently, it mustn't modify anything but its first argument
+     * @tparam T Copy constructible type of the result
+     * @tparam AccumulateFn A callable type that accepts (T&, Entity, SelectedArg_t<CTypes>...) as arguments
+     * @tparam CombineFn A callable type that accepts (T, T) as arguments and returns T
+     * @param identity The initial value of the result and of each chunk
+     * @param accumulate Adds an entity to the result of its chunk
+     * @param combine Combines the result of the previous chunks (the first argument) with the result of the next chunk
+     * @param threadsNum The maximal number of threads, including the calling one (0 - all threads of pool)
+     * @param pool The pool that runs the chunks
+     * @returns identity combined with the results of every chunk
+     */
+    template <typename T, typename AccumulateFn, typename CombineFn>
+    T reduce(T identity, AccumulateFn accumulate, CombineFn combine, std::size_t threadsNum = 0, ThreadPool& pool = ThreadPool::shared());
+
+
+    /// Reduces the values computed for each entity to a single value, using many threads
+    /**
+     * The same as reduce with accumulate(acc, ...) equal to acc = combine(acc, map(...))
+     * @tparam T Copy constructible type of the result
+     * @tparam MapFn A callable type that accepts (Entity, SelectedArg_t<CTypes>...) as arguments and returns T
+     * @tparam CombineFn A callable type that accepts (T, T) as arguments and returns T
+     * @param identity The initial value of the result and of each chunk
+     * @param map Computes the value of an entity, called concurrently
+     * @param combine Combines two values, called concurrently
+     * @param threadsNum The maximal number of threads, including the calling one (0 - all threads of pool)
+     * @param pool The pool that runs the chunks
+     * @returns identity combined with the values of every entity
+     */
+    template <typename T, typename MapFn, typename CombineFn>
+    T transformReduce(T identity, MapFn map, CombineFn combine, std::size_t threadsNum = 0, ThreadPool& pool = ThreadPool::shared());
+
+
     /** @returns Mask with wanted types of components (CTypes...) */
     CMask const& getWanted() const;
 
@@ -101,45 +286,522 @@ private:
     void addSpawnerIfMeetsRequirements(EntitySpawner& spawner);
 
     template <typename T>
-    T& getComponent(std::size_t sIdx, std::size_t eIdx) { return *static_cast<T*>((
-        *this->poolsPack.template get<typename Base_t::template PoolsPtrs_t<T>>()[sIdx])[eIdx]); }
+    CPool* getPool(std::size_t sIdx) { return this->poolsPack.template get<typename Base_t::template PoolsPtrs_t<T>>()[sIdx]; }
+
+    template <typename T>
+    auto& getStore() { return this->storesPack.template get<typename Base_t::template StorePtr_t<T>>().store; }
+
+    template <typename T>
+    auto& getSparse() { return this->sparsePack.template get<typename Base_t::template SparsePtr_t<T>>().set; }
+
+    template <typename T>
+    bool hasSparse(Entity ent)
+    {
+        if constexpr (IsSparse_v<T>)
+            return getSparse<T>()->find(ent) != nullptr;
+        return true;
+    }
+
+    template <typename T>
+    auto fieldArrays(std::size_t sIdx)
+    {
+        constexpr std::size_t N = FieldCount_v<typename std::remove_const_t<T>::Value_t>;
+        auto& pools = this->poolsPack.template get<typename Base_t::template PoolsPtrs_t<T>>();
+        std::array<void*, N> arrays;
+        for (std::size_t i = 0; i < N; ++i)
+            arrays[i] = pools[sIdx * N + i]->rawData();
+        return arrays;
+    }
+
+    template <typename T>
+    SelectedArg_t<T> getComponent(std::size_t sIdx, std::size_t eIdx)
+    {
+        if constexpr (IsSparse_v<T>)
+            return *getSparse<T>()->find(getEntity(sIdx, eIdx));
+        else {
+            EPP_ASSERT(IsSoA_v<T> || eIdx < getPool<T>(sIdx)->size());
+            return componentAt<T>(arrayOf<T>(sIdx), sIdx, eIdx);
+        }
+    }
+
+    template <typename T>
+    void* arrayOf(std::size_t sIdx)
+    {
+        if constexpr (IsSparse_v<T> || IsSoA_v<T>)
+            return nullptr;
+        else
+            return getPool<T>(sIdx)->rawData();
+    }
+
+    template <typename T>
+    SelectedArg_t<T> componentAt(void* array, std::size_t sIdx, std::size_t eIdx) // array from arrayOf<T>(sIdx)
+    {
+        if constexpr (IsSoA_v<T>)
+            return SelectedType_t<T>(fieldArrays<T>(sIdx), eIdx);
+        else {
+            auto& component = static_cast<T*>(array)[eIdx];
+            if constexpr (IsShared_v<T>)
+                return getStore<T>()->get(component);
+            else if constexpr (IsCold_v<T> && std::is_const_v<T>)
+                return component.get();
+            else if constexpr (IsCold_v<T>)
+                return *component;
+            else
+                return component;
+        }
+    }
+
+    template <typename T>
+    void markChanged(std::size_t sIdx, std::size_t first, std::size_t last)
+    {
+        if constexpr (IsSoA_v<T> && !std::is_const_v<T>) {
+            constexpr std::size_t N = FieldCount_v<typename T::Value_t>;
+            auto& pools = this->poolsPack.template get<typename Base_t::template PoolsPtrs_t<T>>();
+            for (std::size_t i = 0; i < N; ++i)
+                pools[sIdx * N + i]->markChanged(first, last);
+        } else if constexpr (!std::is_const_v<T> && !IsShared_v<T> && !IsSparse_v<T> && !IsSoA_v<T>) // handles of shared components are only read
+            getPool<T>(sIdx)->markChanged(first, last);
+    }
+
+    template <typename T>
+    static void AddIfDense(CMask& mask)
+    {
+        if constexpr (IsSoA_v<T>) {
+            for (auto id : IdOfFields<typename std::remove_const_t<T>::Value_t>())
+                mask.set(id);
+        } else if constexpr (!IsSparse_v<T>)
+            mask.set(IdOf<std::remove_const_t<T>>());
+    }
+
+    static CMask DenseMask()
+    {
+        CMask mask;
+        (AddIfDense<CTypes>(mask), ...);
+        return mask;
+    }
+
+    template <typename T>
+    void addPool(EntitySpawner& spawner)
+    {
+        auto& pools = this->poolsPack.template get<typename Base_t::template PoolsPtrs_t<T>>();
+        if constexpr (IsSoA_v<T>) { // one pool of each field
+            for (auto id : IdOfFields<typename std::remove_const_t<T>::Value_t>())
+                pools.push_back(&spawner.getPool(id));
+        } else if constexpr (!IsSparse_v<T>)
+            pools.push_back(&spawner.getPool(IdOf<std::remove_const_t<T>>()));
+    }
+
+    template <typename T>
+    SelectedChunk_t<T> getChunk(std::size_t sIdx)
+    {
+        static_assert(!IsShared_v<T> && !IsCold_v<T> && !IsSparse_v<T>, "Only plain components and SoA<T> can be iterated in chunks");
+        if constexpr (IsSoA_v<T>)
+            return SelectedChunk_t<T>(fieldArrays<T>(sIdx), entityPools[sIdx]->data.size());
+        else
+            return static_cast<T*>(getPool<T>(sIdx)->rawData());
+    }
+
+    template <typename T>
+    void considerSparse(SparseSetBase const*& smallest)
+    {
+        if constexpr (IsSparse_v<T>)
+            if (!smallest || getSparse<T>()->size() < smallest->size())
+                smallest = getSparse<T>();
+    }
+
+    SparseSetBase const* smallestSparse();
+
+    template <typename Func>
+    void forEachSparse(SparseSetBase const& driver, Func& func);
 
     Entity getEntity(std::size_t sIdx, std::size_t eIdx) { return entityPools[sIdx]->data[eIdx]; }
 
+    std::size_t sizeOf(std::size_t sIdx) const { return entityPools[sIdx]->data.size(); }
+
+    std::size_t nextNonEmpty(std::size_t sIdx) const; // the first non-empty spawner from sIdx, entityPools.size() if none
+
+    std::size_t prevNonEmpty(std::size_t sIdx) const; // the last non-empty spawner before sIdx
+
+    template <typename T, typename AccumulateFn>
+    T accumulateChunk(T acc, std::size_t sIdx, std::size_t first, std::size_t last, AccumulateFn& accumulate);
+
 private:
     CMask const wantedMask;    // must be declared before unwanted
     CMask const unwantedMask;  // if wanted & unwated (common part) != 0, then unwanted = unwanted \ (unwanted & wanted)
     EntityPools_t entityPools; // one pool for each accepted spawner
     SpawnerIds_t spawnerIds;
+    std::vector<std::size_t> acceptedIdxs; // index of each accepted spawner by SpawnerId, BadIdx if not accepted
+    EntityList const* entList = nullptr;   // used only with sparse components
+    std::vector<Entity> marked;            // entities of the current spawner marked for destruction (IterTimeChange::MarkedCurrent)
+    void* owner = nullptr;                 // EntityManager that destroys the marked entities
+    void (*destroyMarked)(void* owner, std::vector<Entity>& marked) = nullptr;
     std::size_t checkedSpawnersNum = 0;
 
+public:
+    constexpr static std::size_t const ReduceChunkSize = 4096; // entities of one task of reduce
+
+private:
+    constexpr static bool const HasSparse = (IsSparse_v<CTypes> || ...);
+    constexpr static std::size_t const BadIdx = std::size_t(-1);
+
 
     friend class EntityManager;
 };
 
 
+/// A random access iterator over the entities of a Selection, in the order of forEach
+/**
+ * Dereferencing yields a tuple of the entity and its components (Entity, SelectedArg_t<CTypes>...) by value, like vector<bool>'s proxy.
+ * The position is a pair (index of a spawner, index of an entity in it), so moving within a spawner costs like a pointer increment.
+ * Moving by n across spawners and the distance between iterators of different spawners cost O(number of spawners)
+ */
 template <typename... CTypes>
-Selection<CTypes...>::Selection(CMask unwanted) : wantedMask(IdOfL<std::remove_const_t<CTypes>...>()),
+class Selection<CTypes...>::Iterator {
+public:
+    using iterator_category = std::random_access_iterator_tag;
+    using value_type = std::tuple<Entity, SelectedArg_t<CTypes>...>;
+    using difference_type = std::ptrdiff_t;
+    using pointer = void;
+    using reference = value_type;
+
+public:
+    /// Constructs a singular iterator
+    Iterator() = default;
+
+
+    /** @returns The entity and its components */
+    reference operator*() const { return deref(std::index_sequence_for<CTypes...>()); }
+
+
+    /** @returns The entity (and its components) n positions away */
+    reference operator[](difference_type n) const { return *(*this + n); }
+
+
+    Iterator& operator++()
+    {
+        if (++eIdx == size) {
+            eIdx = 0;
+            enter(sel->nextNonEmpty(sIdx + 1));
+        }
+        return *this;
+    }
+
+
+    Iterator& operator--()
+    {
+        if (eIdx == 0) {
+            enter(sel->prevNonEmpty(sIdx));
+            eIdx = size;
+        }
+        --eIdx;
+        return *this;
+    }
+
+
+    Iterator operator++(int) { return std::exchange(*this, std::next(*this)); }
+    Iterator operator--(int) { return std::exchange(*this, std::prev(*this)); }
+
+
+    Iterator& operator+=(difference_type n);
+    Iterator& operator-=(difference_type n) { return *this += -n; }
+    Iterator operator+(difference_type n) const { return Iterator(*this) += n; }
+    Iterator operator-(difference_type n) const { return Iterator(*this) += -n; }
+    friend Iterator operator+(difference_type n, Iterator const& it) { return it + n; }
+
+
+    difference_type operator-(Iterator const& rhs) const;
+
+
+    bool operator==(Iterator const& rhs) const { return sIdx == rhs.sIdx && eIdx == rhs.eIdx; }
+    bool operator!=(Iterator const& rhs) const { return !(*this == rhs); }
+    bool operator<(Iterator const& rhs) const { return sIdx < rhs.sIdx || (sIdx == rhs.sIdx && eIdx < rhs.eIdx); }
+    bool operator>(Iterator const& rhs) const { return rhs < *this; }
+    bool operator<=(Iterator const& rhs) const { return !(rhs < *this); }
+    bool operator>=(Iterator const& rhs) const { return !(*this < rhs); }
+
+private:
+    Iterator(Selection* selection, std::size_t spawnerIdx, std::size_t entityIdx) : sel(selection), eIdx(entityIdx) { enter(spawnerIdx); }
+
+    void enter(std::size_t spawnerIdx)
+    {
+        sIdx = spawnerIdx;
+        if (sIdx < sel->entityPools.size()) {
+            size = sel->sizeOf(sIdx);
+            entities = sel->entityPools[sIdx]->data.data();
+            arrays = { sel->template arrayOf<CTypes>(sIdx)... };
+        }
+    }
+
+    template <std::size_t... Is>
+    reference deref(std::index_sequence<Is...>) const
+    {
+        return reference(entities[eIdx], sel->template componentAt<CTypes>(arrays[Is], sIdx, eIdx)...);
+    }
+
+private:
+    Selection* sel = nullptr;
+    std::size_t sIdx = 0; // entityPools.size() for the end
+    std::size_t eIdx = 0; // always lower than the size of the spawner (or 0 for the end)
+
+    // the current spawner, cached so moving within it and dereferencing do not go through the selection
+    std::size_t size = 0;
+    Entity const* entities = nullptr;
+    std::array<void*, sizeof...(CTypes)> arrays{}; // components of each type, nullptr for SoA<T>
+
+    friend class Selection;
+};
+
+
+template <typename... CTypes>
+Selection<CTypes...>::Selection(CMask unwanted) : wantedMask(DenseMask()),
                                                   unwantedMask(unwanted.removeCommon(wantedMask))
 {}
 template <typename... CTypes>
 template <typename Func>
 void Selection<CTypes...>::forEach(Func func)
 {
-    static_assert(std::is_invocable_v<Func, Entity, CTypes&...>);
-    constexpr static bool ReturnsIterTimeChange = std::is_same_v<std::invoke_result_t<Func, Entity, CTypes&...>, IterTimeChange>;
-    constexpr static bool ReturnsVoid = std::is_same_v<std::invoke_result_t<Func, Entity, CTypes&...>, void>;
+    static_assert(std::is_invocable_v<Func, Entity, SelectedArg_t<CTypes>...>);
+    constexpr static bool ReturnsIterTimeChange = std::is_same_v<std::invoke_result_t<Func, Entity, SelectedArg_t<CTypes>...>, IterTimeChange>;
+    constexpr static bool ReturnsVoid = std::is_same_v<std::invoke_result_t<Func, Entity, SelectedArg_t<CTypes>...>, void>;
     static_assert(ReturnsIterTimeChange || ReturnsVoid, "Wrong return type of func");
 
-    for (std::size_t sIdx = 0; sIdx < entityPools.size(); ++sIdx)
+    if constexpr (HasSparse && ReturnsVoid) {
+        if (auto driver = smallestSparse(); driver->size() < countEntities()) {
+            forEachSparse(*driver, func);
+            return;
+        }
+    }
+    for (std::size_t sIdx = 0; sIdx < entityPools.size(); ++sIdx) {
+        if constexpr (!HasSparse) // every entity is visited
+            (markChanged<CTypes>(sIdx, 0, entityPools[sIdx]->data.size()), ...);
         for (std::size_t eIdx = 0; eIdx < entityPools[sIdx]->data.size();) {
-            if constexpr (ReturnsIterTimeChange)
-                eIdx += static_cast<std::size_t>(func(getEntity(sIdx, eIdx), getComponent<CTypes>(sIdx, eIdx)...));
-            else {
+            if constexpr (HasSparse) {
+                if (!(hasSparse<CTypes>(getEntity(sIdx, eIdx)) && ...)) {
+                    ++eIdx;
+                    continue;
+                }
+                (markChanged<CTypes>(sIdx, eIdx, eIdx + 1), ...);
+            }
+            if constexpr (ReturnsIterTimeChange) {
+                Entity ent = getEntity(sIdx, eIdx);
+                auto change = func(ent, getComponent<CTypes>(sIdx, eIdx)...);
+                if (change == IterTimeChange::MarkedCurrent) {
+                    marked.push_back(ent);
+                    ++eIdx;
+                } else
+                    eIdx += static_cast<std::size_t>(change);
+            } else {
                 func(getEntity(sIdx, eIdx), getComponent<CTypes>(sIdx, eIdx)...);
                 ++eIdx;
             }
         }
+        if constexpr (ReturnsIterTimeChange) {
+            if (!marked.empty()) { // sweep after the spawner
+                EPP_ASSERT(destroyMarked);
+                destroyMarked(owner, marked);
+                marked.clear();
+            }
+        }
+    }
+}
+
+template <typename... CTypes>
+template <typename Func>
+void Selection<CTypes...>::forEachChunk(Func func)
+{
+    static_assert(std::is_invocable_v<Func, Entity const*, std::size_t, SelectedChunk_t<CTypes>...>);
+    for (std::size_t sIdx = 0; sIdx < entityPools.size(); ++sIdx) {
+        std::size_t n = entityPools[sIdx]->data.size();
+        if (n == 0)
+            continue;
+        (markChanged<CTypes>(sIdx, 0, n), ...);
+        func(entityPools[sIdx]->data.data(), n, getChunk<CTypes>(sIdx)...);
+    }
+}
+
+template <typename... CTypes>
+template <typename T, typename AccumulateFn, typename CombineFn>
+T Selection<CTypes...>::reduce(T identity, AccumulateFn accumulate, CombineFn combine, std::size_t threadsNum, ThreadPool& pool)
+{
+    static_assert(std::is_invocable_v<AccumulateFn, T&, Entity, SelectedArg_t<CTypes>...>);
+    static_assert(std::is_invocable_r_v<T, CombineFn, T, T>);
+
+    struct Chunk {
+        std::size_t sIdx, first, last;
+    };
+    struct alignas(64) Partial { // one cache line each, so the threads do not share them
+        T value;
+    };
+    std::vector<Chunk> chunks;
+    for (std::size_t sIdx = 0; sIdx < entityPools.size(); ++sIdx) {
+        std::size_t n = entityPools[sIdx]->data.size();
+        (markChanged<CTypes>(sIdx, 0, n), ...); // before the threads start, DirtyBlocks are not synchronized
+        for (std::size_t first = 0; first < n; first += ReduceChunkSize)
+            chunks.push_back({ sIdx, first, std::min(first + ReduceChunkSize, n) });
+    }
+    std::vector<Partial> partials(chunks.size(), Partial{ identity });
+
+    std::atomic<std::size_t> nextChunk{ 0 };
+    auto work = [&]() {
+        try {
+            for (std::size_t c; (c = nextChunk++) < chunks.size();)
+                partials[c].value = accumulateChunk(identity, chunks[c].sIdx, chunks[c].first, chunks[c].last, accumulate);
+        } catch (...) {
+            nextChunk = chunks.size(); // stop the other threads, the pool rethrows the exception
+            throw;
+        }
+    };
+    if (threadsNum == 0)
+        threadsNum = pool.size();
+    if (chunks.size())
+        pool.run(work, std::min(threadsNum, chunks.size()));
+
+    for (auto& partial : partials) // in the order of the chunks - deterministic
+        identity = combine(std::move(identity), std::move(partial.value));
+    return identity;
+}
+
+template <typename... CTypes>
+template <typename T, typename MapFn, typename CombineFn>
+T Selection<CTypes...>::transformReduce(T identity, MapFn map, CombineFn combine, std::size_t threadsNum, ThreadPool& pool)
+{
+    static_assert(std::is_invocable_r_v<T, MapFn, Entity, SelectedArg_t<CTypes>...>);
+    return reduce(
+        std::move(identity), [&map, &combine](T& acc, Entity ent, SelectedArg_t<CTypes>... comps) { acc = combine(std::move(acc), map(ent, comps...)); },
+        combine, threadsNum, pool);
+}
+
+template <typename... CTypes>
+template <typename T, typename AccumulateFn>
+inline T Selection<CTypes...>::accumulateChunk(T acc, std::size_t sIdx, std::size_t first, std::size_t last, AccumulateFn& accumulate)
+{
+    for (std::size_t eIdx = first; eIdx < last; ++eIdx) {
+        if constexpr (HasSparse) {
+            if (!(hasSparse<CTypes>(getEntity(sIdx, eIdx)) && ...))
+                continue;
+        }
+        accumulate(acc, getEntity(sIdx, eIdx), getComponent<CTypes>(sIdx, eIdx)...);
+    }
+    return acc;
+}
+
+template <typename... CTypes>
+inline typename Selection<CTypes...>::Iterator Selection<CTypes...>::begin()
+{
+    static_assert(!HasSparse, "Entities with sparse components cannot be iterated with iterators");
+    for (std::size_t sIdx = 0; sIdx < entityPools.size(); ++sIdx)
+        (markChanged<CTypes>(sIdx, 0, sizeOf(sIdx)), ...);
+    return Iterator(this, nextNonEmpty(0), 0);
+}
+
+template <typename... CTypes>
+inline typename Selection<CTypes...>::Iterator Selection<CTypes...>::end()
+{
+    return Iterator(this, entityPools.size(), 0);
+}
+
+template <typename... CTypes>
+template <typename Func>
+void Selection<CTypes...>::forEachSegment(Func func)
+{
+    static_assert(!HasSparse, "Entities with sparse components cannot be iterated with iterators");
+    static_assert(std::is_invocable_v<Func, Iterator, Iterator>);
+    for (std::size_t sIdx = nextNonEmpty(0); sIdx < entityPools.size();) {
+        std::size_t next = nextNonEmpty(sIdx + 1);
+        (markChanged<CTypes>(sIdx, 0, sizeOf(sIdx)), ...);
+        func(Iterator(this, sIdx, 0), Iterator(this, next, 0));
+        sIdx = next;
+    }
+}
+
+template <typename... CTypes>
+inline std::size_t Selection<CTypes...>::nextNonEmpty(std::size_t sIdx) const
+{
+    while (sIdx < entityPools.size() && sizeOf(sIdx) == 0)
+        ++sIdx;
+    return sIdx;
+}
+
+template <typename... CTypes>
+inline std::size_t Selection<CTypes...>::prevNonEmpty(std::size_t sIdx) const
+{
+    EPP_ASSERT(sIdx > 0);
+    while (sizeOf(--sIdx) == 0) {
+        EPP_ASSERT(sIdx > 0);
+    }
+    return sIdx;
+}
+
+template <typename... CTypes>
+inline typename Selection<CTypes...>::Iterator& Selection<CTypes...>::Iterator::operator+=(difference_type n)
+{
+    if (n >= 0) {
+        for (auto left = std::size_t(n); left > 0;) {
+            EPP_ASSERT(sIdx < sel->entityPools.size());
+            std::size_t rest = size - eIdx; // to the next spawner
+            if (left < rest) {
+                eIdx += left;
+                break;
+            }
+            left -= rest;
+            eIdx = 0;
+            enter(sel->nextNonEmpty(sIdx + 1));
+        }
+    }
+    else {
+        for (auto left = std::size_t(-n); left > 0;) {
+            if (left <= eIdx) {
+                eIdx -= left;
+                break;
+            }
+            left -= eIdx + 1; // to the last entity of the previous spawner
+            enter(sel->prevNonEmpty(sIdx));
+            eIdx = size - 1;
+        }
+    }
+    return *this;
+}
+
+template <typename... CTypes>
+inline typename Selection<CTypes...>::Iterator::difference_type Selection<CTypes...>::Iterator::operator-(Iterator const& rhs) const
+{
+    if (*this < rhs)
+        return -(rhs - *this);
+    if (sIdx == rhs.sIdx)
+        return difference_type(eIdx - rhs.eIdx);
+    std::size_t dist = sel->sizeOf(rhs.sIdx) - rhs.eIdx + eIdx;
+    for (std::size_t i = rhs.sIdx + 1; i < sIdx; ++i)
+        dist += sel->sizeOf(i);
+    return difference_type(dist);
+}
+
+template <typename... CTypes>
+inline SparseSetBase const* Selection<CTypes...>::smallestSparse()
+{
+    SparseSetBase const* smallest = nullptr;
+    (considerSparse<CTypes>(smallest), ...);
+    return smallest;
+}
+
+template <typename... CTypes>
+template <typename Func>
+inline void Selection<CTypes...>::forEachSparse(SparseSetBase const& driver, Func& func)
+{
+    EPP_ASSERT(entList);
+    for (std::size_t i = driver.size(); i-- > 0;) { // backwards, so the current entity can remove its sparse components
+        if (i >= driver.size())
+            continue;
+        Entity ent = driver.getEntities()[i];
+        if (!entList->isValid(ent))
+            continue;
+        auto cell = entList->get(ent);
+        std::size_t sIdx = cell.spawnerId.value < acceptedIdxs.size() ? acceptedIdxs[cell.spawnerId.value] : BadIdx;
+        if (sIdx == BadIdx || !(hasSparse<CTypes>(ent) && ...))
+            continue;
+        std::size_t eIdx = cell.poolIdx.value;
+        (markChanged<CTypes>(sIdx, eIdx, eIdx + 1), ...);
+        func(ent, getComponent<CTypes>(sIdx, eIdx)...);
+    }
 }
 
 template <typename... CTypes>
@@ -162,11 +824,14 @@ Selection<CTypes...>::countEntities() const
 template <typename... CTypes>
 inline void Selection<CTypes...>::addSpawnerIfMeetsRequirements(EntitySpawner& spawner)
 {
+    if (acceptedIdxs.size() <= spawner.spawnerId.value)
+        acceptedIdxs.resize(std::size_t(spawner.spawnerId.value) + 1, BadIdx);
     if (spawner.mask.contains(wantedMask) && !spawner.mask.hasCommon(unwantedMask)) {
+        acceptedIdxs[spawner.spawnerId.value] = entityPools.size();
         entityPools.push_back(&spawner.getEntities());
         spawnerIds.push_back(spawner.spawnerId);
         if constexpr (sizeof...(CTypes) > 0)
-            (this->poolsPack.template get<typename Base_t::template PoolsPtrs_t<CTypes>>().push_back(&spawner.getPool(IdOf<std::remove_const_t<CTypes>>())), ...);
+            (addPool<CTypes>(spawner), ...);
     }
 }
 
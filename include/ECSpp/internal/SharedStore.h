@@ -0,0 +1,149 @@
+#ifndef EPP_SHAREDSTORE_H
+#define EPP_SHAREDSTORE_H
+
+#include <ECSpp/internal/utility/Assert.h>
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace epp {
+
+/// A component that refers to a value of type T shared by a group of entities (see EntityManager::makeShared)
+/**
+ * Entities store only the handle, so a large value (e.g. a material) is stored once for the whole group.
+ * Handles are trivially copyable and can be compared, so entities can be grouped by their values with
+ * EntityManager::sortSpawner. Shared<T> has to be registered like any other component
+ * @tparam T Type of the shared value
+ */
+template <typename T>
+struct Shared {
+    using Value_t = T;
+
+    constexpr static std::uint32_t const BadIdx = std::uint32_t(-1);
+
+    bool operator==(Shared const& rhs) const { return idx == rhs.idx; }
+    bool operator!=(Shared const& rhs) const { return idx != rhs.idx; }
+    bool operator<(Shared const& rhs) const { return idx < rhs.idx; }
+
+    std::uint32_t idx = BadIdx; // index of the value in the SharedStore
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+template <typename T>
+struct IsShared : std::false_type {
+};
+
+template <typename T>
+struct IsShared<Shared<T>> : std::true_type {
+};
+
+template <typename T>
+inline constexpr bool IsShared_v = IsShared<std::remove_const_t<T>>::value;
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/// A type-erased interface of SharedStore, used by EntityManager to own the stores of different types
+class SharedStoreBase {
+public:
+    /// Virtual destructor
+    virtual ~SharedStoreBase() = default;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+/// Values of type T shared by groups of entities, addressed by Shared<T> handles
+/**
+ * Values are stored in a deque, so making new values does not move the existing ones (references to them stay valid).
+ * A handle stays valid until its value is released, the slot of a released value is reused by the next make call
+ * @tparam T Type of the shared values
+ */
+template <typename T>
+class SharedStore final : public SharedStoreBase {
+public:
+    /// Constructs a new value
+    /**
+     * @tparam Args Types of arguments that will be forwarded to the constructor
+     * @param args Arguments forwarded to the constructor of T
+     * @returns A handle of the new value
+     */
+    template <typename... Args>
+    Shared<T> make(Args&&... args);
+
+
+    /// Destroys the value referred to by a given handle, its slot is reused by the next make call
+    /**
+     * @param handle A handle returned from the make function
+     * @throws (Debug only) Throws the AssertionFailed exception if handle does not refer to a value
+     */
+    void release(Shared<T> handle);
+
+
+    /// Returns the value referred to by a given handle
+    /**
+     * @param handle A handle returned from the make function
+     * @returns A reference to the value
+     * @throws (Debug only) Throws the AssertionFailed exception if handle was not returned from the make function
+     */
+    T& get(Shared<T> handle)
+    {
+        EPP_ASSERT(contains(handle));
+        return *values[handle.idx];
+    }
+
+
+    /** @copydoc SharedStore::get(Shared<T> handle) */
+    T const& get(Shared<T> handle) const
+    {
+        EPP_ASSERT(contains(handle));
+        return *values[handle.idx];
+    }
+
+
+    /** @returns True if handle refers to a value that was not released */
+    bool contains(Shared<T> handle) const { return handle.idx < values.size() && values[handle.idx].has_value(); }
+
+
+    /** @returns The number of values that were not released */
+    std::size_t size() const { return values.size() - freeIdxs.size(); }
+
+private:
+    std::deque<std::optional<T>> values;
+
+    std::vector<std::uint32_t> freeIdxs; // slots of the released values
+};
+
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+template <typename T>
+template <typename... Args>
+inline Shared<T> SharedStore<T>::make(Args&&... args)
+{
+    if (!freeIdxs.empty()) {
+        values[freeIdxs.back()].emplace(std::forward<Args>(args)...);
+        Shared<T> handle{ freeIdxs.back() };
+        freeIdxs.pop_back();
+        return handle;
+    }
+    EPP_ASSERTA(values.size() < Shared<T>::BadIdx);
+    values.emplace_back(std::in_place, std::forward<Args>(args)...);
+    return Shared<T>{ std::uint32_t(values.size() - 1) };
+}
+
+template <typename T>
+inline void SharedStore<T>::release(Shared<T> handle)
+{
+    EPP_ASSERT(contains(handle));
+    values[handle.idx].reset();
+    freeIdxs.push_back(handle.idx);
+}
+
+} // namespace epp
+
+#endif // EPP_SHAREDSTORE_H
\ No newline at end of file
@@ -0,0 +1,239 @@
+#ifndef EPP_SOA_H
+#define EPP_SOA_H
+
+#include <ECSpp/Component.h>
+#include <array>
+#include <cstddef>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace epp {
+
+/// Field description of a component type stored as a structure of arrays - specialize it with the pointers to the fields:
+/**
+ * template <> struct SoALayout<Position> { static constexpr auto Fields = std::make_tuple(&Position::x, &Position::y, &Position::z); };
+ * Every field is stored as a separate component SoAField<T, I> (one CPool, so one aligned array per field),
+ * so entities with T have the components listed by IdOfFields<T>() instead of T itself. The fields are moved, saved
+ * and tracked like any other components and have to be registered like any other components.
+ * Selections that list SoA<T> pass a SoARef<T> (a proxy of the fields of one entity) to forEach
+ * and a SoAChunk<T> (the arrays of the fields) to forEachChunk
+ */
+template <typename T>
+struct SoALayout {
+};
+
+template <typename T, typename = void>
+struct HasSoALayout : std::false_type {
+};
+
+template <typename T>
+struct HasSoALayout<T, std::void_t<decltype(SoALayout<T>::Fields)>> : std::true_type {
+};
+
+
+/// Number of the fields of T
+template <typename T>
+inline constexpr std::size_t FieldCount_v = std::tuple_size_v<std::remove_const_t<decltype(SoALayout<std::remove_const_t<T>>::Fields)>>;
+
+
+template <typename M>
+struct MemberType;
+
+template <typename C, typename M>
+struct MemberType<M C::*> {
+    using type = M;
+};
+
+/// Type of the I-th field of T
+template <typename T, std::size_t I>
+using FieldType_t = typename MemberType<std::tuple_element_t<I, std::remove_const_t<decltype(SoALayout<T>::Fields)>>>::type;
+
+
+/// A component that stores the I-th field of T, an array of SoAField<T, I> is an array of the fields
+template <typename T, std::size_t I>
+struct SoAField {
+    using Value_t = FieldType_t<T, I>;
+
+    Value_t value{};
+};
+
+
+/// A tag used to select the fields of T (see SoALayout)
+template <typename T>
+struct SoA {
+    static_assert(HasSoALayout<T>::value, "SoALayout<T> is not specialized");
+    using Value_t = T;
+};
+
+template <typename T>
+struct IsSoA : std::false_type {
+};
+
+template <typename T>
+struct IsSoA<SoA<T>> : std::true_type {
+};
+
+template <typename T>
+inline constexpr bool IsSoA_v = IsSoA<std::remove_const_t<T>>::value;
+
+
+/// Returns the ComponentIds of the fields of T
+/**
+ * @tparam T A type with a SoALayout
+ * @returns ComponentIds of SoAField<T, 0>, SoAField<T, 1>, ...
+ */
+template <typename T>
+inline std::initializer_list<ComponentId> IdOfFields();
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+/// A proxy of the fields of one entity, stored as a structure of arrays
+/**
+ * @tparam T Type with a SoALayout, const to access the fields read-only
+ */
+template <typename T>
+class SoARef {
+    using Value_t = std::remove_const_t<T>;
+
+public:
+    constexpr static std::size_t const FieldCount = FieldCount_v<Value_t>;
+
+    template <std::size_t I>
+    using Field_t = std::conditional_t<std::is_const_v<T>, FieldType_t<Value_t, I> const, FieldType_t<Value_t, I>>;
+
+    using Arrays_t = std::array<void*, FieldCount>;
+
+public:
+    /// Constructs a proxy of the idx-th element of the arrays
+    /**
+     * @param fieldArrays Addresses of the arrays of the fields (CPools of SoAField<T, I>)
+     * @param idx Index of the element
+     */
+    SoARef(Arrays_t const& fieldArrays, std::size_t idx) : SoARef(fieldArrays, idx, std::make_index_sequence<FieldCount>()) {}
+
+
+    /** @returns The I-th field */
+    template <std::size_t I>
+    Field_t<I>& get() const { return *static_cast<Field_t<I>*>(fields[I]); }
+
+
+    /** @returns The field pointed to by Member (one of SoALayout<T>::Fields) */
+    template <auto Member, typename = std::enable_if_t<std::is_member_object_pointer_v<decltype(Member)>>>
+    auto& get() const { return get<IndexOf<Member>()>(); }
+
+
+    /** @returns A copy of the fields assembled into T */
+    Value_t load() const
+    {
+        Value_t value{};
+        loadInto(value, std::make_index_sequence<FieldCount>());
+        return value;
+    }
+
+
+    /// Assigns the fields of a given value
+    /**
+     * @param value Any value
+     */
+    void store(Value_t const& value) const
+    {
+        static_assert(!std::is_const_v<T>, "Fields are read-only");
+        storeFrom(value, std::make_index_sequence<FieldCount>());
+    }
+
+
+    /// Returns the index of the field pointed to by Member
+    template <auto Member, std::size_t I = 0>
+    static constexpr std::size_t IndexOf()
+    {
+        static_assert(I < FieldCount, "Member is not a field of SoALayout<T>");
+        constexpr auto field = std::get<I>(SoALayout<Value_t>::Fields);
+        if constexpr (std::is_same_v<std::remove_const_t<decltype(field)>, decltype(Member)>) {
+            if constexpr (field == Member)
+                return I;
+            else
+                return IndexOf<Member, I + 1>();
+        } else
+            return IndexOf<Member, I + 1>();
+    }
+
+private:
+    template <std::size_t... Is>
+    SoARef(Arrays_t const& fieldArrays, std::size_t idx, std::index_sequence<Is...>)
+        : fields{ static_cast<void*>(static_cast<FieldType_t<Value_t, Is>*>(fieldArrays[Is]) + idx)... }
+    {}
+
+    template <std::size_t... Is>
+    void loadInto(Value_t& value, std::index_sequence<Is...>) const { ((value.*std::get<Is>(SoALayout<Value_t>::Fields) = get<Is>()), ...); }
+
+    template <std::size_t... Is>
+    void storeFrom(Value_t const& value, std::index_sequence<Is...>) const { ((get<Is>() = value.*std::get<Is>(SoALayout<Value_t>::Fields)), ...); }
+
+private:
+    Arrays_t fields;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+/// The arrays of the fields of a contiguous range of entities (the entities of one spawner)
+/**
+ * @tparam T Type with a SoALayout, const to access the fields read-only
+ */
+template <typename T>
+class SoAChunk {
+    using Ref_t = SoARef<T>;
+
+public:
+    /// Constructs a chunk of n elements
+    /**
+     * @param fieldArrays Addresses of the arrays of the fields
+     * @param n Number of elements
+     */
+    SoAChunk(typename Ref_t::Arrays_t const& fieldArrays, std::size_t n) : arrays(fieldArrays), n(n) {}
+
+
+    /** @returns The array of the I-th field */
+    template <std::size_t I>
+    typename Ref_t::template Field_t<I>* field() const { return static_cast<typename Ref_t::template Field_t<I>*>(arrays[I]); }
+
+
+    /** @returns The array of the field pointed to by Member (one of SoALayout<T>::Fields) */
+    template <auto Member, typename = std::enable_if_t<std::is_member_object_pointer_v<decltype(Member)>>>
+    auto* field() const { return field<Ref_t::template IndexOf<Member>()>(); }
+
+
+    /** @returns A proxy of the fields of the idx-th element */
+    Ref_t operator[](std::size_t idx) const { return Ref_t(arrays, idx); }
+
+
+    /** @returns The number of elements */
+    std::size_t size() const { return n; }
+
+private:
+    typename Ref_t::Arrays_t arrays;
+    std::size_t n;
+};
+
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+template <typename T, std::size_t... Is>
+inline std::initializer_list<ComponentId> IdOfFields(std::index_sequence<Is...>)
+{
+    return IdOfL<SoAField<T, Is>...>();
+}
+
+template <typename T>
+inline std::initializer_list<ComponentId> IdOfFields()
+{
+    static_assert(HasSoALayout<T>::value, "SoALayout<T> is not specialized");
+    return IdOfFields<T>(std::make_index_sequence<FieldCount_v<T>>());
+}
+
+} // namespace epp
+
+#endif // EPP_SOA_H
\ No newline at end of file
@@ -0,0 +1,239 @@
+#ifndef EPP_SPARSESET_H
+#define EPP_SPARSESET_H
+
+#include <ECSpp/internal/EntityList.h>
+#include <atomic>
+#include <memory_resource>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace epp {
+
+/// Storage policy of a component type - specialize it as std::true_type to store the components of CType in a SparseSet
+/**
+ * Sparse components are not a part of archetypes, so adding and removing them (see EntityManager::addSparse) does not
+ * move the entity between spawners. Meant for components that are added and removed often (e.g. stun, burning).
+ * They do not have to be registered in CMetadata
+ */
+template <typename CType>
+struct SparseStorage : std::false_type {
+};
+
+template <typename CType>
+inline constexpr bool IsSparse_v = SparseStorage<std::remove_const_t<CType>>::value;
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+/// A type-erased interface of SparseSet used by EntityManager to remove the components of destroyed entities
+class SparseSetBase {
+public:
+    /// Returns a unique id of a given component type, assigned on the first call
+    /**
+     * @tparam CType Any type
+     * @returns The id of CType (not related to ComponentId)
+     */
+    template <typename CType>
+    static std::size_t IdOf()
+    {
+        static std::size_t id = NextId()++;
+        return id;
+    }
+
+
+    /// Constructs an empty set
+    /**
+     * @param resource The resource used to allocate the arrays
+     */
+    explicit SparseSetBase(std::pmr::memory_resource* resource) : sparse(resource), dense(resource) {}
+
+
+    /// Virtual destructor
+    virtual ~SparseSetBase() = default;
+
+
+    /// Removes the component of a given entity (no-op if it does not have one)
+    /**
+     * @param ent Any entity
+     */
+    virtual void erase(Entity ent) = 0;
+
+
+    /// Removes the components of the entities that are not valid anymore
+    /**
+     * @param entList List of entities used to check the validity
+     */
+    virtual void eraseInvalid(EntityList const& entList) = 0;
+
+
+    /// Removes every component
+    virtual void clear() = 0;
+
+
+    /** @returns The entities that own a component, in the order of the components */
+    std::pmr::vector<Entity> const& getEntities() const { return dense; }
+
+
+    /** @returns The number of components */
+    std::size_t size() const { return dense.size(); }
+
+protected:
+    constexpr static std::uint32_t const BadIdx = std::uint32_t(-1);
+
+    /// Returns the index of the component of a given entity
+    std::uint32_t indexOf(Entity ent) const
+    {
+        if (ent.listIdx.value >= sparse.size())
+            return BadIdx;
+        std::uint32_t idx = sparse[ent.listIdx.value];
+        return idx != BadIdx && dense[idx] == ent ? idx : BadIdx;
+    }
+
+private:
+    static std::atomic<std::size_t>& NextId()
+    {
+        static std::atomic<std::size_t> nextId{ 0 };
+        return nextId;
+    }
+
+protected:
+    std::pmr::vector<std::uint32_t> sparse; // index of the component by ListIdx, BadIdx if none
+
+    std::pmr::vector<Entity> dense;         // owner of each component
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+/// Components of type CType stored densely and addressed by the ListIdxs of their entities
+/**
+ * Adding and removing a component costs O(1) and does not touch any other data of the entity.
+ * Components are removed with swap-remove, like in CPools
+ * @tparam CType Type of the stored components
+ */
+template <typename CType>
+class SparseSet final : public SparseSetBase {
+public:
+    /// Constructs an empty set
+    /**
+     * @param resource The resource used to allocate the components and the arrays
+     */
+    explicit SparseSet(std::pmr::memory_resource* resource = std::pmr::get_default_resource()) : SparseSetBase(resource), values(resource) {}
+
+
+    /// Constructs a component of a given entity, replacing the current one
+    /**
+     * @tparam Args Types of arguments that will be forwarded to the constructor
+     * @param ent A valid entity
+     * @param args Arguments forwarded to the constructor of CType
+     * @returns A reference to the new component
+     */
+    template <typename... Args>
+    CType& emplace(Entity ent, Args&&... args);
+
+
+    /// Returns the component of a given entity
+    /**
+     * @param ent Any entity
+     * @returns A pointer to the component or nullptr if ent does not have one
+     */
+    CType* find(Entity ent)
+    {
+        auto idx = indexOf(ent);
+        return idx != BadIdx ? &values[idx] : nullptr;
+    }
+
+
+    /** @copydoc SparseSet::find(Entity ent) */
+    CType const* find(Entity ent) const { return const_cast<SparseSet*>(this)->find(ent); }
+
+
+    /// Returns the component at a given index
+    /**
+     * @param idx Index of the component, lower than size()
+     * @returns The component owned by getEntities()[idx]
+     */
+    CType& operator[](std::size_t idx) { return values[idx]; }
+
+
+    /** @copydoc SparseSetBase::erase */
+    void erase(Entity ent) override;
+
+
+    /** @copydoc SparseSetBase::eraseInvalid */
+    void eraseInvalid(EntityList const& entList) override;
+
+
+    /** @copydoc SparseSetBase::clear */
+    void clear() override;
+
+private:
+    void eraseAt(std::uint32_t idx);
+
+private:
+    std::pmr::vector<CType> values;
+};
+
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+template <typename CType>
+template <typename... Args>
+inline CType& SparseSet<CType>::emplace(Entity ent, Args&&... args)
+{
+    if (auto idx = indexOf(ent); idx != BadIdx) {
+        values[idx] = CType(std::forward<Args>(args)...);
+        return values[idx];
+    }
+    if (sparse.size() <= ent.listIdx.value)
+        sparse.resize(std::size_t(ent.listIdx.value) + 1, BadIdx);
+    values.emplace_back(std::forward<Args>(args)...);
+    sparse[ent.listIdx.value] = std::uint32_t(dense.size());
+    dense.push_back(ent);
+    return values.back();
+}
+
+template <typename CType>
+inline void SparseSet<CType>::erase(Entity ent)
+{
+    if (auto idx = indexOf(ent); idx != BadIdx)
+        eraseAt(idx);
+}
+
+template <typename CType>
+inline void SparseSet<CType>::eraseInvalid(EntityList const& entList)
+{
+    for (std::size_t i = dense.size(); i-- > 0;)
+        if (!entList.isValid(dense[i]))
+            eraseAt(std::uint32_t(i));
+}
+
+template <typename CType>
+inline void SparseSet<CType>::clear()
+{
+    sparse.clear();
+    dense.clear();
+    values.clear();
+}
+
+template <typename CType>
+inline void SparseSet<CType>::eraseAt(std::uint32_t idx)
+{
+    auto last = std::uint32_t(dense.size() - 1);
+    if (sparse[dense[idx].listIdx.value] == idx) // a stale entity could have been replaced by a new one with the same ListIdx
+        sparse[dense[idx].listIdx.value] = BadIdx;
+    if (idx != last) {
+        dense[idx] = dense[last];
+        values[idx] = std::move(values[last]);
+        if (sparse[dense[idx].listIdx.value] == last)
+            sparse[dense[idx].listIdx.value] = idx;
+    }
+    dense.pop_back();
+    values.pop_back();
+}
+
+} // namespace epp
+
+#endif // EPP_SPARSESET_H
\ No newline at end of file
@@ -0,0 +1,49 @@
+#ifndef EPP_WORLDFRAME_H
+#define EPP_WORLDFRAME_H
+
+#include <ECSpp/internal/EntityList.h>
+#include <ECSpp/internal/EntitySpawner.h>
+#include <ECSpp/internal/Resources.h>
+#include <atomic>
+
+namespace epp {
+
+/// An in-memory copy of the whole state of an EntityManager (see EntityManager::snapshotInto and EntityManager::restoreFrom)
+/**
+ * Frames are meant to be reused (e.g. in a ring buffer of the last N simulation steps) - every snapshotInto call
+ * reuses the memory allocated by the previous ones. When the EntityManager tracks changes, each frame also stores
+ * the blocks modified between the previous frame and itself, so restoring a recent frame copies only the blocks that differ
+ */
+class WorldFrame {
+public:
+    /** @returns True if the frame does not contain any copy yet */
+    bool isEmpty() const { return id == 0; }
+
+
+    /** @returns The number of alive entities in the copy */
+    std::size_t size() const { return entList.size(); }
+
+private:
+    static std::uint64_t NextId()
+    {
+        static std::atomic<std::uint64_t> nextId{ 1 };
+        return nextId++;
+    }
+
+private:
+    EntityList entList;
+
+    std::vector<EntitySpawner::Frame> spawners;
+
+    Resources::Frame resources;
+
+    std::uint64_t id = 0;         // unique for every copy, 0 if empty
+
+    std::uint64_t previousId = 0; // id of the frame that was the baseline of the stored changes, 0 if changes were not tracked
+
+    friend class EntityManager;
+};
+
+} // namespace epp
+
+#endif // EPP_WORLDFRAME_H
\ No newline at end of file
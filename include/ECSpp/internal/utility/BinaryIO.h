@@ -0,0 +1,129 @@
+#ifndef EPP_BINARYIO_H
+#define EPP_BINARYIO_H
+
+#include <ECSpp/internal/utility/Assert.h>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <streambuf>
+#include <type_traits>
+
+namespace epp {
+
+/// Writes n bytes to a binary stream
+/**
+ * @param os Binary output stream
+ * @param src Address of the first byte to write
+ * @param n Number of bytes to write
+ * @throws Throws the AssertionFailed exception (in debug and release) if writing failed
+ */
+inline void WriteBytes(std::ostream& os, void const* src, std::size_t n)
+{
+    if (n)
+        os.write(static_cast<char const*>(src), std::streamsize(n));
+    EPP_ASSERTA_M(os.good(), "Could not write to the stream");
+}
+
+
+/// Reads n bytes from a binary stream
+/**
+ * @param is Binary input stream
+ * @param dest Address of the memory to read the bytes into
+ * @param n Number of bytes to read
+ * @throws Throws the AssertionFailed exception (in debug and release) if there were less than n bytes to read
+ */
+inline void ReadBytes(std::istream& is, void* dest, std::size_t n)
+{
+    if (n)
+        is.read(static_cast<char*>(dest), std::streamsize(n));
+    EPP_ASSERTA_M(is.good(), "Unexpected end of the stream");
+}
+
+
+/// Writes the object representation of a trivially copyable value
+template <typename T>
+inline void WriteValue(std::ostream& os, T const& value)
+{
+    static_assert(std::is_trivially_copyable_v<T>);
+    WriteBytes(os, &value, sizeof(T));
+}
+
+
+/// Reads the object representation of a trivially copyable value
+template <typename T>
+inline T ReadValue(std::istream& is)
+{
+    static_assert(std::is_trivially_copyable_v<T>);
+    T value;
+    ReadBytes(is, &value, sizeof(T));
+    return value;
+}
+
+/// Writes zeroed bytes, so the next byte written to a seekable stream is aligned to a given value
+/**
+ * The number of the padding bytes is written first, so the stream can be read also when its position is unknown
+ * @param os Binary output stream
+ * @param alignment Any power of 2
+ */
+inline void WritePadding(std::ostream& os, std::size_t alignment)
+{
+    auto pos = os.tellp();
+    std::uint32_t padding = 0;
+    if (pos != std::ostream::pos_type(-1))
+        padding = std::uint32_t((alignment - (std::size_t(pos) + sizeof(padding)) % alignment) % alignment);
+    WriteValue(os, padding);
+    for (; padding > 0; --padding)
+        os.put(0);
+    EPP_ASSERTA_M(os.good(), "Could not write to the stream");
+}
+
+
+/// Skips the padding bytes written by the WritePadding function
+/**
+ * @param is Binary input stream
+ */
+inline void SkipPadding(std::istream& is)
+{
+    is.ignore(ReadValue<std::uint32_t>(is));
+    EPP_ASSERTA_M(is.good(), "Unexpected end of the stream");
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/// A read-only stream buffer over a contiguous block of memory
+/**
+ * Used with std::istream to parse the data that is already in memory (e.g. a mapped file), without copying it.
+ * Supports tellg and seekg, so the readers can find the address of the data at the current position (begin() + tellg())
+ */
+class MemoryBuf : public std::streambuf {
+public:
+    MemoryBuf(void* mem, std::size_t n)
+    {
+        char* begin = static_cast<char*>(mem);
+        setg(begin, begin, begin + n);
+    }
+
+    /** @returns The address of the first byte of the buffer */
+    char* begin() const { return eback(); }
+
+protected:
+    pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) override
+    {
+        if (!(which & std::ios_base::in))
+            return pos_type(off_type(-1));
+        char* base = dir == std::ios_base::beg ? eback() : (dir == std::ios_base::cur ? gptr() : egptr());
+        if (off < eback() - base || off > egptr() - base)
+            return pos_type(off_type(-1));
+        setg(eback(), base + off, egptr());
+        return pos_type(gptr() - eback());
+    }
+
+    pos_type seekpos(pos_type pos, std::ios_base::openmode which) override
+    {
+        return seekoff(off_type(pos), std::ios_base::beg, which);
+    }
+};
+
+} // namespace epp
+
+#endif // EPP_BINARYIO_H
\ No newline at end of file
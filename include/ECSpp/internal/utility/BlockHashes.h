@@ -0,0 +1,70 @@
+#ifndef EPP_BLOCKHASHES_H
+#define EPP_BLOCKHASHES_H
+
+#include <ECSpp/internal/utility/DirtyBlocks.h>
+#include <ECSpp/internal/utility/Hash.h>
+#include <memory_resource>
+#include <vector>
+
+namespace epp {
+
+/// Cached hashes of the blocks of a contiguous array, used to compute its checksum incrementally
+/**
+ * Only the blocks marked as unhashed in the DirtyBlocks of the array (and the last, possibly partial, block) are rehashed.
+ * When the tracking is disabled, every block is rehashed
+ */
+class BlockHashes {
+public:
+    /// Constructs an empty cache that allocates from the default resource
+    BlockHashes() = default;
+
+
+    /// Constructs an empty cache that allocates from a given resource
+    /**
+     * @param resource The resource used to allocate the hashes
+     */
+    explicit BlockHashes(std::pmr::memory_resource* resource) : hashes(resource) {}
+
+
+    /// Returns the hash of an array and updates the cached hashes of its blocks
+    /**
+     * @param data Address of the first element of a trivially copyable array
+     * @param elemSize Size of an element in bytes
+     * @param size Number of elements in the array
+     * @param changes Blocks modified since the last update (their unhashed marks are cleared)
+     * @returns The hash of the array
+     */
+    std::uint64_t update(void const* data, std::size_t elemSize, std::size_t size, DirtyBlocks& changes);
+
+
+    /// Forgets every cached hash (the next update rehashes every block)
+    void invalidate() { hashes.clear(); }
+
+private:
+    std::pmr::vector<std::uint64_t> hashes;
+};
+
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+inline std::uint64_t BlockHashes::update(void const* data, std::size_t elemSize, std::size_t size, DirtyBlocks& changes)
+{
+    constexpr auto BlockSize = DirtyBlocks::BlockSize;
+    auto bytes = static_cast<std::uint8_t const*>(data);
+    auto hashBlock = [&](std::size_t first, std::size_t last) { hashes[first / BlockSize] = HashBytes(bytes + first * elemSize, (last - first) * elemSize); };
+
+    if (!changes.isEnabled())
+        hashes.clear();
+    std::size_t cached = std::min(hashes.size(), size / BlockSize); // the last block could have shrunk without being marked
+    hashes.resize((size + BlockSize - 1) / BlockSize);
+    changes.forEachUnhashed(cached * BlockSize, hashBlock);
+    for (std::size_t b = cached; b < hashes.size(); ++b)
+        hashBlock(b * BlockSize, std::min((b + 1) * BlockSize, size));
+    changes.clearUnhashed();
+    return HashBytes(hashes.data(), hashes.size() * sizeof(std::uint64_t), std::uint64_t(size));
+}
+
+} // namespace epp
+
+#endif // EPP_BLOCKHASHES_H
\ No newline at end of file
@@ -0,0 +1,78 @@
+#ifndef EPP_COUNTINGRESOURCE_H
+#define EPP_COUNTINGRESOURCE_H
+
+#include <cstddef>
+#include <memory_resource>
+
+namespace epp {
+
+/// A memory resource that forwards every request to an upstream resource and counts them
+/**
+ * Meant for tests and benchmarks, e.g. to show that a loop does not allocate from the resource of an EntityManager in a steady state.
+ * The structures that use the default allocator are not counted (see the EntityManager constructor).
+ * Counters are not atomic, like the EntityManager that uses the resource
+ */
+class CountingResource final : public std::pmr::memory_resource {
+public:
+    /// Constructs a resource that forwards to a given upstream resource
+    /**
+     * @param upstreamResource The resource that performs the allocations
+     */
+    explicit CountingResource(std::pmr::memory_resource* upstreamResource = std::pmr::get_default_resource())
+        : upstream(upstreamResource) {}
+
+
+    /** @returns The number of allocations since the construction or the last resetCounts call */
+    std::size_t allocations() const { return nAllocations; }
+
+
+    /** @returns The number of deallocations since the construction or the last resetCounts call */
+    std::size_t deallocations() const { return nDeallocations; }
+
+
+    /** @returns The number of bytes allocated and not yet deallocated */
+    std::size_t bytesInUse() const { return nBytesInUse; }
+
+
+    /// Sets the numbers of allocations and deallocations to 0 (does not change bytesInUse)
+    void resetCounts()
+    {
+        nAllocations = 0;
+        nDeallocations = 0;
+    }
+
+
+    /** @returns The resource that performs the allocations */
+    std::pmr::memory_resource* getUpstream() const { return upstream; }
+
+private:
+    void* do_allocate(std::size_t bytes, std::size_t alignment) override
+    {
+        void* ptr = upstream->allocate(bytes, alignment);
+        ++nAllocations;
+        nBytesInUse += bytes;
+        return ptr;
+    }
+
+    void do_deallocate(void* ptr, std::size_t bytes, std::size_t alignment) override
+    {
+        upstream->deallocate(ptr, bytes, alignment);
+        ++nDeallocations;
+        nBytesInUse -= bytes;
+    }
+
+    bool do_is_equal(std::pmr::memory_resource const& other) const noexcept override { return this == &other; }
+
+private:
+    std::pmr::memory_resource* upstream;
+
+    std::size_t nAllocations = 0;
+
+    std::size_t nDeallocations = 0;
+
+    std::size_t nBytesInUse = 0;
+};
+
+} // namespace epp
+
+#endif // EPP_COUNTINGRESOURCE_H
\ No newline at end of file
@@ -0,0 +1,248 @@
+#ifndef EPP_DIRTYBLOCKS_H
+#define EPP_DIRTYBLOCKS_H
+
+#include <ECSpp/internal/utility/BinaryIO.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory_resource>
+#include <vector>
+
+namespace epp {
+
+/// A bitset of modified blocks of elements in a contiguous array, used to track changes since some baseline
+/**
+ * Every block covers BlockSize consecutive elements. Marking is a no-op while the tracking is disabled,
+ * so structures that are not tracked pay only for a single branch.
+ * Every marked block is also marked as unhashed - a separate set cleared by the checksums (see BlockHashes), 
+ * so computing a checksum does not move the baseline
+ */
+class DirtyBlocks {
+    using Word_t = std::uint64_t;
+    using Words_t = std::pmr::vector<Word_t>;
+
+public:
+    /// Number of elements in one block
+    constexpr static std::size_t const BlockSize = 64;
+
+
+    /// Constructs an empty set that allocates from the default resource
+    DirtyBlocks() = default;
+
+
+    /// Constructs an empty set that allocates from a given resource
+    /**
+     * @param resource The resource used to allocate the bitsets (copies use the default resource, like pmr containers)
+     */
+    explicit DirtyBlocks(std::pmr::memory_resource* resource) : words(resource), unhashed(resource) {}
+
+
+    /// Enables or disables the tracking, clears the marked blocks
+    /**
+     * @param enable True to enable the tracking
+     */
+    void enable(bool enable)
+    {
+        enabled = enable;
+        clear();
+        clearUnhashed();
+    }
+
+
+    /** @returns True if the tracking is enabled */
+    bool isEnabled() const { return enabled; }
+
+
+    /// Marks the block containing the element at a given index
+    /**
+     * @param idx Index of the modified element
+     */
+    void mark(std::size_t idx)
+    {
+        if (enabled)
+            markBlock(idx / BlockSize);
+    }
+
+
+    /// Marks every block containing the elements in the range [first, last)
+    /**
+     * @param first Index of the first modified element
+     * @param last Index past the last modified element
+     */
+    void mark(std::size_t first, std::size_t last)
+    {
+        if (enabled && first < last)
+            for (std::size_t b = first / BlockSize; b <= (last - 1) / BlockSize; ++b)
+                markBlock(b);
+    }
+
+
+    /// Unmarks every block (makes the current state a new baseline)
+    void clear() { std::fill(words.begin(), words.end(), Word_t(0)); }
+
+
+    /// Unmarks every unhashed block (the checksum of the current state is known)
+    void clearUnhashed() { std::fill(unhashed.begin(), unhashed.end(), Word_t(0)); }
+
+
+    /// Marks every block that is marked in other (regardless of whether the tracking is enabled)
+    /**
+     * @param other Any DirtyBlocks
+     */
+    void merge(DirtyBlocks const& other)
+    {
+        if (words.size() < other.words.size()) {
+            words.resize(other.words.size(), Word_t(0));
+            unhashed.resize(other.words.size(), Word_t(0));
+        }
+        for (std::size_t w = 0; w < other.words.size(); ++w) {
+            words[w] |= other.words[w];
+            unhashed[w] |= other.words[w];
+        }
+    }
+
+
+    /// Replaces the marked blocks with the ones marked in other, keeps the enabled state
+    /**
+     * @param other Any DirtyBlocks
+     */
+    void assign(DirtyBlocks const& other)
+    {
+        clear();
+        merge(other);
+    }
+
+
+    /// Returns whether the block with a given index is marked
+    /**
+     * @param block Index of the block (element index / BlockSize)
+     */
+    bool isMarked(std::size_t block) const
+    {
+        return block / 64 < words.size() && (words[block / 64] >> (block % 64)) & 1;
+    }
+
+
+    /// Calls fn(first, last) for every marked block, clipped to the first size elements
+    /**
+     * @tparam FnType Callable type that accepts (std::size_t first, std::size_t last)
+     * @param size Number of elements in the array
+     * @param fn Function called with a range of elements [first, last) of each marked block
+     */
+    template <typename FnType>
+    void forEachMarked(std::size_t size, FnType fn) const { ForEachSet(words, size, fn); }
+
+
+    /// Calls fn(first, last) for every block marked since the last clearUnhashed call, clipped to the first size elements
+    /**
+     * @tparam FnType Callable type that accepts (std::size_t first, std::size_t last)
+     * @param size Number of elements in the array
+     * @param fn Function called with a range of elements [first, last) of each unhashed block
+     */
+    template <typename FnType>
+    void forEachUnhashed(std::size_t size, FnType fn) const { ForEachSet(unhashed, size, fn); }
+
+
+    /// Copies the marked blocks from one array to another and marks them as unhashed in this DirtyBlocks
+    /**
+     * @param dest Address of the first element of a trivially copyable array with at least size elements
+     * @param src Address of the first element of a trivially copyable array with at least size elements
+     * @param elemSize Size of an element in bytes
+     * @param size Number of elements to consider (blocks past size are ignored)
+     */
+    void copyMarked(void* dest, void const* src, std::size_t elemSize, std::size_t size)
+    {
+        forEachMarked(size, [&](std::size_t first, std::size_t last) {
+            std::memcpy(static_cast<std::uint8_t*>(dest) + first * elemSize, static_cast<std::uint8_t const*>(src) + first * elemSize, (last - first) * elemSize);
+        });
+        for (std::size_t w = 0; w < words.size(); ++w) // the cached hashes of the copied blocks are stale
+            unhashed[w] |= words[w];
+    }
+
+
+    /// Writes the marked blocks of an array
+    /**
+     * @param os Binary output stream
+     * @param data Address of the first element of a trivially copyable array
+     * @param elemSize Size of an element in bytes
+     * @param size Number of elements in the array
+     */
+    void save(std::ostream& os, void const* data, std::size_t elemSize, std::size_t size) const;
+
+
+    /// Reads the blocks written by the save function into an array and marks them
+    /**
+     * @param is Binary input stream
+     * @param data Address of the first element of a trivially copyable array
+     * @param elemSize Size of an element in bytes
+     * @param size Number of elements in the array
+     * @throws Throws the AssertionFailed exception (in debug and release) if a block does not fit in the array or if the stream ended unexpectedly
+     */
+    void load(std::istream& is, void* data, std::size_t elemSize, std::size_t size);
+
+private:
+    void markBlock(std::size_t block)
+    {
+        if (block / 64 >= words.size()) {
+            words.resize(block / 64 + 1, Word_t(0));
+            unhashed.resize(block / 64 + 1, Word_t(0));
+        }
+        words[block / 64] |= Word_t(1) << (block % 64);
+        unhashed[block / 64] |= Word_t(1) << (block % 64);
+    }
+
+    template <typename FnType>
+    static void ForEachSet(Words_t const& bits, std::size_t size, FnType fn);
+
+private:
+    Words_t words;
+    Words_t unhashed; // always the same size as words
+    bool enabled = false;
+};
+
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+template <typename FnType>
+inline void DirtyBlocks::ForEachSet(Words_t const& bits, std::size_t size, FnType fn)
+{
+    for (std::size_t w = 0; w < bits.size(); ++w)
+        for (Word_t word = bits[w]; word;) {
+            std::size_t bit = 0;
+            while (((word >> bit) & 1) == 0)
+                ++bit;
+            word &= word - 1; // unset the lowest set bit
+            std::size_t first = (w * 64 + bit) * BlockSize;
+            if (first >= size)
+                return;
+            fn(first, std::min(first + BlockSize, size));
+        }
+}
+
+inline void DirtyBlocks::save(std::ostream& os, void const* data, std::size_t elemSize, std::size_t size) const
+{
+    std::uint64_t blocks = 0;
+    forEachMarked(size, [&blocks](std::size_t, std::size_t) { ++blocks; });
+    WriteValue(os, blocks);
+    forEachMarked(size, [&](std::size_t first, std::size_t last) {
+        WriteValue(os, std::uint64_t(first));
+        WriteValue(os, std::uint32_t(last - first));
+        WriteBytes(os, static_cast<std::uint8_t const*>(data) + first * elemSize, (last - first) * elemSize);
+    });
+}
+
+inline void DirtyBlocks::load(std::istream& is, void* data, std::size_t elemSize, std::size_t size)
+{
+    for (auto blocks = ReadValue<std::uint64_t>(is); blocks > 0; --blocks) {
+        auto first = std::size_t(ReadValue<std::uint64_t>(is));
+        auto n = std::size_t(ReadValue<std::uint32_t>(is));
+        EPP_ASSERTA_M(first <= size && n <= size - first, "Corrupted delta");
+        ReadBytes(is, static_cast<std::uint8_t*>(data) + first * elemSize, n * elemSize);
+        mark(first, first + n);
+    }
+}
+
+} // namespace epp
+
+#endif // EPP_DIRTYBLOCKS_H
\ No newline at end of file
@@ -0,0 +1,86 @@
+#ifndef EPP_HASH_H
+#define EPP_HASH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace epp {
+
+/// 64-bit FNV-1a hash of a null-terminated string
+/**
+ * Used to identify types (by their names) in serialized data
+ * @param str Any null-terminated string
+ * @param hash The initial value of the hash (can be used to combine hashes)
+ * @returns The hash of str
+ */
+inline std::uint64_t HashString(char const* str, std::uint64_t hash = 14695981039346656037ull)
+{
+    for (; *str; ++str)
+        hash = (hash ^ std::uint8_t(*str)) * 1099511628211ull;
+    return hash;
+}
+
+
+/// Mixes a value into a hash
+/**
+ * @param hash The current hash
+ * @param value Any value
+ * @returns The combined hash (depends on the order of combined values)
+ */
+inline std::uint64_t HashCombine(std::uint64_t hash, std::uint64_t value)
+{
+    value *= 0x9E3779B97F4A7C15ull;
+    value ^= value >> 31;
+    hash ^= value + 0x2545F4914F6CDD1Dull + (hash << 6) + (hash >> 2);
+    return hash;
+}
+
+
+/// 64-bit hash of a block of memory
+/**
+ * The bytes are consumed in 32-byte stripes by 4 independent scalar lanes, so the multiplications of a stripe overlap in the pipeline
+ * (the loop is not vectorized - there are no packed 64-bit multiplications below AVX-512). The tail is mixed in separately.
+ * The result depends only on the bytes (and seed) - the words are read as little-endian
+ * @param data Address of the first byte
+ * @param size Number of bytes
+ * @param seed The initial value of the hash (can be used to combine hashes)
+ * @returns The hash of the bytes
+ */
+inline std::uint64_t HashBytes(void const* data, std::size_t size, std::uint64_t seed = 0)
+{
+    constexpr std::uint64_t Prime1 = 0x9E3779B185EBCA87ull;
+    constexpr std::uint64_t Prime2 = 0xC2B2AE3D27D4EB4Full;
+    auto rotl = [](std::uint64_t x, int r) { return (x << r) | (x >> (64 - r)); };
+    auto read64 = [](std::uint8_t const* ptr) { // one unaligned load
+        std::uint64_t value;
+        std::memcpy(&value, ptr, sizeof(value));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        value = __builtin_bswap64(value);
+#endif
+        return value;
+    };
+    auto round = [&rotl](std::uint64_t lane, std::uint64_t word) { return rotl(lane + word * Prime2, 31) * Prime1; };
+
+    auto bytes = static_cast<std::uint8_t const*>(data);
+    std::uint64_t lane0 = seed + Prime1 + Prime2; // separate variables, so the lanes stay in registers
+    std::uint64_t lane1 = seed + Prime2;
+    std::uint64_t lane2 = seed;
+    std::uint64_t lane3 = seed - Prime1;
+    std::size_t stripes = size / 32;
+    for (std::size_t s = 0; s < stripes; ++s, bytes += 32) {
+        lane0 = round(lane0, read64(bytes));
+        lane1 = round(lane1, read64(bytes + 8));
+        lane2 = round(lane2, read64(bytes + 16));
+        lane3 = round(lane3, read64(bytes + 24));
+    }
+
+    std::uint64_t hash = HashCombine(HashCombine(HashCombine(HashCombine(std::uint64_t(size), lane0), lane1), lane2), lane3);
+    for (std::size_t i = 0; i < size % 32; ++i)
+        hash = (hash ^ bytes[i]) * 1099511628211ull;
+    return HashCombine(hash, seed);
+}
+
+} // namespace epp
+
+#endif // EPP_HASH_H
\ No newline at end of file
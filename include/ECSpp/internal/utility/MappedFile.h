@@ -0,0 +1,112 @@
+#ifndef EPP_MAPPEDFILE_H
+#define EPP_MAPPEDFILE_H
+
+#include <ECSpp/internal/utility/Assert.h>
+#include <cstdint>
+#include <string>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define EPP_HAS_MMAP
+#else
+#include <fstream>
+#include <new>
+#endif
+
+namespace epp {
+
+/// A file mapped into memory with private (copy-on-write) pages
+/**
+ * Pages are shared with other processes that map the same file until they are modified.
+ * Modifications are never written back to the file.
+ * On platforms without mmap, the whole file is read into memory instead
+ */
+class MappedFile {
+public:
+    /// Maps the whole file
+    /**
+     * @param path Path to the file
+     * @throws Throws the AssertionFailed exception (in debug and release) if the file could not be opened or mapped
+     */
+    explicit MappedFile(std::string const& path);
+
+    MappedFile(MappedFile&&) = delete;
+    MappedFile& operator=(MappedFile&&) = delete;
+    MappedFile(MappedFile const&) = delete;
+    MappedFile& operator=(MappedFile const&) = delete;
+
+
+    /// Destructor
+    /** Unmaps the file */
+    ~MappedFile();
+
+
+    /** @returns The address of the first byte of the file (aligned at least to the page size) */
+    std::uint8_t* data() const { return mem; }
+
+
+    /** @returns The size of the file in bytes */
+    std::size_t size() const { return bytes; }
+
+private:
+    std::uint8_t* mem = nullptr;
+    std::size_t bytes = 0;
+
+    constexpr static std::size_t const PageSize = 4096;
+};
+
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+#ifdef EPP_HAS_MMAP
+
+inline MappedFile::MappedFile(std::string const& path)
+{
+    int fd = ::open(path.c_str(), O_RDONLY);
+    EPP_ASSERTA_M(fd != -1, "Could not open the file: " + path);
+    struct stat st;
+    if (::fstat(fd, &st) == 0 && st.st_size > 0) {
+        void* ptr = ::mmap(nullptr, std::size_t(st.st_size), PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        if (ptr != MAP_FAILED) {
+            mem = static_cast<std::uint8_t*>(ptr);
+            bytes = std::size_t(st.st_size);
+        }
+    }
+    ::close(fd); // the mapping keeps its own reference to the file
+    EPP_ASSERTA_M(mem, "Could not map the file: " + path);
+}
+
+inline MappedFile::~MappedFile()
+{
+    ::munmap(mem, bytes);
+}
+
+#else
+
+inline MappedFile::MappedFile(std::string const& path)
+{
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    EPP_ASSERTA_M(file && file.tellg() > 0, "Could not open the file: " + path);
+    bytes = std::size_t(file.tellg());
+    mem = static_cast<std::uint8_t*>(operator new[](bytes, std::align_val_t(PageSize)));
+    file.seekg(0);
+    if (!file.read(reinterpret_cast<char*>(mem), std::streamsize(bytes))) {
+        operator delete[](mem, std::align_val_t(PageSize));
+        EPP_THROW_ASSERT_FAIL("Could not read the file: " + path);
+    }
+}
+
+inline MappedFile::~MappedFile()
+{
+    operator delete[](mem, std::align_val_t(PageSize));
+}
+
+#endif // EPP_HAS_MMAP
+
+} // namespace epp
+
+#endif // EPP_MAPPEDFILE_H
\ No newline at end of file
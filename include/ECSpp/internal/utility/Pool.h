@@ -16,6 +16,29 @@ inline std::size_t SizeToFitNextN(std::size_t n, std::size_t reserved, std::size
 }
 
 
+/// Plans the removal of many elements from an array in one pass - the holes left by them are filled with the kept elements from the tail
+/**
+ * Calls fillHole(hole, src) for each removed index lower than n - sortedIdxs.size() (hole), with the index of a kept element
+ * from the tail (src), the tail of the array [n - sortedIdxs.size(), n) is then left to be destroyed
+ * @param sortedIdxs Sorted unique indices lower than n of the removed elements
+ * @param n Number of elements in the array
+ * @param fillHole A callable object that accepts (std::size_t hole, std::size_t src)
+ */
+template <typename FillFn>
+inline void FillHolesFromTail(std::vector<std::size_t> const& sortedIdxs, std::size_t n, FillFn fillHole)
+{
+    std::size_t newN = n - sortedIdxs.size();
+    std::size_t src = n;
+    auto removedTail = sortedIdxs.rbegin();
+    for (auto hole = sortedIdxs.begin(); hole != sortedIdxs.end() && *hole < newN; ++hole) {
+        --src;
+        for (; removedTail != sortedIdxs.rend() && *removedTail == src; ++removedTail)
+            --src; // skip the removed ones
+        fillHole(*hole, src);
+    }
+}
+
+
 /**
  * A Vector that does not maintain order - the last component is always moved in the place of a removed one
  */
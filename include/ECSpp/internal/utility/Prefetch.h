@@ -0,0 +1,28 @@
+#ifndef EPP_PREFETCH_H
+#define EPP_PREFETCH_H
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <xmmintrin.h>
+#endif
+
+namespace epp {
+
+/// Hints the CPU to load the cache line of a given address, so a later read of it does not stall
+/**
+ * A no-op on compilers without a prefetch intrinsic. Never faults, so any address can be passed
+ * @param address Any address
+ */
+inline void Prefetch(void const* address)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_prefetch(address);
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    _mm_prefetch(static_cast<char const*>(address), _MM_HINT_T0);
+#else
+    (void)address;
+#endif
+}
+
+} // namespace epp
+
+#endif // EPP_PREFETCH_H
\ No newline at end of file
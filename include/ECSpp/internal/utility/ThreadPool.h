@@ -0,0 +1,173 @@
+#ifndef EPP_THREADPOOL_H
+#define EPP_THREADPOOL_H
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace epp {
+
+/// A fixed set of worker threads that run one job at a time, together with the calling thread
+/**
+ * Workers are started once and sleep between jobs, so a parallel loop does not pay for creating and joining threads.
+ * Jobs of one pool are serialized. A job started from inside a running job (on any pool) runs on the calling thread only
+ */
+class ThreadPool {
+public:
+    /// Starts the worker threads
+    /**
+     * @param threadsNum The number of threads of a job, including the calling one (0 - std::thread::hardware_concurrency())
+     */
+    explicit ThreadPool(std::size_t threadsNum = 0);
+
+
+    ThreadPool(ThreadPool const&) = delete;
+    ThreadPool& operator=(ThreadPool const&) = delete;
+
+
+    /// Destructor
+    /** Stops and joins the worker threads */
+    ~ThreadPool();
+
+
+    /// Calls func on up to threadsNum threads (the calling one included) and waits until every call returns
+    /**
+     * func is called once by each participating thread, usually it takes the work from a shared (atomic) counter.
+     * If any call throws, the first exception is rethrown on the calling thread after all of them return
+     * @tparam Func A callable type that accepts no arguments
+     * @param func A callable object that accepts no arguments, called concurrently
+     * @param threadsNum The maximal number of threads, including the calling one (0 - size())
+     */
+    template <typename Func>
+    void run(Func func, std::size_t threadsNum = 0);
+
+
+    /** @returns The number of threads of a job, including the calling one */
+    std::size_t size() const { return workers.size() + 1; }
+
+
+    /// Returns the pool used by default, with std::thread::hardware_concurrency() threads
+    /**
+     * Started on the first call and stopped at exit
+     * @returns Reference to the shared pool
+     */
+    static ThreadPool& shared();
+
+private:
+    void workerLoop(std::size_t workerIdx);
+
+private:
+    static inline thread_local bool insideJob = false; // running a job (or being a worker), nested jobs run serially
+
+    std::vector<std::thread> workers;
+
+    std::mutex runMutex; // serializes the jobs
+
+    std::mutex mutex; // guards the fields below
+    std::condition_variable wakeUp;
+    std::condition_variable done;
+    void (*job)(void*) = nullptr;
+    void* jobData = nullptr;
+    std::size_t jobWorkers = 0; // workers with lower indices take part in the current job
+    std::uint64_t generation = 0; // incremented for each job
+    std::size_t pending = 0; // workers that did not finish the current job yet
+    bool stopping = false;
+};
+
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+inline ThreadPool::ThreadPool(std::size_t threadsNum)
+{
+    if (threadsNum == 0)
+        threadsNum = std::max<std::size_t>(std::thread::hardware_concurrency(), 1);
+    workers.reserve(threadsNum - 1);
+    for (std::size_t i = 0; i + 1 < threadsNum; ++i)
+        workers.emplace_back(&ThreadPool::workerLoop, this, i);
+}
+
+inline ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wakeUp.notify_all();
+    for (auto& worker : workers)
+        worker.join();
+}
+
+template <typename Func>
+inline void ThreadPool::run(Func func, std::size_t threadsNum)
+{
+    if (threadsNum == 0 || threadsNum > size())
+        threadsNum = size();
+    if (threadsNum == 1 || insideJob) {
+        func();
+        return;
+    }
+
+    std::exception_ptr error;
+    std::mutex errorMutex;
+    auto task = [&]() {
+        try {
+            func();
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(errorMutex);
+            if (!error)
+                error = std::current_exception();
+        }
+    };
+    std::lock_guard<std::mutex> runLock(runMutex);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        job = [](void* data) { (*static_cast<decltype(task)*>(data))(); };
+        jobData = &task;
+        jobWorkers = threadsNum - 1;
+        pending = jobWorkers;
+        ++generation;
+    }
+    wakeUp.notify_all();
+    insideJob = true;
+    task(); // the calling thread takes part too
+    insideJob = false;
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [this]() { return pending == 0; });
+    }
+    if (error)
+        std::rethrow_exception(error);
+}
+
+inline ThreadPool& ThreadPool::shared()
+{
+    static ThreadPool pool;
+    return pool;
+}
+
+inline void ThreadPool::workerLoop(std::size_t workerIdx)
+{
+    insideJob = true;
+    std::uint64_t seen = 0;
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        wakeUp.wait(lock, [&]() { return stopping || (generation != seen && workerIdx < jobWorkers); });
+        if (stopping)
+            return;
+        seen = generation;
+        lock.unlock();
+        job(jobData); // exceptions are caught inside
+        lock.lock();
+        if (--pending == 0)
+            done.notify_one();
+    }
+}
+
+} // namespace epp
+
+#endif // EPP_THREADPOOL_H
\ No newline at end of file
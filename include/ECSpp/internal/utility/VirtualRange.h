@@ -0,0 +1,162 @@
+#ifndef EPP_VIRTUALRANGE_H
+#define EPP_VIRTUALRANGE_H
+
+#include <ECSpp/internal/utility/Assert.h>
+#include <algorithm>
+#include <cstdint>
+#include <new>
+#include <utility>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#include <unistd.h>
+#define EPP_HAS_MMAP
+#endif
+
+namespace epp {
+
+/// A range of virtual addresses reserved up front, with pages committed (made accessible) as it grows
+/**
+ * The range never moves, so pointers into it stay valid when more of it is committed.
+ * On platforms without mmap, the whole range is allocated (and committed) at once instead
+ */
+class VirtualRange {
+public:
+    /// Constructs an empty range
+    VirtualRange() = default;
+
+
+    /// Reserves a range of addresses, nothing is committed yet
+    /**
+     * @param bytes Size of the range
+     * @throws Throws the AssertionFailed exception (in debug and release) if the addresses could not be reserved
+     */
+    explicit VirtualRange(std::size_t bytes);
+
+
+    /// Move constructor
+    VirtualRange(VirtualRange&& rval) noexcept { swap(rval); }
+
+
+    /// Move assignment
+    VirtualRange& operator=(VirtualRange&& rval) noexcept
+    {
+        VirtualRange(std::move(rval)).swap(*this);
+        return *this;
+    }
+
+
+    VirtualRange(VirtualRange const&) = delete;
+    VirtualRange& operator=(VirtualRange const&) = delete;
+
+
+    /// Destructor
+    /** Releases the whole range */
+    ~VirtualRange();
+
+
+    /// Commits the pages that cover the first bytes of the range (no-op for the already committed ones)
+    /**
+     * @param bytes Number of bytes that have to be accessible, not greater than size()
+     * @throws Throws the AssertionFailed exception (in debug and release) if bytes > size() or the pages could not be committed
+     */
+    void commit(std::size_t bytes);
+
+
+    /** @returns The address of the first byte of the range (aligned to the page size), nullptr if the range is empty */
+    std::uint8_t* data() const { return mem; }
+
+
+    /** @returns The size of the range in bytes */
+    std::size_t size() const { return reservedBytes; }
+
+
+    /** @returns The number of committed bytes (a multiple of the page size) */
+    std::size_t committed() const { return committedBytes; }
+
+
+    /** @returns The size of a page */
+    static std::size_t PageSize();
+
+private:
+    void swap(VirtualRange& other) noexcept
+    {
+        std::swap(mem, other.mem);
+        std::swap(reservedBytes, other.reservedBytes);
+        std::swap(committedBytes, other.committedBytes);
+    }
+
+private:
+    std::uint8_t* mem = nullptr;
+    std::size_t reservedBytes = 0;
+    std::size_t committedBytes = 0;
+};
+
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+inline void VirtualRange::commit(std::size_t bytes)
+{
+    EPP_ASSERTA_M(bytes <= reservedBytes, "The reserved range of addresses is too small");
+    if (bytes <= committedBytes)
+        return;
+    std::size_t newCommitted = std::min((bytes + PageSize() - 1) / PageSize() * PageSize(), reservedBytes);
+#ifdef EPP_HAS_MMAP
+    EPP_ASSERTA_M(::mprotect(mem + committedBytes, newCommitted - committedBytes, PROT_READ | PROT_WRITE) == 0, "Could not commit the memory");
+#endif
+    committedBytes = newCommitted;
+}
+
+#ifdef EPP_HAS_MMAP
+
+inline VirtualRange::VirtualRange(std::size_t bytes)
+{
+    bytes = (bytes + PageSize() - 1) / PageSize() * PageSize();
+    if (bytes == 0)
+        return;
+    void* ptr = ::mmap(nullptr, bytes, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    EPP_ASSERTA_M(ptr != MAP_FAILED, "Could not reserve the range of addresses");
+    mem = static_cast<std::uint8_t*>(ptr);
+    reservedBytes = bytes;
+}
+
+inline VirtualRange::~VirtualRange()
+{
+    if (mem)
+        ::munmap(mem, reservedBytes);
+}
+
+inline std::size_t VirtualRange::PageSize()
+{
+    static std::size_t const pageSize = std::size_t(::sysconf(_SC_PAGESIZE));
+    return pageSize;
+}
+
+#else
+
+inline VirtualRange::VirtualRange(std::size_t bytes)
+{
+    bytes = (bytes + PageSize() - 1) / PageSize() * PageSize();
+    if (bytes == 0)
+        return;
+    mem = static_cast<std::uint8_t*>(operator new[](bytes, std::align_val_t(PageSize())));
+    reservedBytes = bytes;
+}
+
+inline VirtualRange::~VirtualRange()
+{
+    if (mem)
+        operator delete[](mem, std::align_val_t(PageSize()));
+}
+
+inline std::size_t VirtualRange::PageSize()
+{
+    return 4096;
+}
+
+#endif // EPP_HAS_MMAP
+
+} // namespace epp
+
+#endif // EPP_VIRTUALRANGE_H
\ No newline at end of file
@@ -1,6 +1,10 @@
 #include "ComponentsT.h"
 #include <ECSpp/internal/CPool.h>
+#include <algorithm>
+#include <cstring>
 #include <gtest/gtest.h>
+#include <numeric>
+#include <sstream>
 
 using namespace epp;
 
@@ -232,4 +236,131 @@ TEST(CPool, reserve)
     correct.data.resize(0);
     correct.data.shrink_to_fit();
     TestCPool(pool, correct);
+}
+
+TEST(CPool, SaveLoad)
+{
+    CPool pool(IdOf<TTrivial1>());
+    for (int i = 0; i < 100; ++i)
+        *static_cast<TTrivial1*>(pool.alloc()) = TTrivial1{ { i, 2 * i, 3 * i } };
+
+    std::stringstream stream;
+    pool.save(stream);
+    CPool loaded(IdOf<TTrivial1>());
+    loaded.alloc();
+    loaded.construct(0);
+    loaded.load(stream); // appends
+    ASSERT_EQ(loaded.size(), 101);
+    for (int i = 0; i < 100; ++i)
+        ASSERT_EQ(*static_cast<TTrivial1*>(loaded[i + 1]), *static_cast<TTrivial1*>(pool[i]));
+
+    stream.seekg(0);
+    CPool other(IdOf<TTrivial2>()); // different type, same size
+    ASSERT_THROW(other.load(stream), AssertFailed);
+
+    std::stringstream truncated(stream.str().substr(0, stream.str().size() - 1));
+    ASSERT_THROW(loaded.load(truncated), AssertFailed);
+
+    CPool notTrivial(IdOf<TComp1>());
+    ASSERT_THROW(notTrivial.save(stream), AssertFailed);
+}
+
+TEST(CPool, Adopt)
+{
+    CPool pool(IdOf<TTrivial1>());
+    for (int i = 0; i < 100; ++i)
+        *static_cast<TTrivial1*>(pool.alloc()) = TTrivial1{ { i, 2 * i, 3 * i } };
+    std::stringstream stream;
+    pool.save(stream);
+    std::string bytes = stream.str();
+    auto memory = std::make_shared<std::vector<TTrivial1>>(bytes.size() / sizeof(TTrivial1) + 1); // aligned for TTrivial1
+    std::memcpy(memory->data(), bytes.data(), bytes.size());
+
+    MemoryBuf buf(memory->data(), bytes.size());
+    std::istream is(&buf);
+    CPool adopted(IdOf<TTrivial1>());
+    adopted.load(is, memory);
+    ASSERT_TRUE(adopted.isExternal());
+    ASSERT_EQ(adopted.size(), 100);
+    ASSERT_EQ(adopted.capacity(), 100);
+    ASSERT_EQ(memory.use_count(), 2);
+    ASSERT_GE(adopted[0], static_cast<void*>(memory->data()));
+    ASSERT_LT(adopted[0], static_cast<void*>(memory->data() + memory->size()));
+    for (int i = 0; i < 100; ++i)
+        ASSERT_EQ(*static_cast<TTrivial1*>(adopted[i]), *static_cast<TTrivial1*>(pool[i]));
+
+    adopted.destroy(5); // works in place
+    ASSERT_TRUE(adopted.isExternal());
+    ASSERT_EQ(*static_cast<TTrivial1*>(adopted[5]), *static_cast<TTrivial1*>(pool[99]));
+
+    *static_cast<TTrivial1*>(adopted.alloc()) = TTrivial1{ { 7, 7, 7 } }; // still fits
+    ASSERT_TRUE(adopted.isExternal());
+    *static_cast<TTrivial1*>(adopted.alloc()) = TTrivial1{ { 8, 8, 8 } }; // growth moves the components to the owned memory
+    ASSERT_FALSE(adopted.isExternal());
+    ASSERT_EQ(memory.use_count(), 1);
+    ASSERT_EQ(adopted.size(), 101);
+    ASSERT_EQ(*static_cast<TTrivial1*>(adopted[5]), *static_cast<TTrivial1*>(pool[99]));
+    ASSERT_EQ(*static_cast<TTrivial1*>(adopted[99]), (TTrivial1{ { 7, 7, 7 } }));
+
+    // without the owner, components are copied
+    MemoryBuf buf2(memory->data(), bytes.size());
+    std::istream is2(&buf2);
+    CPool copied(IdOf<TTrivial1>());
+    copied.load(is2);
+    ASSERT_FALSE(copied.isExternal());
+    ASSERT_EQ(copied.size(), 100);
+}
+
+TEST(CPool, ReserveVirtual)
+{
+    CPool pool(IdOf<TComp1>());
+    Pool<TComp1> correct;
+    for (int i = 0; i < 10; ++i) {
+        new (pool.alloc()) TComp1({ i, i, i });
+        correct.create(TComp1({ i, i, i }));
+    }
+    pool.reserveVirtual(10000);
+    ASSERT_TRUE(pool.isVirtual());
+    TestCPool(pool, correct);
+
+    void* first = pool[0];
+    for (int i = 10; i < 5000; ++i) { // growth does not move the components
+        new (pool.alloc()) TComp1({ i, i, i });
+        correct.create(TComp1({ i, i, i }));
+    }
+    ASSERT_EQ(pool[0], first);
+    TestCPool(pool, correct);
+
+    std::vector<std::size_t> order(pool.size());
+    std::iota(order.rbegin(), order.rend(), 0);
+    pool.permute(order); // in place
+    std::reverse(correct.data.begin(), correct.data.end());
+    ASSERT_EQ(pool[0], first);
+    TestCPool(pool, correct);
+
+    pool.reserve(100); // destroys the rest
+    correct.data.resize(100);
+    TestCPool(pool, correct);
+    ASSERT_THROW(pool.fitNextN(20000), AssertFailed); // does not fit the range
+}
+
+TEST(CPool, Replicate)
+{
+    CPool pool(IdOf<TComp1>());
+    Pool<TComp1> correct;
+    for (int i = 0; i < 3; ++i) {
+        new (pool.alloc()) TComp1({ i, i, i });
+        correct.create(TComp1({ i, i, i }));
+    }
+    pool.replicate(1, 100); // reallocates
+    for (int i = 0; i < 100; ++i)
+        correct.create(TComp1({ 1, 1, 1 }));
+    TestCPool(pool, correct);
+
+    CPool trivial(IdOf<TTrivial1>());
+    new (trivial.alloc()) TTrivial1{ { 4, 5, 6 } };
+    trivial.replicate(0, 50);
+    ASSERT_EQ(trivial.size(), 51);
+    for (std::size_t i = 0; i < trivial.size(); ++i)
+        ASSERT_EQ(*static_cast<TTrivial1*>(trivial[i]), (TTrivial1{ { 4, 5, 6 } }));
 }
\ No newline at end of file
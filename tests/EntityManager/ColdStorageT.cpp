@@ -0,0 +1,76 @@
+#include "ComponentsT.h"
+#include <ECSpp/EntityManager.h>
+#include <gtest/gtest.h>
+
+using namespace epp;
+
+TEST(ColdStorage, Cold)
+{
+    int alive = TComp3::AliveCounter;
+    Cold<TComp3> const unallocated;
+    ASSERT_FALSE(unallocated.isAllocated());
+    ASSERT_EQ(unallocated.get(), nullptr);
+    ASSERT_THROW(*unallocated, AssertFailed); // no value is constructed by const access
+    ASSERT_EQ(TComp3::AliveCounter, alive);
+
+    {
+        Cold<TComp3> cold;
+        cold->data = { 1, 2, 3 };
+        ASSERT_TRUE(cold.isAllocated());
+        TComp3* address = &*cold;
+
+        Cold<TComp3> moved(std::move(cold)); // only the pointer is moved
+        ASSERT_FALSE(cold.isAllocated());
+        ASSERT_EQ(&*moved, address);
+        Cold<TComp3> copy(moved);
+        ASSERT_NE(&*copy, address);
+        ASSERT_EQ(copy->data, TComp3::Arr_t({ 1, 2, 3 }));
+    }
+    ASSERT_EQ(TComp3::AliveCounter, alive);
+}
+
+TEST(ColdStorage, EntityManager)
+{
+    int alive = TComp3::AliveCounter;
+    {
+        EntityManager mgr;
+        Archetype arch(IdOf<TComp1, Cold<TComp3>>());
+        Archetype smaller(IdOfL<Cold<TComp3>>());
+        mgr.spawn(arch, 100, [](EntityCreator&& creator) {
+            static int i = 0;
+            creator.constructed<Cold<TComp3>>(TComp3({ i, i, i }));
+            ++i;
+        });
+        mgr.spawn(arch, 100); // never accessed - not allocated
+        ASSERT_EQ(TComp3::AliveCounter, alive + 100);
+
+        auto const& ents = mgr.entitiesOf(arch).data;
+        Entity first = ents[0];
+        Entity last = ents[99];
+        TComp3* address = &*mgr.componentOf<Cold<TComp3>>(last);
+        mgr.destroy(first); // swap-remove moves only the pointer
+        mgr.changeArchetype(last, smaller);
+        ASSERT_EQ(&*mgr.componentOf<Cold<TComp3>>(last), address);
+        ASSERT_EQ(mgr.componentOf<Cold<TComp3>>(last)->data, TComp3::Arr_t({ 99, 99, 99 }));
+        ASSERT_EQ(TComp3::AliveCounter, alive + 99);
+
+        // selections pass the cold values
+        Selection<Cold<TComp3>> sel;
+        mgr.updateSelection(sel);
+        int sum = 0;
+        sel.forEach([&](Entity, TComp3& c) { sum += c.data[0]; });
+        ASSERT_EQ(sum, 99 * 100 / 2);
+        ASSERT_EQ(TComp3::AliveCounter, alive + 199);
+        Selection<Cold<TComp3> const> constSel;
+        mgr.updateSelection(constSel);
+        constSel.forEach([&](Entity, TComp3 const* c) { sum -= c->data[0]; });
+        ASSERT_EQ(sum, 0);
+
+        mgr.spawn(smaller, 10);
+        int unallocated = 0;
+        constSel.forEach([&](Entity, TComp3 const* c) { unallocated += c == nullptr; });
+        ASSERT_EQ(unallocated, 10);
+        ASSERT_EQ(TComp3::AliveCounter, alive + 199);
+    }
+    ASSERT_EQ(TComp3::AliveCounter, alive);
+}
\ No newline at end of file
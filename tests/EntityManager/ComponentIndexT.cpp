@@ -0,0 +1,97 @@
+#include "ComponentsT.h"
+#include <ECSpp/EntityManager.h>
+#include <gtest/gtest.h>
+#include <sstream>
+
+using namespace epp;
+
+static auto KeyOf = [](TTrivial1 const& comp) { return comp.data[0]; };
+
+TEST(ComponentIndex, InsertErase)
+{
+    EntityList entList;
+    Entity ent1 = entList.allocEntity(PoolIdx(0), SpawnerId(0));
+    Entity ent2 = entList.allocEntity(PoolIdx(1), SpawnerId(0));
+    TTrivial1 comp1, comp2;
+    comp1.data = { 1, 0, 0 };
+    comp2.data = { 2, 0, 0 };
+
+    ComponentIndex<TTrivial1, decltype(KeyOf)> index(KeyOf);
+    ASSERT_EQ(index.getCId(), IdOf<TTrivial1>());
+    index.insert(ent1, &comp1);
+    index.insert(ent2, &comp2);
+    ASSERT_EQ(index.size(), 2);
+    ASSERT_EQ(index.find(1), ent1);
+    ASSERT_EQ(index.find(2), ent2);
+    ASSERT_EQ(index.find(3), Entity());
+
+    comp1.data[0] = 2; // duplicated key
+    index.insert(ent1, &comp1);
+    ASSERT_EQ(index.size(), 2);
+    ASSERT_EQ(index.count(1), 0);
+    ASSERT_EQ(index.count(2), 2);
+
+    index.erase(ent2);
+    index.erase(ent2); // no-op
+    ASSERT_EQ(index.find(2), ent1);
+    index.clear();
+    ASSERT_EQ(index.size(), 0);
+}
+
+TEST(ComponentIndex, EntityManager)
+{
+    EntityManager mgr;
+    Archetype arch(IdOf<TTrivial1, TTrivial2>());
+    Archetype noKey(IdOfL<TTrivial2>());
+    int key = 0;
+    auto spawnFn = [&key](EntityCreator&& cr) { cr.constructed<TTrivial1>().data = { key++, 0, 0 }; };
+    mgr.spawn(arch, 100, spawnFn);
+    auto const& index = mgr.addIndex<TTrivial1>(KeyOf); // indexes the existing entities
+    ASSERT_EQ(index.size(), 100);
+    mgr.spawn(arch, 100, spawnFn);
+    Entity single = mgr.spawn(arch, spawnFn);
+    ASSERT_EQ(index.size(), 201);
+    for (int i = 0; i < 200; ++i)
+        ASSERT_EQ(mgr.componentOf<TTrivial1>(index.find(i)).data[0], i);
+    ASSERT_EQ(index.find(200), single);
+
+    Entity ent5 = index.find(5);
+    mgr.destroy(index.find(0)); // relocates the last entity
+    ASSERT_EQ(index.find(0), Entity());
+    ASSERT_EQ(index.find(200), single);
+    ASSERT_EQ(mgr.componentOf<TTrivial1>(index.find(200)).data[0], 200);
+
+    mgr.changeArchetype(ent5, noKey);
+    ASSERT_EQ(index.find(5), Entity());
+    mgr.changeArchetype(ent5, arch, [&key](EntityCreator&& cr) { cr.constructed<TTrivial1>().data = { 1005, 0, 0 }; });
+    ASSERT_EQ(index.find(1005), ent5);
+
+    mgr.componentOf<TTrivial1>(ent5).data[0] = 2005; // keys are not tracked
+    ASSERT_EQ(index.find(1005), ent5);
+    mgr.reindex(ent5);
+    ASSERT_EQ(index.find(1005), Entity());
+    ASSERT_EQ(index.find(2005), ent5);
+
+    Selection<TTrivial1 const> sel; // iteration-time destruction
+    mgr.updateSelection(sel);
+    sel.forEach([&mgr](Entity ent, TTrivial1 const& comp) {
+        if (comp.data[0] % 2 == 0) {
+            mgr.destroy(ent);
+            return IterTimeChange::DestroyedCurrent;
+        }
+        return IterTimeChange(1);
+    });
+    ASSERT_EQ(index.size(), mgr.size(arch));
+    ASSERT_EQ(index.find(4), Entity());
+    ASSERT_EQ(mgr.componentOf<TTrivial1>(index.find(7)).data[0], 7);
+
+    std::stringstream snapshot;
+    mgr.save(snapshot);
+    mgr.clear(arch);
+    ASSERT_EQ(index.size(), 0);
+    mgr.load(snapshot);
+    ASSERT_EQ(index.size(), mgr.size(arch));
+    ASSERT_EQ(mgr.componentOf<TTrivial1>(index.find(7)).data[0], 7);
+    mgr.clear();
+    ASSERT_EQ(index.size(), 0);
+}
@@ -1,5 +1,7 @@
 #include "ComponentsT.h"
 #include <ECSpp/Component.h>
+#include <ECSpp/internal/ColdStorage.h>
+#include <ECSpp/internal/SharedStore.h>
 #include <gtest/gtest.h>
 
 using namespace epp;
@@ -9,8 +11,8 @@ using namespace epp;
 // OTHERWISE PROGRAM WILL TERMINATE ON THIS TEST
 TEST(Component, Register_Id)
 {
-    CMetadata::Register<TComp1, TComp2, TComp3, TComp4>();
-    ASSERT_THROW((CMetadata::Register<TComp1, TComp2, TComp3, TComp4>()), AssertFailed);
+    CMetadata::Register<TComp1, TComp2, TComp3, TComp4, TTrivial1, TTrivial2, Shared<TComp2>, Cold<TComp3>, SoAField<TSoA, 0>, SoAField<TSoA, 1>, SoAField<TSoA, 2>, TMoveOnlyVec, TMoveOnly>();
+    ASSERT_THROW((CMetadata::Register<TComp1, TComp2, TComp3, TComp4, TTrivial1, TTrivial2, Shared<TComp2>, Cold<TComp3>, SoAField<TSoA, 0>, SoAField<TSoA, 1>, SoAField<TSoA, 2>, TMoveOnlyVec, TMoveOnly>()), AssertFailed);
     ASSERT_THROW(
         try {
             auto x = IdOf<int>();
@@ -49,6 +51,15 @@ TEST(Component, Metadata)
     ASSERT_EQ(CMetadata::GetData(IdOf<TComp4>()).size, sizeof(TComp4));
     ASSERT_EQ(CMetadata::GetData(IdOf<TComp1>()).alignment, alignof(TComp1));
     ASSERT_EQ(CMetadata::GetData(IdOf<TComp4>()).alignment, alignof(TComp4));
+    ASSERT_NE(CMetadata::GetData(IdOf<TComp1>()).nameHash, CMetadata::GetData(IdOf<TComp4>()).nameHash);
+    ASSERT_NE(CMetadata::GetData(IdOf<TTrivial1>()).nameHash, CMetadata::GetData(IdOf<TTrivial2>()).nameHash);
+    ASSERT_FALSE(CMetadata::GetData(IdOf<TComp1>()).triviallyCopyable);
+    ASSERT_TRUE(CMetadata::GetData(IdOf<TTrivial1>()).triviallyCopyable);
+    ASSERT_NE(CMetadata::GetData(IdOf<TComp1>()).copyConstructor, nullptr);
+    ASSERT_EQ(CMetadata::GetData(IdOf<TMoveOnlyVec>()).copyConstructor, nullptr); // by the type of the values
+    ASSERT_EQ(CMetadata::GetData(IdOf<TMoveOnly>()).copyConstructor, nullptr);    // specialized CopyableComponent
+    ASSERT_TRUE(CMetadata::IsRegistered(IdOf<TTrivial2>()));
+    ASSERT_FALSE(CMetadata::IsRegistered(ComponentId(CMetadata::MaxRegisteredComponents - 1)));
 
     {
         auto obj = std::make_unique<TComp1>();
@@ -2,7 +2,9 @@
 #define EPP_COMPONENTS_H
 
 #include <ECSpp/Component.h>
+#include <ECSpp/internal/SoA.h>
 #include <array>
+#include <memory>
 #include <vector>
 
 template <int N>
@@ -83,4 +85,47 @@ using TComp2 = TCompBase<2>;
 using TComp3 = TCompBase<3>;
 using TComp4 = TCompBase<4>;
 
+
+template <int N>
+struct TTrivialCompBase {
+    using Arr_t = std::array<int, 3>;
+
+    bool operator==(TTrivialCompBase const& rhs) const { return data == rhs.data; }
+    bool operator!=(TTrivialCompBase const& rhs) const { return !(*this == rhs); }
+
+    Arr_t data = { 0, 0, 0 };
+};
+
+using TTrivial1 = TTrivialCompBase<1>;
+using TTrivial2 = TTrivialCompBase<2>;
+
+
+// std::is_copy_constructible is true for both, but their copy constructors do not compile
+using TMoveOnlyVec = std::vector<std::unique_ptr<int>>;
+
+struct TMoveOnly {
+    std::vector<std::unique_ptr<int>> values;
+    int x = 0;
+};
+
+namespace epp {
+template <>
+struct CopyableComponent<TMoveOnly> : std::false_type {
+};
+} // namespace epp
+
+
+struct TSoA {
+    float x = 0.f;
+    float y = 0.f;
+    int tag = 0;
+};
+
+namespace epp {
+template <>
+struct SoALayout<TSoA> {
+    static constexpr auto Fields = std::make_tuple(&TSoA::x, &TSoA::y, &TSoA::tag);
+};
+} // namespace epp
+
 #endif // EPP_COMPONENTS_H
\ No newline at end of file
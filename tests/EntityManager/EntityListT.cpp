@@ -1,5 +1,8 @@
 #include <ECSpp/internal/EntityList.h>
+#include <algorithm>
 #include <gtest/gtest.h>
+#include <iterator>
+#include <vector>
 
 using namespace epp;
 
@@ -166,4 +169,29 @@ TEST(EntityList, fitNextN)
     for (int i = 0; i < 5000; ++i)
         list.allocEntity(PoolIdx(0), SpawnerId(0));
     TestEntity(entity, { ListIdx(0), EntVersion(2) }, {}, list, false);
+}
+
+TEST(EntityList, IsValidMany)
+{
+    EntityList list;
+    std::vector<Entity> ents;
+    for (int i = 0; i < 200; ++i)
+        ents.push_back(list.allocEntity(PoolIdx(i), SpawnerId(0)));
+    for (int i = 0; i < 200; i += 3)
+        list.freeEntity(ents[i]);
+    ents.push_back(Entity());                                      // out of range
+    ents.push_back({ ListIdx(1), ents[1].version.nextVersion() }); // wrong version
+
+    std::vector<std::uint64_t> bits((ents.size() + 63) / 64, ~std::uint64_t(0));
+    std::size_t valid = list.isValid(ents.data(), ents.size(), bits.data());
+    ASSERT_EQ(valid, 200 - 67);
+    for (std::size_t i = 0; i < ents.size(); ++i)
+        ASSERT_EQ(bool(bits[i / 64] >> (i % 64) & 1), list.isValid(ents[i]));
+    ASSERT_EQ(bits.back() >> (ents.size() % 64), 0); // bits past n are cleared
+
+    std::vector<Entity> expected;
+    std::copy_if(ents.begin(), ents.end(), std::back_inserter(expected), [&list](Entity ent) { return list.isValid(ent); });
+    ents.erase(list.removeInvalid(ents.data(), ents.data() + ents.size()) - ents.data() + ents.begin(), ents.end());
+    ASSERT_EQ(ents, expected);
+    ASSERT_EQ(list.removeInvalid(ents.data(), ents.data()), ents.data()); // empty range
 }
\ No newline at end of file
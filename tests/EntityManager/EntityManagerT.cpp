@@ -1,7 +1,13 @@
 #include "ComponentsT.h"
 #include <ECSpp/EntityManager.h>
 #include <algorithm>
+#include <filesystem>
+#include <fstream>
 #include <gtest/gtest.h>
+#include <iterator>
+#include <random>
+#include <sstream>
+#include <utility>
 
 using namespace epp;
 
@@ -319,6 +325,836 @@ TEST(EntityManager, PrepareToSpawn)
     }
 }
 
+TEST(EntityManager, SaveLoad)
+{
+    Archetype arch1(IdOf<TTrivial1, TTrivial2>());
+    Archetype arch2(IdOfL<TTrivial2>());
+    auto fn = [n = 0](EntityCreator&& cr) mutable {
+        if (cr.getCMask().get(IdOf<TTrivial1>()))
+            cr.constructed<TTrivial1>().data = { n, n, n };
+        cr.constructed<TTrivial2>().data = { -n, -n, ++n };
+    };
+    EntityManager mgr;
+    auto [begin, end] = mgr.spawn(arch1, 1000, fn);
+    std::vector<Entity> ents(begin, end);
+    for (int i = 0; i < 1000; i += 3) // shuffle pools and make holes in the entity list
+        mgr.changeArchetype(ents[i], arch2);
+    for (int i = 1; i < 1000; i += 7)
+        mgr.destroy(ents[i]);
+    mgr.spawn(Archetype(), 10);
+
+    std::stringstream stream;
+    mgr.save(stream);
+    EntityManager loaded;
+    loaded.spawn(arch1, 5); // destroyed by load
+    loaded.load(stream);
+    ASSERT_EQ(loaded.size(), mgr.size());
+    ASSERT_EQ(loaded.entitiesOf(arch1).data, mgr.entitiesOf(arch1).data);
+    ASSERT_EQ(loaded.entitiesOf(arch2).data, mgr.entitiesOf(arch2).data);
+    for (auto ent : ents) {
+        ASSERT_EQ(loaded.isValid(ent), mgr.isValid(ent));
+        if (!mgr.isValid(ent))
+            continue;
+        ASSERT_EQ(loaded.maskOf(ent), mgr.maskOf(ent));
+        ASSERT_EQ(loaded.componentOf<TTrivial2>(ent), mgr.componentOf<TTrivial2>(ent));
+        if (mgr.maskOf(ent).get(IdOf<TTrivial1>())) {
+            ASSERT_EQ(loaded.componentOf<TTrivial1>(ent), mgr.componentOf<TTrivial1>(ent));
+        }
+    }
+    // new entities do not collide with the loaded ones
+    Entity newEnt = loaded.spawn(arch2);
+    ASSERT_EQ(std::count(ents.begin(), ents.end(), newEnt), 0);
+    ASSERT_EQ(loaded.size(), mgr.size() + 1);
+
+    // loading again into the same manager
+    stream.seekg(0);
+    loaded.load(stream);
+    ASSERT_EQ(loaded.size(), mgr.size());
+    ASSERT_EQ(loaded.size(arch2), mgr.size(arch2));
+}
+
+TEST(EntityManager, SaveLoadErrors)
+{
+    EntityManager mgr;
+    mgr.spawn(Archetype(IdOf<TTrivial1, TTrivial2>()), 10);
+    std::stringstream stream;
+    mgr.save(stream);
+    std::string const snapshot = stream.str();
+
+    { // different archetypes
+        EntityManager other;
+        other.spawn(Archetype(IdOfL<TTrivial1>()));
+        ASSERT_THROW(other.load(stream), AssertFailed);
+        ASSERT_EQ(other.size(), 0);
+    }
+    { // truncated
+        EntityManager other;
+        std::stringstream truncated(snapshot.substr(0, snapshot.size() - 4));
+        ASSERT_THROW(other.load(truncated), AssertFailed);
+        ASSERT_EQ(other.size(), 0);
+    }
+    { // not a snapshot
+        EntityManager other;
+        std::stringstream garbage("garbage");
+        ASSERT_THROW(other.load(garbage), AssertFailed);
+    }
+    { // components that are not trivially copyable
+        mgr.spawn(Archetype(IdOfL<TComp1>()));
+        std::stringstream out;
+        ASSERT_THROW(mgr.save(out), AssertFailed);
+        ASSERT_EQ(out.str().size(), 0);
+    }
+}
+
+TEST(EntityManager, LoadMapped)
+{
+    Archetype arch(IdOf<TTrivial1, TTrivial2>());
+    EntityManager mgr;
+    auto [begin, end] = mgr.spawn(arch, 1000, [n = 0](EntityCreator&& cr) mutable {
+        cr.constructed<TTrivial1>().data = { n, n, n };
+        cr.constructed<TTrivial2>().data = { -n, -n, ++n };
+    });
+    std::vector<Entity> ents(begin, end);
+    mgr.destroy(ents[10]);
+
+    auto path = (std::filesystem::temp_directory_path() / "ECSpp_LoadMapped.bin").string();
+    {
+        std::ofstream file(path, std::ios::binary);
+        mgr.save(file);
+    }
+    {
+        EntityManager mapped;
+        mapped.loadMapped(path);
+        ASSERT_EQ(mapped.size(), mgr.size());
+        ASSERT_EQ(mapped.entitiesOf(arch).data, mgr.entitiesOf(arch).data);
+        for (auto ent : mgr.entitiesOf(arch).data) {
+            ASSERT_EQ(mapped.componentOf<TTrivial1>(ent), mgr.componentOf<TTrivial1>(ent));
+            ASSERT_EQ(mapped.componentOf<TTrivial2>(ent), mgr.componentOf<TTrivial2>(ent));
+        }
+        mapped.componentOf<TTrivial1>(ents[0]).data = { 9, 9, 9 }; // copy on write
+        mapped.destroy(ents[1]);
+        mapped.spawn(arch, 100); // moved to owned memory
+        ASSERT_EQ(mapped.componentOf<TTrivial1>(ents[0]), (TTrivial1{ { 9, 9, 9 } }));
+        ASSERT_EQ(mapped.componentOf<TTrivial1>(ents[2]), mgr.componentOf<TTrivial1>(ents[2]));
+    }
+    { // the file was not modified
+        EntityManager mapped;
+        mapped.loadMapped(path);
+        ASSERT_EQ(mapped.componentOf<TTrivial1>(ents[0]), mgr.componentOf<TTrivial1>(ents[0]));
+        ASSERT_TRUE(mapped.isValid(ents[1]));
+    }
+    std::filesystem::remove(path);
+    EntityManager mapped;
+    ASSERT_THROW(mapped.loadMapped(path), AssertFailed);
+}
+
+static void TestSameState(EntityManager const& mgr, EntityManager const& replica, std::vector<Archetype> const& archs)
+{
+    ASSERT_EQ(replica.size(), mgr.size());
+    for (auto const& arch : archs) {
+        ASSERT_EQ(replica.entitiesOf(arch).data, mgr.entitiesOf(arch).data);
+        for (auto ent : mgr.entitiesOf(arch).data) {
+            ASSERT_EQ(replica.cellOf(ent).poolIdx, mgr.cellOf(ent).poolIdx);
+            ASSERT_EQ(replica.componentOf<TTrivial2>(ent), mgr.componentOf<TTrivial2>(ent));
+            if (arch.has(IdOf<TTrivial1>())) {
+                ASSERT_EQ(replica.componentOf<TTrivial1>(ent), mgr.componentOf<TTrivial1>(ent));
+            }
+        }
+    }
+}
+
+TEST(EntityManager, SaveLoadDelta)
+{
+    std::vector<Archetype> archs = { Archetype(IdOf<TTrivial1, TTrivial2>()), Archetype(IdOfL<TTrivial2>()) };
+    EntityManager mgr;
+    mgr.spawn(archs[0], 10000);
+    std::stringstream snapshot;
+    ASSERT_THROW(mgr.saveDelta(snapshot), AssertFailed); // not tracked
+    mgr.save(snapshot);
+    mgr.trackChanges(true);
+
+    EntityManager replica;
+    replica.load(snapshot);
+
+    std::vector<Entity> ents = mgr.entitiesOf(archs[0]).data;
+    mgr.componentOf<TTrivial1>(ents[5000]).data = { 1, 2, 3 };
+    mgr.destroy(ents[100]);
+    mgr.changeArchetype(ents[200], archs[1]); // new spawner
+    mgr.spawn(archs[0], 10, [](EntityCreator&& cr) { cr.constructed<TTrivial2>().data = { 4, 5, 6 }; });
+
+    std::stringstream delta;
+    mgr.saveDelta(delta);
+    ASSERT_LT(delta.str().size(), snapshot.str().size() / 10);
+    replica.loadDelta(delta);
+    TestSameState(mgr, replica, archs);
+
+    // second delta uses the first one as the baseline
+    Selection<TTrivial1 const, TTrivial2> sel;
+    mgr.updateSelection(sel);
+    sel.forEach([](Entity, TTrivial1 const& c1, TTrivial2& c2) { c2.data = c1.data; });
+    mgr.clear(archs[1]);
+    std::stringstream delta2;
+    mgr.saveDelta(delta2);
+    ASSERT_GT(delta2.str().size(), 10000 * sizeof(TTrivial2)); // every TTrivial2 was accessed
+    ASSERT_LT(delta2.str().size(), 10000 * (sizeof(TTrivial1) + sizeof(TTrivial2)));
+    replica.loadDelta(delta2);
+    TestSameState(mgr, replica, archs);
+
+    std::stringstream delta3; // nothing changed
+    mgr.saveDelta(delta3);
+    ASSERT_LT(delta3.str().size(), 200);
+    replica.loadDelta(delta3);
+    TestSameState(mgr, replica, archs);
+
+    // a few entities modified while iterating a const selection
+    Selection<TTrivial2 const> constSel;
+    mgr.updateSelection(constSel);
+    constSel.forEach([&mgr](Entity ent, TTrivial2 const& c2) {
+        if (c2.data[0] == 1)
+            mgr.componentOf<TTrivial2>(ent).data[1] = 7;
+    });
+    std::stringstream delta4;
+    mgr.saveDelta(delta4);
+    ASSERT_LT(delta4.str().size(), 2000);
+    replica.loadDelta(delta4);
+    TestSameState(mgr, replica, archs);
+    ASSERT_EQ(replica.componentOf<TTrivial2>(ents[5000]).data[1], 7);
+
+    std::stringstream garbage("garbage");
+    ASSERT_THROW(replica.loadDelta(garbage), AssertFailed);
+
+    EntityManager nonTrivial;
+    nonTrivial.spawn(Archetype(IdOfL<TComp1>()));
+    nonTrivial.trackChanges(true);
+    std::stringstream rejected;
+    ASSERT_THROW(nonTrivial.saveDelta(rejected), AssertFailed);
+    ASSERT_TRUE(rejected.str().empty()); // nothing is written
+}
+
+static void SimulationStep(EntityManager& mgr, std::vector<Archetype> const& archs, int step)
+{
+    std::vector<Entity> ents = mgr.entitiesOf(archs[0]).data;
+    mgr.componentOf<TTrivial1>(ents[step * 7 % ents.size()]).data = { step, step, step };
+    mgr.destroy(ents[step * 13 % ents.size()]);
+    if (Entity moved = ents[(step * 13 + 1) % ents.size()]; mgr.isValid(moved))
+        mgr.changeArchetype(moved, archs[1]);
+    mgr.spawn(archs[0], 3, [step](EntityCreator&& cr) { cr.constructed<TTrivial2>().data = { step, 0, 0 }; });
+}
+
+TEST(EntityManager, SnapshotIntoRestoreFrom)
+{
+    std::vector<Archetype> archs = { Archetype(IdOf<TTrivial1, TTrivial2>()), Archetype(IdOfL<TTrivial2>()), Archetype(IdOf<TTrivial2, TComp1>()) };
+    EntityManager mgr;
+    mgr.spawn(archs[0], 1000);
+    WorldFrame frame;
+    ASSERT_TRUE(frame.isEmpty());
+    ASSERT_THROW(mgr.restoreFrom(frame), AssertFailed);
+
+    mgr.snapshotInto(frame);
+    ASSERT_EQ(frame.size(), 1000);
+    std::stringstream saved;
+    mgr.save(saved);
+    SimulationStep(mgr, archs, 1); // creates a spawner that is not in the frame
+    mgr.restoreFrom(frame);
+    EntityManager expected;
+    expected.load(saved);
+    TestSameState(mgr, expected, { archs[0] });
+    ASSERT_EQ(mgr.size(archs[1]), 0);
+
+    EntityManager nonTrivial;
+    nonTrivial.spawn(archs[2]);
+    ASSERT_THROW(nonTrivial.snapshotInto(frame), AssertFailed);
+
+    // rollback with a ring of frames
+    mgr.trackChanges(true);
+    std::vector<WorldFrame> ring(4);
+    std::vector<std::string> states;
+    for (int step = 0; step < 8; ++step) {
+        mgr.snapshotInto(ring[step % 4]);
+        std::stringstream state;
+        mgr.save(state);
+        states.push_back(state.str());
+        SimulationStep(mgr, archs, step);
+    }
+    Entity untracked = mgr.entitiesOf(archs[0]).data[500]; // a modification that bypasses the tracking shows which blocks are copied
+    auto& untrackedComp = const_cast<TTrivial2&>(std::as_const(mgr).componentOf<TTrivial2>(untracked));
+    auto untrackedData = untrackedComp.data;
+    untrackedComp.data = { -1, -1, -1 };
+
+    std::vector<std::reference_wrapper<WorldFrame const>> newer = { ring[6 % 4], ring[7 % 4] };
+    mgr.restoreFrom(ring[5 % 4], newer.begin(), newer.end());
+    ASSERT_EQ(untrackedComp.data, (std::array<int, 3>{ -1, -1, -1 })); // its block was not modified since step 5
+    untrackedComp.data = untrackedData;
+    std::istringstream state5(states[5]);
+    expected.load(state5);
+    TestSameState(mgr, expected, { archs[0], archs[1] });
+
+    SimulationStep(mgr, archs, 100); // the restored frame is the new baseline
+    mgr.restoreFrom(ring[5 % 4]);
+    TestSameState(mgr, expected, { archs[0], archs[1] });
+
+    mgr.restoreFrom(ring[7 % 4]); // not a part of the current chain - copies everything
+    std::istringstream state7(states[7]);
+    expected.load(state7);
+    TestSameState(mgr, expected, { archs[0], archs[1] });
+}
+
+TEST(EntityManager, Checksum)
+{
+    std::vector<Archetype> archs = { Archetype(IdOf<TTrivial1, TTrivial2>()), Archetype(IdOfL<TTrivial2>()), Archetype(IdOf<TTrivial2, TComp1>()) };
+    EntityManager tracked;
+    EntityManager untracked;
+    tracked.trackChanges(true);
+    for (auto* mgr : { &tracked, &untracked }) {
+        mgr->spawn(archs[0], 1000, [](EntityCreator&& cr) { cr.constructed<TTrivial1>().data = { 1, 2, 3 }; });
+        mgr->spawn(archs[1], 100);
+    }
+    ASSERT_EQ(tracked.checksum(), untracked.checksum());
+    ASSERT_EQ(tracked.checksum(), tracked.checksum());
+
+    for (int step = 0; step < 5; ++step) { // incremental rehashing gives the same results as the full one
+        for (auto* mgr : { &tracked, &untracked })
+            SimulationStep(*mgr, archs, step);
+        ASSERT_EQ(tracked.checksum(), untracked.checksum());
+    }
+
+    Entity ent = tracked.entitiesOf(archs[0]).data[500];
+    auto original = tracked.componentOf<TTrivial1>(ent).data;
+    auto beforeChange = tracked.checksum();
+    tracked.componentOf<TTrivial1>(ent).data[1] = 42;
+    ASSERT_NE(tracked.checksum(), untracked.checksum());
+    ASSERT_EQ(tracked.checksum(CMask(IdOfL<TTrivial1>())), untracked.checksum(CMask(IdOfL<TTrivial1>())));
+    tracked.componentOf<TTrivial1>(ent).data = original;
+    ASSERT_EQ(tracked.checksum(), beforeChange);
+
+    std::stringstream delta; // checksum does not move the baseline
+    tracked.saveDelta(delta);
+    ASSERT_GT(delta.str().size(), sizeof(TTrivial1) * DirtyBlocks::BlockSize);
+
+    WorldFrame frame; // restored blocks are rehashed
+    tracked.snapshotInto(frame);
+    ASSERT_EQ(tracked.checksum(), untracked.checksum());
+    tracked.componentOf<TTrivial1>(ent).data[1] = 42;
+    tracked.destroy(tracked.entitiesOf(archs[1]).data[0]); // the restored entities past the end of the pool
+    ASSERT_NE(tracked.checksum(), untracked.checksum());
+    tracked.restoreFrom(frame);
+    ASSERT_EQ(tracked.componentOf<TTrivial1>(ent).data, original);
+    ASSERT_EQ(tracked.checksum(), untracked.checksum());
+
+    tracked.destroy(ent);
+    ASSERT_NE(tracked.checksum(), untracked.checksum());
+
+    untracked.spawn(archs[2]); // non trivially copyable
+    ASSERT_THROW(untracked.checksum(), AssertFailed);
+    ASSERT_NO_THROW(untracked.checksum(CMask(IdOfL<TComp1>())));
+}
+
+static void TestSortedSpawner(EntityManager const& mgr, Archetype const& arch)
+{
+    auto const& ents = mgr.entitiesOf(arch).data;
+    for (std::size_t i = 0; i < ents.size(); ++i) {
+        ASSERT_EQ(mgr.cellOf(ents[i]).poolIdx.value, i);
+        ASSERT_EQ(mgr.componentOf<TComp1>(ents[i]).data, mgr.componentOf<TTrivial1>(ents[i]).data); // components moved together
+        if (i > 0) {
+            ASSERT_LE(mgr.componentOf<TTrivial1>(ents[i - 1]).data[0], mgr.componentOf<TTrivial1>(ents[i]).data[0]);
+        }
+    }
+}
+
+TEST(EntityManager, SortSpawner)
+{
+    Archetype arch(IdOf<TTrivial1, TComp1>());
+    EntityManager mgr;
+    auto key = [](TTrivial1 const& c) { return c.data[0]; };
+    int cnt = 0;
+    auto setKey = [&cnt](EntityCreator&& cr) {
+        int k = (cnt++ * 7919) % 1000;
+        cr.constructed<TTrivial1>().data = { k, cnt, 0 };
+        cr.constructed<TComp1>(TComp1::Arr_t{ k, cnt, 0 });
+    };
+    mgr.spawn(arch, 1000, setKey);
+    Entity first = mgr.entitiesOf(arch).data.front();
+    mgr.sortSpawner<TTrivial1>(arch, key);
+    TestSortedSpawner(mgr, arch);
+    ASSERT_EQ(mgr.componentOf<TTrivial1>(first).data[0], 0);
+
+    std::vector<Entity> ents = mgr.entitiesOf(arch).data;
+    mgr.resortSpawner<TTrivial1>(arch, key); // already sorted
+    ASSERT_EQ(mgr.entitiesOf(arch).data, ents);
+
+    // churn: swap-removes, appended entities and modified keys
+    for (std::size_t i = 0; i < ents.size(); i += 10)
+        mgr.destroy(ents[i]);
+    mgr.spawn(arch, 50, setKey);
+    Entity modified = mgr.entitiesOf(arch).data[300];
+    mgr.componentOf<TTrivial1>(modified).data[0] = mgr.componentOf<TComp1>(modified).data[0] = 999;
+    mgr.resortSpawner<TTrivial1>(arch, key);
+    TestSortedSpawner(mgr, arch);
+    ASSERT_EQ(mgr.size(arch), 950);
+    ASSERT_EQ(mgr.componentOf<TTrivial1>(mgr.entitiesOf(arch).data.back()).data[0], 999);
+
+    mgr.sortSpawner<TTrivial1>(arch, [](TTrivial1 const& c) { return -c.data[1]; });
+    ASSERT_EQ(mgr.componentOf<TTrivial1>(mgr.entitiesOf(arch).data.front()).data[1], cnt);
+    ASSERT_NO_THROW(mgr.sortSpawner<TTrivial1>(Archetype(IdOfL<TTrivial1>()), key)); // no such spawner
+
+    // only the moved entities are marked as modified
+    Archetype trivialArch(IdOf<TTrivial1, TTrivial2>());
+    EntityManager tracked;
+    cnt = 0;
+    tracked.spawn(trivialArch, 10000, [&cnt](EntityCreator&& cr) { cr.constructed<TTrivial1>().data[0] = cnt++; });
+    tracked.trackChanges(true);
+    tracked.destroy(tracked.entitiesOf(trivialArch).data[9000]);
+    tracked.resortSpawner<TTrivial1>(trivialArch, key);
+    auto const& view = tracked; // non-const access would mark the components as modified
+    ASSERT_TRUE(std::is_sorted(view.entitiesOf(trivialArch).data.begin(), view.entitiesOf(trivialArch).data.end(),
+                               [&](Entity l, Entity r) { return view.componentOf<TTrivial1>(l).data[0] < view.componentOf<TTrivial1>(r).data[0]; }));
+    std::stringstream delta;
+    tracked.saveDelta(delta);
+    ASSERT_LT(delta.str().size(), 10000 * (sizeof(TTrivial1) + sizeof(TTrivial2)) / 4); // ~1000 entities shifted by one
+}
+
+TEST(EntityManager, SharedComponents)
+{
+    static_assert(std::is_trivially_copyable_v<Shared<TComp2>>);
+    Archetype arch(IdOf<TTrivial1, Shared<TComp2>>());
+    EntityManager mgr;
+    Shared<TComp2> red = mgr.makeShared<TComp2>(TComp2::Arr_t{ 1, 1, 1 });
+    Shared<TComp2> blue = mgr.makeShared<TComp2>(TComp2::Arr_t{ 2, 2, 2 });
+    ASSERT_NE(red, blue);
+    int cnt = 0;
+    mgr.spawn(arch, 100, [&](EntityCreator&& cr) { cr.constructed<Shared<TComp2>>(cnt++ % 2 ? blue : red); });
+
+    Selection<TTrivial1, Shared<TComp2>> sel;
+    mgr.updateSelection(sel);
+    sel.forEach([](Entity, TTrivial1& c, TComp2 const& material) { c.data = material.data; });
+    for (auto ent : mgr.entitiesOf(arch).data)
+        ASSERT_EQ(mgr.componentOf<TTrivial1>(ent).data, mgr.sharedOf<TComp2>(ent).data);
+
+    // grouping by the shared value
+    mgr.sortSpawner<Shared<TComp2>>(arch, [](Shared<TComp2> handle) { return handle; });
+    auto const& ents = mgr.entitiesOf(arch).data;
+    for (std::size_t i = 0; i < ents.size(); ++i)
+        ASSERT_EQ(mgr.componentOf<Shared<TComp2>>(ents[i]), i < 50 ? red : blue);
+
+    mgr.shared(red).data = { 3, 3, 3 }; // changes the value of the whole group
+    ASSERT_EQ(mgr.sharedOf<TComp2>(ents.front()).data, (TComp2::Arr_t{ 3, 3, 3 }));
+    ASSERT_EQ(std::as_const(mgr).shared(blue).data, (TComp2::Arr_t{ 2, 2, 2 }));
+    ASSERT_NO_THROW(mgr.checksum()); // only the handles are stored by the entities
+
+    TComp2 const& redValue = mgr.shared(red); // new values do not move the existing ones
+    for (int i = 0; i < 100; ++i)
+        mgr.makeShared<TComp2>();
+    ASSERT_EQ(&mgr.shared(red), &redValue);
+
+    Shared<TComp2> unused = mgr.makeShared<TComp2>(TComp2::Arr_t{ 4, 4, 4 });
+    mgr.releaseShared(unused);
+    ASSERT_EQ(mgr.makeShared<TComp2>(TComp2::Arr_t{ 5, 5, 5 }), unused); // the slot is reused
+    ASSERT_EQ(mgr.shared(unused).data, (TComp2::Arr_t{ 5, 5, 5 }));
+    ASSERT_THROW(mgr.releaseShared(blue), AssertFailed); // still used by the entities
+    mgr.clear(arch);
+    ASSERT_NO_THROW(mgr.releaseShared(blue));
+}
+
+struct GameTime {
+    double dt = 0.0;
+    std::uint64_t tick = 0;
+};
+
+TEST(EntityManager, Resources)
+{
+    Archetype arch(IdOfL<TTrivial1>());
+    EntityManager mgr;
+    mgr.spawn(arch, 100);
+    ASSERT_EQ(mgr.findResource<GameTime>(), nullptr);
+    GameTime& time = mgr.addResource<GameTime>(GameTime{ 0.5, 1 });
+    ASSERT_EQ(&mgr.resource<GameTime>(), &time);
+    ASSERT_EQ(mgr.findResource<GameTime>(), &time);
+
+    Selection<TTrivial1> sel;
+    mgr.updateSelection(sel);
+    sel.forEach([&time](Entity, TTrivial1& c) { c.data[0] = int(time.tick); });
+    ASSERT_EQ(mgr.componentOf<TTrivial1>(mgr.entitiesOf(arch).data[42]).data[0], 1);
+
+    // snapshots
+    time.tick = 7;
+    std::stringstream snapshot;
+    mgr.save(snapshot);
+    EntityManager loaded;
+    ASSERT_THROW(loaded.load(snapshot), AssertFailed); // resources have to be added before loading
+    snapshot.seekg(0);
+    loaded.addResource<GameTime>();
+    loaded.load(snapshot);
+    ASSERT_EQ(loaded.resource<GameTime>().tick, 7);
+    ASSERT_EQ(loaded.resource<GameTime>().dt, 0.5);
+    ASSERT_EQ(loaded.size(), 100);
+
+    // frames
+    WorldFrame frame;
+    mgr.snapshotInto(frame);
+    time.tick = 8;
+    mgr.restoreFrom(frame);
+    ASSERT_EQ(time.tick, 7);
+
+    mgr.addResource<std::string>("config"); // non trivially copyable
+    std::stringstream failed;
+    ASSERT_THROW(mgr.save(failed), AssertFailed);
+    mgr.removeResource<std::string>();
+    ASSERT_EQ(mgr.findResource<std::string>(), nullptr);
+    ASSERT_NO_THROW(mgr.save(failed));
+}
+
+TEST(EntityManager, DestroyMany)
+{
+    int alive = TComp1::AliveCounter;
+    {
+        EntityManager mgr;
+        Archetype arch(IdOf<TComp1, TTrivial1>());
+        Archetype other(IdOfL<TTrivial1>());
+        int i = 0;
+        auto numbered = [&i](EntityCreator&& creator) { creator.constructed<TTrivial1>().data[0] = i++; };
+        mgr.spawn(arch, 1000, numbered);
+        mgr.spawn(other, 500, numbered);
+        std::vector<Entity> all = mgr.entitiesOf(arch).data;
+        all.insert(all.end(), mgr.entitiesOf(other).data.begin(), mgr.entitiesOf(other).data.end());
+
+        std::vector<Entity> doomed;
+        for (std::size_t j = 0; j < all.size(); j += 3)
+            doomed.push_back(all[j]);
+        doomed.push_back(all[0]); // duplicate
+        std::reverse(doomed.begin(), doomed.end());
+        mgr.destroy(doomed.begin(), doomed.end());
+
+        ASSERT_EQ(mgr.size(arch), 1000 - 334);
+        ASSERT_EQ(mgr.size(other), 500 - 166);
+        ASSERT_EQ(TComp1::AliveCounter, alive + 1000 - 334);
+        for (std::size_t j = 0; j < all.size(); ++j) {
+            ASSERT_EQ(mgr.isValid(all[j]), j % 3 != 0);
+            if (j % 3 != 0) {
+                ASSERT_EQ(mgr.componentOf<TTrivial1>(all[j]).data[0], int(j));
+            }
+        }
+        mgr.destroy(all.begin(), all.begin()); // empty range
+        ASSERT_EQ(mgr.size(), 1000 - 334 + 500 - 166);
+
+        std::vector<Entity> stale = all;
+        ASSERT_EQ(mgr.eraseInvalid(stale), 334 + 166);
+        ASSERT_EQ(stale.size(), mgr.size());
+        ASSERT_TRUE(std::all_of(stale.begin(), stale.end(), [&mgr](Entity ent) { return mgr.isValid(ent); }));
+    }
+    ASSERT_EQ(TComp1::AliveCounter, alive);
+}
+
+TEST(EntityManager, MarkForDestruction)
+{
+    EntityManager mgr;
+    Archetype arch(IdOf<TComp1, TTrivial1>());
+    Archetype other(IdOfL<TTrivial1>());
+    int i = 0;
+    auto numbered = [&i](EntityCreator&& creator) { creator.constructed<TTrivial1>().data[0] = i++; };
+    mgr.spawn(arch, 1000, numbered);
+    mgr.spawn(other, 500, numbered);
+    std::vector<Entity> all = mgr.entitiesOf(arch).data;
+    all.insert(all.end(), mgr.entitiesOf(other).data.begin(), mgr.entitiesOf(other).data.end());
+
+    Selection<TTrivial1> sel;
+    mgr.updateSelection(sel);
+    int visited = 0;
+    sel.forEach([&](Entity ent, TTrivial1& c) {
+        ++visited;
+        if (c.data[0] % 2 == 0)
+            return IterTimeChange::MarkedCurrent;
+        if (c.data[0] % 10 == 1) { // mixed with the immediate destruction of the current entity
+            mgr.destroy(ent);
+            return IterTimeChange::DestroyedCurrent;
+        }
+        return IterTimeChange::AnyClear;
+    });
+    ASSERT_EQ(visited, 1500);
+    ASSERT_EQ(mgr.size(arch), 400);
+    ASSERT_EQ(mgr.size(other), 200);
+    for (std::size_t j = 0; j < all.size(); ++j) {
+        bool kept = j % 2 != 0 && j % 10 != 1;
+        ASSERT_EQ(mgr.isValid(all[j]), kept);
+        if (kept) {
+            ASSERT_EQ(mgr.componentOf<TTrivial1>(all[j]).data[0], int(j));
+        }
+    }
+}
+
+TEST(EntityManager, QueuedArchetypeChanges)
+{
+    int alive1 = TComp1::AliveCounter;
+    int alive2 = TComp2::AliveCounter;
+    {
+        EntityManager mgr;
+        Archetype arch(IdOf<TComp1, TTrivial1>());
+        Archetype other(IdOfL<TTrivial1>());
+        Archetype target(IdOf<TComp2, TTrivial1>());
+        int i = 0;
+        auto numbered = [&i](EntityCreator&& creator) { creator.constructed<TTrivial1>().data[0] = i++; };
+        mgr.spawn(arch, 1000, numbered);
+        mgr.spawn(other, 500, numbered);
+        std::vector<Entity> all = mgr.entitiesOf(arch).data;
+        all.insert(all.end(), mgr.entitiesOf(other).data.begin(), mgr.entitiesOf(other).data.end());
+
+        for (std::size_t j = 0; j < 1000; j += 2)
+            mgr.queueArchetypeChange(all[j], target);
+        for (std::size_t j = 1000; j < all.size(); j += 5)
+            mgr.queueArchetypeChange(all[j], arch);
+        mgr.queueArchetypeChange(all[1], arch);   // already there
+        mgr.queueArchetypeChange(all[2], target); // twice, to the same archetype
+        mgr.queueArchetypeChange(all[4], target);
+        mgr.destroy(all[4]);
+        ASSERT_EQ(mgr.size(arch), 999);
+        int created = 0;
+        mgr.applyArchetypeChanges([&created](EntityCreator&& creator) {
+            if (creator.getCMask().get(IdOf<TComp2>()))
+                creator.constructed<TComp2>(TComp2::Arr_t{ 7, 7, 7 });
+            ++created;
+        });
+
+        ASSERT_EQ(created, 499 + 100);
+        ASSERT_EQ(mgr.size(arch), 500 + 100);
+        ASSERT_EQ(mgr.size(other), 400);
+        ASSERT_EQ(mgr.size(target), 499);
+        ASSERT_EQ(TComp1::AliveCounter, alive1 + 600);
+        ASSERT_EQ(TComp2::AliveCounter, alive2 + 499);
+        for (std::size_t j = 0; j < all.size(); ++j) {
+            if (j == 4) {
+                ASSERT_FALSE(mgr.isValid(all[j]));
+                continue;
+            }
+            ASSERT_EQ(mgr.componentOf<TTrivial1>(all[j]).data[0], int(j));
+            if (j < 1000 && j % 2 == 0) {
+                ASSERT_EQ(mgr.maskOf(all[j]), target.getMask());
+                ASSERT_EQ(mgr.componentOf<TComp2>(all[j]).data[0], 7);
+            }
+            else if (j < 1000 || (j - 1000) % 5 == 0) {
+                ASSERT_EQ(mgr.maskOf(all[j]), arch.getMask());
+            }
+            else {
+                ASSERT_EQ(mgr.maskOf(all[j]), other.getMask());
+            }
+        }
+        mgr.applyArchetypeChanges(); // nothing queued
+        ASSERT_EQ(mgr.size(), 1499);
+    }
+    ASSERT_EQ(TComp1::AliveCounter, alive1);
+    ASSERT_EQ(TComp2::AliveCounter, alive2);
+}
+
+TEST(EntityManager, QueuedArchetypeChangesConflicts)
+{
+    EntityManager mgr;
+    Archetype first(IdOfL<TTrivial1>());
+    Archetype second(IdOf<TTrivial1, TTrivial2>());
+    Archetype third(IdOf<TTrivial1, TComp4>());
+    std::vector<Entity> ents;
+    for (int i = 0; i < 6; ++i)
+        ents.push_back(mgr.spawn(first, [i](EntityCreator&& creator) { creator.constructed<TTrivial1>().data[0] = i; }));
+    mgr.spawn(second);
+    mgr.spawn(third); // spawners exist, so the destinations have ids in the order first < second < third
+
+    // the last queued change wins, no matter the order of the destination spawners
+    mgr.queueArchetypeChange(ents[0], second);
+    mgr.queueArchetypeChange(ents[0], third);
+    mgr.queueArchetypeChange(ents[1], third);
+    mgr.queueArchetypeChange(ents[1], second);
+    mgr.queueArchetypeChange(ents[2], third);
+    mgr.queueArchetypeChange(ents[2], first); // back to where it is - not moved
+    mgr.queueArchetypeChange(ents[3], second);
+    mgr.queueArchetypeChange(ents[4], third);
+    mgr.queueArchetypeChange(ents[3], third);
+    mgr.queueArchetypeChange(ents[4], second);
+    mgr.queueArchetypeChange(ents[3], second);
+    mgr.applyArchetypeChanges();
+
+    ASSERT_EQ(mgr.maskOf(ents[0]), third.getMask());
+    ASSERT_EQ(mgr.maskOf(ents[1]), second.getMask());
+    ASSERT_EQ(mgr.maskOf(ents[2]), first.getMask());
+    ASSERT_EQ(mgr.maskOf(ents[3]), second.getMask());
+    ASSERT_EQ(mgr.maskOf(ents[4]), second.getMask());
+    ASSERT_EQ(mgr.maskOf(ents[5]), first.getMask());
+    ASSERT_EQ(mgr.size(first), 2);
+    ASSERT_EQ(mgr.size(second), 4);
+    ASSERT_EQ(mgr.size(third), 2);
+    for (int i = 0; i < 6; ++i)
+        ASSERT_EQ(mgr.componentOf<TTrivial1>(ents[i]).data[0], i);
+}
+
+TEST(EntityManager, Instantiate)
+{
+    int alive = TComp1::AliveCounter;
+    {
+        EntityManager mgr;
+        Archetype arch(IdOf<TComp1, TTrivial1>());
+        mgr.spawn(arch, 10);
+        Entity prototype = mgr.spawn(arch, [](EntityCreator&& creator) {
+            creator.constructed<TComp1>(TComp1::Arr_t{ 1, 2, 3 });
+            creator.constructed<TTrivial1>().data = { 4, 5, 6 };
+        });
+        auto [first, last] = mgr.instantiate(prototype, 1000);
+        ASSERT_EQ(last - first, 1000);
+        ASSERT_EQ(mgr.size(arch), 1011);
+        ASSERT_EQ(TComp1::AliveCounter, alive + 1011);
+        std::vector<Entity> copies(first, last);
+        for (Entity ent : copies) {
+            ASSERT_TRUE(mgr.isValid(ent));
+            ASSERT_NE(ent, prototype);
+            ASSERT_EQ(mgr.componentOf<TComp1>(ent), TComp1(TComp1::Arr_t{ 1, 2, 3 }));
+            ASSERT_EQ(mgr.componentOf<TTrivial1>(ent).data, (std::array<int, 3>{ 4, 5, 6 }));
+        }
+        mgr.componentOf<TTrivial1>(copies[0]).data[0] = 0; // copies are independent
+        ASSERT_EQ(mgr.componentOf<TTrivial1>(copies[1]).data[0], 4);
+        ASSERT_EQ(mgr.componentOf<TTrivial1>(prototype).data[0], 4);
+
+        auto [none, noneEnd] = mgr.instantiate(prototype, 0);
+        ASSERT_EQ(none, noneEnd);
+
+        Archetype nonCopyable(IdOf<TTrivial1, TMoveOnly>()); // the first pool could be copied
+        Entity ent = mgr.spawn(nonCopyable, [](EntityCreator&& creator) { creator.constructed<TTrivial1>().data = { 99, 0, 0 }; });
+        ASSERT_THROW(mgr.instantiate(ent, 5), AssertFailed);
+        ASSERT_EQ(mgr.size(nonCopyable), 1);
+        Entity other = mgr.spawn(nonCopyable, [](EntityCreator&& creator) { creator.constructed<TTrivial1>().data = { 7, 0, 0 }; });
+        mgr.destroy(ent); // moves the last components in place of ent's
+        ASSERT_EQ(mgr.componentOf<TTrivial1>(other).data[0], 7);
+        ASSERT_EQ(mgr.componentOf<TMoveOnly>(other).x, 0);
+    }
+    ASSERT_EQ(TComp1::AliveCounter, alive);
+}
+
+TEST(EntityManager, ComponentsOf)
+{
+    EntityManager mgr;
+    Archetype arch(IdOf<TComp1, TComp2, TTrivial1>());
+    Archetype other(IdOf<TComp2, TTrivial1>());
+    mgr.spawn(arch, 10);
+    Entity ent = mgr.spawn(arch, [](EntityCreator&& creator) {
+        creator.constructed<TComp2>(TComp2::Arr_t{ 1, 2, 3 });
+        creator.constructed<TTrivial1>().data = { 4, 5, 6 };
+    });
+
+    auto [comp2, trivial] = mgr.componentsOf<TComp2, TTrivial1 const>(ent);
+    ASSERT_EQ(&comp2, &mgr.componentOf<TComp2>(ent));
+    ASSERT_EQ(&trivial, &mgr.componentOf<TTrivial1>(ent));
+    ASSERT_EQ(trivial.data[2], 6);
+    auto const& cmgr = mgr;
+    ASSERT_EQ(&std::get<0>(cmgr.componentsOf<TComp1, TComp2>(ent)), &mgr.componentOf<TComp1>(ent));
+
+    auto ref = mgr.refOf<TComp2, TTrivial1>(ent);
+    ASSERT_TRUE(ref.isValid());
+    ASSERT_EQ(ref.getEntity(), ent);
+    ASSERT_EQ(ref.get<TComp2>().data[0], 1);
+    std::get<1>(ref.get()).data[0] = 7;
+    ASSERT_EQ(mgr.componentOf<TTrivial1>(ent).data[0], 7);
+
+    mgr.destroy(*mgr.entitiesOf(arch).data.begin()); // ent is moved within the spawner
+    ASSERT_EQ(&ref.get<TTrivial1>(), &mgr.componentOf<TTrivial1>(ent));
+    mgr.changeArchetype(ent, other); // pools are looked up again
+    ASSERT_EQ(&ref.get<TComp2>(), &mgr.componentOf<TComp2>(ent));
+    ASSERT_EQ(ref.get<TTrivial1>().data, (std::array<int, 3>{ 7, 5, 6 }));
+    mgr.destroy(ent);
+    ASSERT_FALSE(ref.isValid());
+    ASSERT_FALSE(EntityRef<TComp1>().isValid());
+}
+
+TEST(EntityManager, Gather)
+{
+    EntityManager mgr;
+    Archetype arch(IdOf<TComp1, TTrivial1>());
+    Archetype other(IdOfL<TTrivial1>());
+    int i = 0;
+    auto numbered = [&i](EntityCreator&& creator) { creator.constructed<TTrivial1>().data[0] = i++; };
+    mgr.spawn(arch, 300, numbered);
+    mgr.spawn(other, 300, numbered);
+    std::vector<Entity> ents = mgr.entitiesOf(arch).data;
+    ents.insert(ents.end(), mgr.entitiesOf(other).data.begin(), mgr.entitiesOf(other).data.end());
+    std::mt19937 gen(7);
+    std::shuffle(ents.begin(), ents.end(), gen);
+    ents.push_back(ents[0]); // duplicate
+
+    std::vector<Entity> visited;
+    mgr.gather<TTrivial1>(ents.data(), ents.size(), [&](Entity ent, TTrivial1& comp) {
+        ASSERT_EQ(&comp, &mgr.componentOf<TTrivial1>(ent));
+        comp.data[1] += 1;
+        visited.push_back(ent);
+    });
+    ASSERT_EQ(visited, ents);
+    ASSERT_EQ(mgr.componentOf<TTrivial1>(ents[0]).data[1], 2);
+    ASSERT_EQ(mgr.componentOf<TTrivial1>(ents[1]).data[1], 1);
+
+    visited.clear();
+    mgr.gather<TTrivial1 const>(ents.data(), ents.size(), [&](Entity ent, TTrivial1 const& comp) {
+        ASSERT_EQ(&comp, &mgr.componentOf<TTrivial1>(ent));
+        visited.push_back(ent);
+    }, true);
+    ASSERT_EQ(visited.size(), ents.size());
+    for (std::size_t j = 1; j < visited.size(); ++j) { // sorted by location
+        auto prev = mgr.cellOf(visited[j - 1]), cur = mgr.cellOf(visited[j]);
+        ASSERT_TRUE(prev.spawnerId < cur.spawnerId || (prev.spawnerId == cur.spawnerId && prev.poolIdx <= cur.poolIdx));
+    }
+
+    std::vector<Entity> withComp1;
+    std::copy_if(ents.begin(), ents.end(), std::back_inserter(withComp1), [&](Entity ent) { return mgr.maskOf(ent).get(IdOf<TComp1>()); });
+    int sum = 0;
+    mgr.gather<TComp1 const, TTrivial1 const>(withComp1.data(), withComp1.size(), [&](Entity, TComp1 const&, TTrivial1 const& trivial) { sum += trivial.data[0]; });
+    ASSERT_EQ(sum, 299 * 300 / 2 + (mgr.componentOf<TTrivial1>(ents[0]).data[0] < 300 ? mgr.componentOf<TTrivial1>(ents[0]).data[0] : 0));
+    mgr.gather<TTrivial1>(ents.data(), 0, [](Entity, TTrivial1&) { FAIL(); });
+}
+
+TEST(EntityManager, MemoryResource)
+{
+    std::pmr::monotonic_buffer_resource arena; // a level arena
+    CountingResource counter(&arena);
+    {
+        EntityManager mgr(&counter);
+        ASSERT_EQ(mgr.getMemoryResource(), &counter);
+        ASSERT_EQ(counter.allocations(), 1); // the list of entities
+        Archetype arch(IdOf<TComp1, TTrivial1>());
+        Archetype other(IdOfL<TComp1>());
+        mgr.spawn(arch, 1000);
+        mgr.spawn(other, 1000);
+        ASSERT_GT(counter.allocations(), 1);
+
+        // steady state - destroyed entities make room for the new ones
+        counter.resetCounts();
+        for (int frame = 0; frame < 10; ++frame) {
+            for (std::size_t i = 0; i < 100; ++i)
+                mgr.destroy(mgr.entitiesOf(arch).data[i * 5]);
+            mgr.spawn(arch, 100);
+            mgr.changeArchetype(mgr.entitiesOf(arch).data[0], other);
+            mgr.changeArchetype(mgr.entitiesOf(other).data[0], arch);
+        }
+        ASSERT_EQ(counter.allocations(), 0);
+        ASSERT_EQ(counter.deallocations(), 0);
+
+        // the tracked changes, the cached hashes and the indices use the resource too, not the default one
+        CountingResource fallback;
+        std::pmr::memory_resource* prevDefault = std::pmr::set_default_resource(&fallback);
+        mgr.trackChanges(true);
+        mgr.addIndex<TTrivial1>([](TTrivial1 const& comp) { return comp.data[0]; });
+        mgr.componentOf<TTrivial1>(mgr.entitiesOf(arch).data[0]).data[0] = 1;
+        mgr.checksum(CMask(IdOfL<TComp1>())); // only the trivially copyable components can be hashed
+        std::pmr::set_default_resource(prevDefault);
+        ASSERT_EQ(fallback.allocations(), 0);
+        ASSERT_GT(counter.allocations(), 0);
+    }
+    ASSERT_EQ(counter.bytesInUse(), 0); // everything allocated from the resource was returned
+}
+
+TEST(EntityManager, ReserveVirtual)
+{
+    EntityManager mgr;
+    Archetype arch(IdOf<TComp1, TTrivial1>());
+    Entity ent = mgr.spawn(arch);
+    mgr.reserveVirtual(arch, 100000);
+    ASSERT_LT(mgr.entitiesOf(arch).data.capacity(), 100000); // nothing is committed up front
+    TTrivial1* kept = &mgr.componentOf<TTrivial1>(ent); // raw pointers survive growth
+    mgr.spawn(arch, 50000);
+    ASSERT_EQ(&mgr.componentOf<TTrivial1>(ent), kept);
+    ASSERT_THROW(mgr.spawn(arch, 50000), AssertFailed);
+}
+
 // TEST(EntityManager, ChangeArchetypeOfWholeSpawner)
 // {
 //     EntityManager mgr;
@@ -0,0 +1,135 @@
+#include "ComponentsT.h"
+#include <ECSpp/EntityManager.h>
+#include <gtest/gtest.h>
+
+using namespace epp;
+
+TEST(Hierarchy, Order)
+{
+    EntityList entList;
+    std::vector<Entity> ents;
+    for (int i = 0; i < 8; ++i)
+        ents.push_back(entList.allocEntity(PoolIdx(i), SpawnerId(0)));
+    Hierarchy hierarchy;
+    hierarchy.setParent(ents[5], ents[2], entList);
+    hierarchy.setParent(ents[1], ents[2], entList);
+    hierarchy.setParent(ents[0], ents[5], entList);
+    hierarchy.setParent(ents[7], ents[6], entList);
+    ASSERT_THROW(hierarchy.setParent(ents[2], ents[0], entList), AssertFailed); // cycle
+    ASSERT_THROW(hierarchy.setParent(ents[2], ents[2], entList), AssertFailed);
+    ASSERT_EQ(hierarchy.parentOf(ents[0], entList), ents[5]);
+    ASSERT_EQ(hierarchy.parentOf(ents[2], entList), Entity());
+    ASSERT_TRUE(hierarchy.isDirty());
+
+    hierarchy.rebuild(entList);
+    ASSERT_FALSE(hierarchy.isDirty());
+    auto const& order = hierarchy.getOrder();
+    ASSERT_EQ(order.size(), 6);
+    std::vector<Entity> expected = { ents[2], ents[6], ents[1], ents[5], ents[7], ents[0] }; // by depth, children grouped
+    for (std::size_t i = 0; i < order.size(); ++i) {
+        ASSERT_EQ(order[i].entity, expected[i]);
+        if (order[i].parentPos == Hierarchy::BadPos)
+            ASSERT_EQ(hierarchy.parentOf(order[i].entity, entList), Entity());
+        else
+            ASSERT_EQ(order[order[i].parentPos].entity, hierarchy.parentOf(order[i].entity, entList));
+    }
+    ASSERT_EQ(hierarchy.getDepthBegins(), (std::vector<std::size_t>{ 0, 2, 5, 6 }));
+
+    entList.freeEntity(ents[5]); // children of a destroyed entity become roots
+    hierarchy.markDirty();
+    hierarchy.rebuild(entList);
+    ASSERT_EQ(hierarchy.parentOf(ents[0], entList), Entity());
+    ASSERT_EQ(order.size(), 4); // 2, 6 -> 1, 7
+    hierarchy.setParent(ents[1], Entity(), entList); // detach
+    hierarchy.rebuild(entList);
+    ASSERT_EQ(order.size(), 2);
+}
+
+TEST(Hierarchy, ForEachHierarchy)
+{
+    EntityManager mgr;
+    Archetype arch(IdOf<TTrivial1, TTrivial2>());
+    Archetype other(IdOfL<TTrivial1>());
+    Archetype noTransform(IdOfL<TTrivial2>());
+    // data[0] - global value, data[1] - local value
+    int local = 0;
+    auto [begin, end] = mgr.spawn(arch, 100, [&local](EntityCreator&& cr) { cr.constructed<TTrivial1>().data = { 0, ++local, 0 }; });
+    std::vector<Entity> ents(begin, end);
+    Entity otherEnt = mgr.spawn(other, [](EntityCreator&& cr) { cr.constructed<TTrivial1>().data = { 0, 1000, 0 }; });
+    Entity noTransformEnt = mgr.spawn(noTransform);
+
+    // a chain 90 <- 50 <- 10 <- otherEnt, and 90 <- noTransformEnt <- 20
+    mgr.setParent(ents[50], ents[90]);
+    mgr.setParent(ents[10], ents[50]);
+    mgr.setParent(otherEnt, ents[10]);
+    mgr.setParent(noTransformEnt, ents[90]);
+    mgr.setParent(ents[20], noTransformEnt);
+    ASSERT_EQ(mgr.parentOf(ents[10]), ents[50]);
+
+    auto propagate = [](Entity, TTrivial1 const& parent, TTrivial1& child) { child.data[0] = parent.data[0] + child.data[1]; };
+    mgr.componentOf<TTrivial1>(ents[90]).data[0] = 91;
+    mgr.forEachHierarchy<TTrivial1>(propagate);
+    ASSERT_EQ(mgr.componentOf<TTrivial1>(ents[50]).data[0], 91 + 51);
+    ASSERT_EQ(mgr.componentOf<TTrivial1>(ents[10]).data[0], 91 + 51 + 11);
+    ASSERT_EQ(mgr.componentOf<TTrivial1>(otherEnt).data[0], 91 + 51 + 11 + 1000);
+    ASSERT_EQ(mgr.componentOf<TTrivial1>(ents[20]).data[0], 0); // parent has no TTrivial1
+
+    // entities of the hierarchy are stored breadth-first in the slots they occupied
+    ASSERT_LT(mgr.cellOf(ents[90]).poolIdx, mgr.cellOf(ents[50]).poolIdx);
+    ASSERT_LT(mgr.cellOf(ents[50]).poolIdx, mgr.cellOf(ents[10]).poolIdx);
+    ASSERT_EQ(mgr.cellOf(ents[90]).poolIdx.value, 10);
+    ASSERT_EQ(mgr.cellOf(ents[30]).poolIdx.value, 30); // not a part of the hierarchy
+    for (std::size_t i = 0; i < ents.size(); ++i)
+        ASSERT_EQ(mgr.componentOf<TTrivial1>(ents[i]).data[1], int(i) + 1); // components moved with their entities
+
+    mgr.destroy(ents[50]); // 10 becomes a root
+    mgr.componentOf<TTrivial1>(ents[90]).data[0] = 0;
+    mgr.forEachHierarchy<TTrivial1>(propagate);
+    ASSERT_EQ(mgr.parentOf(ents[10]), Entity());
+    ASSERT_EQ(mgr.componentOf<TTrivial1>(ents[10]).data[0], 91 + 51 + 11);
+    ASSERT_EQ(mgr.componentOf<TTrivial1>(otherEnt).data[0], 91 + 51 + 11 + 1000);
+    mgr.componentOf<TTrivial1>(ents[10]).data[0] = 5;
+    mgr.forEachHierarchy<TTrivial1>(propagate);
+    ASSERT_EQ(mgr.componentOf<TTrivial1>(otherEnt).data[0], 1005);
+}
+
+TEST(Hierarchy, ForEachHierarchyParallel)
+{
+    EntityManager mgr;
+    Archetype arch(IdOfL<TTrivial1>());
+    int local = 0;
+    auto [begin, end] = mgr.spawn(arch, 7001, [&local](EntityCreator&& cr) { cr.constructed<TTrivial1>().data = { 0, ++local, 0 }; });
+    std::vector<Entity> ents(begin, end);
+    // root 0, 3000 children at depth 1 and 4000 grandchildren at depth 2 - many chunks per depth
+    for (std::size_t i = 1; i <= 3000; ++i)
+        mgr.setParent(ents[i], ents[0]);
+    for (std::size_t i = 3001; i < ents.size(); ++i)
+        mgr.setParent(ents[i], ents[1 + (i * 7) % 3000]);
+
+    auto propagate = [](Entity, TTrivial1 const& parent, TTrivial1& child) { child.data[0] = parent.data[0] + child.data[1]; };
+    auto expected = [&](std::size_t i) {
+        if (i == 0)
+            return 0;
+        if (i <= 3000)
+            return int(i) + 1;
+        std::size_t parent = 1 + (i * 7) % 3000;
+        return int(parent) + 1 + int(i) + 1;
+    };
+    ThreadPool pool(4);
+    mgr.forEachHierarchy<TTrivial1>(propagate, pool);
+    for (std::size_t i = 0; i < ents.size(); ++i)
+        ASSERT_EQ(mgr.componentOf<TTrivial1>(ents[i]).data[0], expected(i));
+
+    mgr.destroy(ents[1]); // its children become roots, found stale by the pass
+    for (std::size_t i = 0; i < ents.size(); ++i)
+        if (mgr.isValid(ents[i]))
+            mgr.componentOf<TTrivial1>(ents[i]).data[0] = -1;
+    mgr.forEachHierarchy<TTrivial1>(propagate, pool, 3);
+    mgr.forEachHierarchy<TTrivial1>(propagate, pool, 3);
+    for (std::size_t i = 2; i <= 3000; ++i)
+        ASSERT_EQ(mgr.componentOf<TTrivial1>(ents[i]).data[0], -1 + int(i) + 1);
+    for (std::size_t i = 3001; i < ents.size(); ++i) {
+        std::size_t parent = 1 + (i * 7) % 3000;
+        ASSERT_EQ(mgr.componentOf<TTrivial1>(ents[i]).data[0], parent == 1 ? -1 : int(parent) + int(i) + 1);
+    }
+}
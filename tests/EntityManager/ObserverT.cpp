@@ -0,0 +1,179 @@
+#include "ComponentsT.h"
+#include <ECSpp/EntityManager.h>
+#include <gtest/gtest.h>
+#include <memory>
+
+using namespace epp;
+
+struct EventsLog {
+    Observer::Callback_t callback() { return [this](EntityEvents_t const& events) { ++batches; log.insert(log.end(), events.begin(), events.end()); }; }
+
+    std::size_t count(EntityEvent::Type type) const
+    {
+        return std::count_if(log.begin(), log.end(), [type](EntityEvent const& event) { return event.type == type; });
+    }
+
+    EntityEvents_t log;
+    std::size_t batches = 0;
+};
+
+
+TEST(Observer, MeetsRequirements)
+{
+    Observer observer(CMask(IdOf<TComp1, TComp2>()), CMask(IdOf<TComp2, TComp3>()), [](EntityEvents_t const&) {});
+    ASSERT_EQ(observer.getWanted(), CMask(IdOf<TComp1, TComp2>()));
+    ASSERT_EQ(observer.getUnwanted(), CMask(IdOfL<TComp3>()));
+    ASSERT_TRUE(observer.meetsRequirements(CMask(IdOf<TComp1, TComp2>())));
+    ASSERT_TRUE(observer.meetsRequirements(CMask(IdOf<TComp1, TComp2, TComp4>())));
+    ASSERT_FALSE(observer.meetsRequirements(CMask(IdOf<TComp1, TComp2, TComp3>())));
+    ASSERT_FALSE(observer.meetsRequirements(CMask(IdOfL<TComp1>())));
+
+    observer.deactivate();
+    ASSERT_FALSE(observer.isActive());
+    ASSERT_FALSE(observer.meetsRequirements(CMask(IdOf<TComp1, TComp2>())));
+}
+
+TEST(Observer, CreationDestruction)
+{
+    EntityManager mgr;
+    Archetype observedArch(IdOf<TComp1, TComp2>());
+    Archetype otherArch(IdOfL<TComp3>());
+    EventsLog events;
+    mgr.observe(CMask(IdOfL<TComp1>()), events.callback());
+
+    mgr.spawn(otherArch, 10);
+    auto [begin, end] = mgr.spawn(observedArch, 100);
+    std::vector<Entity> ents(begin, end);
+    ASSERT_EQ(events.log.size(), 0); // nothing is delivered before notifyObservers
+
+    mgr.notifyObservers();
+    ASSERT_EQ(events.batches, 1);
+    ASSERT_EQ(events.log.size(), 100);
+    for (std::size_t i = 0; i < ents.size(); ++i) {
+        ASSERT_EQ(events.log[i].type, EntityEvent::Type::Creation);
+        ASSERT_EQ(events.log[i].entity, ents[i]);
+    }
+
+    mgr.notifyObservers(); // queues are cleared
+    ASSERT_EQ(events.batches, 1);
+
+    events.log.clear();
+    mgr.destroy(ents[5]);
+    mgr.clear(otherArch);
+    mgr.clear(observedArch);
+    mgr.notifyObservers();
+    ASSERT_EQ(events.count(EntityEvent::Type::Destruction), 100);
+    ASSERT_EQ(events.log.front().entity, ents[5]);
+    ASSERT_FALSE(mgr.isValid(events.log.front().entity));
+}
+
+TEST(Observer, ArrivalDeparture)
+{
+    EntityManager mgr;
+    Archetype arch1(IdOfL<TComp1>());
+    Archetype arch12(IdOf<TComp1, TComp2>());
+    Archetype arch3(IdOfL<TComp3>());
+    EventsLog events1;
+    EventsLog events2;
+    mgr.observe(CMask(IdOfL<TComp1>()), events1.callback());
+    mgr.observe(CMask(IdOfL<TComp2>()), events2.callback());
+
+    Entity ent = mgr.spawn(arch1);
+    mgr.changeArchetype(ent, arch12); // TComp2 added
+    mgr.notifyObservers();
+    ASSERT_EQ(events1.log.size(), 1); // moving between two observed spawners is not reported
+    ASSERT_EQ(events1.log[0].type, EntityEvent::Type::Creation);
+    ASSERT_EQ(events2.log.size(), 1);
+    ASSERT_EQ(events2.log[0].type, EntityEvent::Type::Arrival);
+    ASSERT_EQ(events2.log[0].entity, ent);
+    ASSERT_EQ(events2.log[0].otherSpawnerId, mgr.cellOf(mgr.spawn(arch1)).spawnerId);
+
+    events1.log.clear();
+    events2.log.clear();
+    mgr.changeArchetype(ent, arch3); // TComp1 and TComp2 removed
+    mgr.notifyObservers();
+    ASSERT_EQ(events1.count(EntityEvent::Type::Creation), 1); // spawned above
+    ASSERT_EQ(events1.count(EntityEvent::Type::Departure), 1);
+    ASSERT_EQ(events2.log.size(), 1);
+    ASSERT_EQ(events2.log[0].type, EntityEvent::Type::Departure);
+    ASSERT_EQ(events2.log[0].otherSpawnerId, mgr.cellOf(ent).spawnerId);
+}
+
+TEST(Observer, RemoveObserver)
+{
+    EntityManager mgr;
+    Archetype arch(IdOfL<TComp1>());
+    EventsLog events;
+    ObserverId id = mgr.observe(CMask(IdOfL<TComp1>()), events.callback());
+    mgr.spawn(arch, 10);
+    mgr.removeObserver(id);
+    ASSERT_THROW(mgr.removeObserver(id), AssertFailed);
+    ASSERT_THROW(mgr.removeObserver(ObserverId(5)), AssertFailed);
+
+    mgr.spawn(arch, 10);
+    mgr.notifyObservers();
+    ASSERT_EQ(events.log.size(), 0);
+    ASSERT_EQ(events.batches, 0);
+}
+
+TEST(Observer, SpawnInCallback)
+{
+    EntityManager mgr;
+    Archetype arch(IdOfL<TComp1>());
+    EventsLog events;
+    mgr.observe(CMask(IdOfL<TComp1>()), events.callback());
+    mgr.observe(CMask(IdOfL<TComp1>()), [&](EntityEvents_t const& batch) {
+        for (std::size_t i = 0; i < batch.size(); ++i)
+            mgr.spawn(arch);
+    });
+
+    mgr.spawn(arch, 10);
+    mgr.notifyObservers(); // spawned in the callback - delivered on the next call
+    ASSERT_EQ(events.log.size(), 10);
+    mgr.notifyObservers();
+    ASSERT_EQ(events.log.size(), 20);
+}
+
+TEST(Observer, RemoveInCallback)
+{
+    EntityManager mgr;
+    Archetype arch(IdOfL<TComp1>());
+    auto calls = std::make_shared<int>(0); // owned by the callback
+    ObserverId id;
+    id = mgr.observe(CMask(IdOfL<TComp1>()), [&mgr, &id, calls](EntityEvents_t const&) {
+        mgr.removeObserver(id);
+        ++*calls; // the callback is still alive after removing its observer
+    });
+    mgr.spawn(arch, 10);
+    mgr.notifyObservers();
+    ASSERT_EQ(*calls, 1);
+    ASSERT_EQ(calls.use_count(), 1); // released after the notification
+
+    mgr.spawn(arch, 10);
+    mgr.notifyObservers();
+    ASSERT_EQ(*calls, 1);
+}
+
+TEST(Observer, NestedNotify)
+{
+    EntityManager mgr;
+    Archetype arch(IdOfL<TComp1>());
+    Archetype other(IdOfL<TComp2>());
+    EventsLog outer;
+    EventsLog inner;
+    mgr.observe(CMask(IdOfL<TComp1>()), [&, log = outer.callback()](EntityEvents_t const& batch) {
+        mgr.spawn(other, 3);
+        mgr.notifyObservers(); // delivers the events of other, the outer batch stays intact
+        log(batch);
+    });
+    mgr.observe(CMask(IdOfL<TComp2>()), inner.callback());
+
+    auto [first, last] = mgr.spawn(arch, 5);
+    std::vector<Entity> spawned(first, last);
+    mgr.notifyObservers();
+    ASSERT_EQ(outer.log.size(), 5);
+    for (std::size_t i = 0; i < spawned.size(); ++i)
+        ASSERT_EQ(outer.log[i].entity, spawned[i]);
+    ASSERT_EQ(inner.log.size(), 3);
+    ASSERT_EQ(inner.count(EntityEvent::Type::Creation), 3);
+}
\ No newline at end of file
@@ -1,6 +1,10 @@
 #include "ComponentsT.h"
 #include <ECSpp/EntityManager.h>
+#include <algorithm>
+#include <functional>
 #include <gtest/gtest.h>
+#include <stdexcept>
+#include <utility>
 
 using namespace epp;
 
@@ -119,4 +123,123 @@ TEST(Selection, Empty)
     });
 }
 
+TEST(Selection, Reduce)
+{
+    EntityManager mgr;
+    Selection<TTrivial1 const> sel;
+    Archetype arch[] = { Archetype(IdOfL<TTrivial1>()),
+                         Archetype(IdOf<TTrivial1, TTrivial2>()),
+                         Archetype(IdOfL<TTrivial2>()) };
+    int n = 0;
+    auto fn = [&n](EntityCreator&& creator) {
+        if (creator.getCMask().get(IdOf<TTrivial1>()))
+            creator.constructed<TTrivial1>().data = { n, -n, n % 7 };
+        ++n;
+    };
+    mgr.spawn(arch[0], 10000, fn);
+    mgr.spawn(arch[1], 5000, fn);
+    mgr.spawn(arch[2], 1000, fn);
+    mgr.updateSelection(sel);
+
+    std::int64_t sum = sel.transformReduce(
+        std::int64_t(0), [](Entity, TTrivial1 const& c) { return std::int64_t(c.data[0]); }, std::plus<>());
+    ASSERT_EQ(sum, std::int64_t(14999) * 15000 / 2);
+
+    using Bounds_t = std::pair<int, int>;
+    auto bounds = sel.reduce(
+        Bounds_t(0, 0), [](Bounds_t& acc, Entity, TTrivial1 const& c) { acc.first = std::min(acc.first, c.data[1]); acc.second = std::max(acc.second, c.data[2]); },
+        [](Bounds_t lhs, Bounds_t rhs) { return Bounds_t(std::min(lhs.first, rhs.first), std::max(lhs.second, rhs.second)); });
+    ASSERT_EQ(bounds, Bounds_t(-14999, 6));
+
+    std::size_t count = sel.transformReduce(
+        std::size_t(0), [](Entity, TTrivial1 const& c) { return std::size_t(c.data[2] == 0); }, std::plus<>(), 3);
+    ASSERT_EQ(count, 15000 / 7 + 1);
+
+    // the order of combining does not depend on the number of threads
+    auto inverse = [](Entity, TTrivial1 const& c) { return 1.f / float(c.data[0] + 1); };
+    float single = sel.transformReduce(0.f, inverse, std::plus<>(), 1);
+    for (std::size_t threads : { 2, 3, 8 })
+        ASSERT_EQ(sel.transformReduce(0.f, inverse, std::plus<>(), threads), single);
+
+    ASSERT_THROW(sel.transformReduce(
+                     0, [](Entity, TTrivial1 const& c) -> int { if (c.data[0] == 12345) throw std::runtime_error("stop"); return 0; }, std::plus<>(), 4),
+                 std::runtime_error);
+
+    // a given pool is reused between the calls, a reduce called from a chunk runs on its thread only
+    ThreadPool pool(4);
+    for (int i = 0; i < 3; ++i)
+        ASSERT_EQ(sel.transformReduce(0.f, inverse, std::plus<>(), 0, pool), single);
+    auto countAll = [&]() { return sel.transformReduce(std::size_t(0), [](Entity, TTrivial1 const&) { return std::size_t(1); }, std::plus<>(), 0, pool); };
+    std::size_t nested = sel.transformReduce(
+        std::size_t(0), [&](Entity, TTrivial1 const& c) { return c.data[0] % 5000 == 0 ? countAll() : std::size_t(0); }, std::plus<>(), 0, pool);
+    ASSERT_EQ(nested, 3 * 15000);
+
+    Selection<TTrivial1, TComp4> none;
+    mgr.updateSelection(none);
+    ASSERT_EQ(none.transformReduce(5, [](Entity, TTrivial1&, TComp4&) { return 1; }, std::plus<>()), 5);
+}
+
+TEST(Selection, Iterators)
+{
+    EntityManager mgr;
+    Selection<TTrivial1, TTrivial2 const> sel;
+    Archetype arch[] = { Archetype(IdOf<TTrivial1, TTrivial2>()),
+                         Archetype(IdOf<TTrivial1, TTrivial2, TComp1>()),
+                         Archetype(IdOf<TTrivial1, TTrivial2, TComp2>()),
+                         Archetype(IdOf<TTrivial1, TTrivial2, TComp3>()) };
+    int n = 0;
+    auto fn = [&n](EntityCreator&& creator) {
+        creator.constructed<TTrivial1>().data = { n, 0, 0 };
+        creator.constructed<TTrivial2>().data = { -n, 0, 0 };
+        ++n;
+    };
+    mgr.spawn(arch[0], 100, fn);
+    mgr.prepareToSpawn(arch[1], 1); // empty spawner
+    mgr.spawn(arch[2], 1, fn);
+    mgr.spawn(arch[3], 50, fn);
+    mgr.updateSelection(sel);
+
+    std::vector<Entity> visited;
+    sel.forEach([&](Entity ent, TTrivial1&, TTrivial2 const&) { visited.push_back(ent); });
+
+    ASSERT_EQ(std::distance(sel.begin(), sel.end()), 151);
+    ASSERT_EQ(sel.end() - sel.begin(), 151);
+    ASSERT_EQ(sel.begin() - sel.end(), -151);
+    std::size_t i = 0;
+    for (auto [ent, t1, t2] : sel) { // the order of forEach
+        ASSERT_EQ(ent, visited[i++]);
+        ASSERT_EQ(t1.data[0], -t2.data[0]);
+        t1.data[1] = 1;
+    }
+    ASSERT_EQ(i, visited.size());
+    ASSERT_TRUE(std::all_of(visited.begin(), visited.end(), [&mgr](Entity ent) { return mgr.componentOf<TTrivial1>(ent).data[1] == 1; }));
+
+    auto it = sel.begin();
+    for (std::ptrdiff_t j : { 0, 99, 100, 101, 150, 42, 0, 150, 100 }) { // random access across the spawners
+        auto jt = sel.begin() + j;
+        ASSERT_EQ(std::get<0>(*jt), visited[std::size_t(j)]);
+        ASSERT_EQ(std::get<0>(it[j]), visited[std::size_t(j)]);
+        ASSERT_EQ(jt - it, j);
+        ASSERT_EQ(sel.end() - jt, 151 - j);
+        ASSERT_EQ(std::get<0>(*(sel.end() - (151 - j))), visited[std::size_t(j)]);
+        ASSERT_TRUE(it <= jt && jt < sel.end());
+    }
+    auto back = sel.end();
+    for (std::size_t j = visited.size(); j-- > 0;)
+        ASSERT_EQ(std::get<0>(*--back), visited[j]);
+    ASSERT_EQ(back, sel.begin());
+
+    auto found = std::find_if(sel.begin(), sel.end(), [](auto const& t) { return std::get<1>(t).data[0] == 120; });
+    ASSERT_NE(found, sel.end());
+    ASSERT_EQ(found - sel.begin(), 120);
+
+    std::vector<std::ptrdiff_t> segments;
+    sel.forEachSegment([&segments](auto first, auto last) { segments.push_back(last - first); });
+    ASSERT_EQ(segments, (std::vector<std::ptrdiff_t>{ 100, 1, 50 }));
+
+    Selection<TTrivial1, TComp4> none;
+    mgr.updateSelection(none);
+    ASSERT_EQ(none.begin(), none.end());
+}
+
 // TODO: forEach
\ No newline at end of file
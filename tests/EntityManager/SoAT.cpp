@@ -0,0 +1,76 @@
+#include "ComponentsT.h"
+#include <ECSpp/EntityManager.h>
+#include <gtest/gtest.h>
+#include <sstream>
+
+using namespace epp;
+
+TEST(SoA, Ref)
+{
+    std::array<float, 4> xs{};
+    std::array<float, 4> ys{};
+    std::array<int, 4> tags{};
+    SoARef<TSoA> ref({ xs.data(), ys.data(), tags.data() }, 2);
+    ref.store(TSoA{ 1.f, 2.f, 3 });
+    ASSERT_EQ(xs[2], 1.f);
+    ASSERT_EQ(ys[2], 2.f);
+    ASSERT_EQ(tags[2], 3);
+    ref.get<&TSoA::y>() = 5.f;
+    ASSERT_EQ(ref.get<1>(), 5.f);
+    ASSERT_EQ(ref.load().y, 5.f);
+    static_assert(SoARef<TSoA>::IndexOf<&TSoA::tag>() == 2);
+    static_assert(std::is_same_v<decltype(SoARef<TSoA const>({}, 0).get<0>()), float const&>);
+
+    SoAChunk<TSoA> chunk({ xs.data(), ys.data(), tags.data() }, 4);
+    ASSERT_EQ(chunk.field<&TSoA::x>(), xs.data());
+    ASSERT_EQ(chunk[2].get<2>(), 3);
+}
+
+TEST(SoA, EntityManager)
+{
+    EntityManager mgr;
+    Archetype arch = Archetype(IdOfFields<TSoA>()).addComponent<TTrivial1>();
+    Archetype other(IdOfFields<TSoA>());
+    mgr.spawn(arch, 100);
+    mgr.spawn(other, 50);
+    for (std::size_t i = 0; i < 100; ++i)
+        mgr.fieldsOf<TSoA>(mgr.entitiesOf(arch).data[i]).store(TSoA{ float(i), 0.f, int(i) });
+
+    // one array per field
+    Selection<SoA<TSoA>> sel;
+    mgr.updateSelection(sel);
+    std::size_t chunks = 0;
+    sel.forEachChunk([&](Entity const*, std::size_t n, SoAChunk<TSoA> c) {
+        float* x = c.field<&TSoA::x>();
+        float* y = c.field<&TSoA::y>();
+        for (std::size_t i = 0; i < n; ++i) // vectorizable
+            y[i] += 2.f * x[i];
+        ++chunks;
+    });
+    ASSERT_EQ(chunks, 2);
+    sel.forEach([](Entity, SoARef<TSoA> p) { p.get<&TSoA::tag>() += 1; });
+
+    Entity ent = mgr.entitiesOf(arch).data[10];
+    ASSERT_EQ(mgr.fieldsOf<TSoA>(ent).load().y, 20.f);
+    ASSERT_EQ(std::as_const(mgr).fieldsOf<TSoA>(ent).get<2>(), 11);
+
+    // the fields are moved with their entity, like any other components
+    mgr.changeArchetype(ent, other);
+    TSoA moved = mgr.fieldsOf<TSoA>(ent).load();
+    ASSERT_EQ(moved.x, 10.f);
+    ASSERT_EQ(moved.y, 20.f);
+    ASSERT_EQ(moved.tag, 11);
+
+    Selection<SoA<TSoA> const, TTrivial1> constSel;
+    mgr.updateSelection(constSel);
+    int sum = 0;
+    constSel.forEach([&](Entity, SoARef<TSoA const> p, TTrivial1&) { sum += p.get<2>(); });
+    ASSERT_EQ(sum, 100 * 101 / 2 - 11);
+
+    // trivially copyable fields can be saved
+    std::stringstream snapshot;
+    mgr.save(snapshot);
+    EntityManager loaded;
+    loaded.load(snapshot);
+    ASSERT_EQ(loaded.fieldsOf<TSoA>(ent).load().y, 20.f);
+}
\ No newline at end of file
@@ -0,0 +1,140 @@
+#include "ComponentsT.h"
+#include <ECSpp/EntityManager.h>
+#include <gtest/gtest.h>
+#include <sstream>
+
+using namespace epp;
+
+struct Stun {
+    int frames = 0;
+};
+
+struct Burning {
+    int damage = 0;
+};
+
+namespace epp {
+template <>
+struct SparseStorage<Stun> : std::true_type {
+};
+
+template <>
+struct SparseStorage<Burning> : std::true_type {
+};
+} // namespace epp
+
+TEST(SparseSet, EmplaceErase)
+{
+    EntityList entList;
+    Entity ent1 = entList.allocEntity(PoolIdx(0), SpawnerId(0));
+    Entity ent2 = entList.allocEntity(PoolIdx(1), SpawnerId(0));
+    SparseSet<Stun> set;
+    set.emplace(ent1, Stun{ 1 });
+    set.emplace(ent2, Stun{ 2 });
+    set.emplace(ent1, Stun{ 3 }); // replaces
+    ASSERT_EQ(set.size(), 2);
+    ASSERT_EQ(set.find(ent1)->frames, 3);
+
+    set.erase(ent1); // swap-remove
+    ASSERT_EQ(set.find(ent1), nullptr);
+    ASSERT_EQ(set.find(ent2)->frames, 2);
+
+    CountingResource counter;
+    {
+        SparseSet<Burning> withResource(&counter);
+        withResource.emplace(ent1, Burning{ 5 });
+        ASSERT_EQ(counter.allocations(), 3); // sparse, dense and values arrays
+    }
+    ASSERT_EQ(counter.bytesInUse(), 0);
+    ASSERT_EQ(set.getEntities(), std::pmr::vector<Entity>{ ent2 });
+
+    // a stale entity replaced by a new one with the same ListIdx
+    entList.freeEntity(ent2);
+    Entity ent3 = entList.allocEntity(PoolIdx(0), SpawnerId(0));
+    ASSERT_EQ(ent3.listIdx, ent2.listIdx);
+    ASSERT_EQ(set.find(ent3), nullptr);
+    set.emplace(ent3, Stun{ 4 });
+    set.eraseInvalid(entList);
+    ASSERT_EQ(set.size(), 1);
+    ASSERT_EQ(set.find(ent3)->frames, 4);
+}
+
+TEST(SparseSet, EntityManager)
+{
+    EntityManager mgr;
+    std::vector<Archetype> archs = { Archetype(IdOf<TTrivial1, TTrivial2>()), Archetype(IdOfL<TTrivial1>()), Archetype(IdOfL<TTrivial2>()) };
+    for (auto const& arch : archs)
+        mgr.spawn(arch, 100);
+    std::vector<Entity> stunned;
+    for (auto const& arch : archs)
+        for (std::size_t i = 0; i < 100; i += 4)
+            stunned.push_back(mgr.entitiesOf(arch).data[i]);
+    for (auto ent : stunned)
+        mgr.addSparse<Stun>(ent, Stun{ 2 });
+    Entity ent = stunned.front();
+    ASSERT_EQ(mgr.findSparse<Stun>(ent)->frames, 2);
+    ASSERT_EQ(mgr.findSparse<Burning>(ent), nullptr);
+    ASSERT_EQ(mgr.archetypeOf(ent).getMask(), archs[0].getMask()); // the entity was not moved
+
+    // driven by the sparse set (75 stunned entities, 200 with TTrivial1), the current entity removes its component
+    Selection<TTrivial1, Stun> sel;
+    mgr.updateSelection(sel);
+    for (int frame = 0; frame < 2; ++frame) {
+        int visited = 0;
+        sel.forEach([&](Entity e, TTrivial1& c, Stun& stun) {
+            ++visited;
+            c.data[0] += 1;
+            if (--stun.frames == 0)
+                mgr.removeSparse<Stun>(e);
+        });
+        ASSERT_EQ(visited, 50);
+    }
+    ASSERT_EQ(mgr.findSparse<Stun>(ent), nullptr);
+    ASSERT_EQ(mgr.componentOf<TTrivial1>(ent).data[0], 2);
+
+    // driven by the spawners (a sparse set larger than the selected spawners)
+    for (auto const& arch : archs)
+        for (auto e : mgr.entitiesOf(arch).data)
+            mgr.addSparse<Burning>(e, Burning{ 1 });
+    mgr.removeSparse<Burning>(ent);
+    Selection<TTrivial2 const, Burning> burning(CMask(IdOfL<TTrivial1>()));
+    mgr.updateSelection(burning);
+    int visited = 0;
+    burning.forEach([&](Entity, TTrivial2 const&, Burning& b) { visited += b.damage; });
+    ASSERT_EQ(visited, 100);
+
+    // sparse components are removed with their entities
+    mgr.destroy(stunned.back());
+    ASSERT_EQ(mgr.findSparse<Burning>(stunned.back()), nullptr);
+    mgr.clear(archs[2]);
+    Selection<Burning> all;
+    mgr.updateSelection(all);
+    visited = 0;
+    all.forEach([&](Entity, Burning&) { ++visited; });
+    ASSERT_EQ(visited, 199);
+}
+
+TEST(SparseSet, TrackChanges)
+{
+    EntityManager mgr;
+    Archetype arch(IdOf<TTrivial1, TTrivial2>());
+    mgr.spawn(arch, 10000);
+    std::vector<Entity> ents = mgr.entitiesOf(arch).data;
+    for (std::size_t i = 0; i < 3; ++i)
+        mgr.addSparse<Stun>(ents[i * 4000], Stun{ 1 });
+    mgr.trackChanges(true);
+
+    // driven by the spawners (IterTimeChange), only the visited entities are marked
+    Selection<TTrivial1, Stun const> sel;
+    mgr.updateSelection(sel);
+    int visited = 0;
+    sel.forEach([&](Entity, TTrivial1& c, Stun const&) {
+        ++visited;
+        c.data[0] = 5;
+        return IterTimeChange::AnyClear;
+    });
+    ASSERT_EQ(visited, 3);
+    std::stringstream delta;
+    mgr.saveDelta(delta);
+    ASSERT_LT(delta.str().size(), 4 * DirtyBlocks::BlockSize * sizeof(TTrivial1));
+}
\ No newline at end of file